@@ -1,31 +1,19 @@
-#include "gpu_driver.h"
-#include "gpu_regs.h"
-#include <stdlib.h> 
+#include "gpu_driver_priv.h"
+#include <stdlib.h>
 
-// private device struct
-// base is marked volatile so MMIO reads/writes aren’t optimized away
-struct gpu_device_t {
-    volatile uint32_t* base_addr;
-};
-
-// --- internal mmio helper functions ---
-
-static inline void gpu_reg_write(gpu_device_t* dev, uint32_t reg_offset, uint32_t value) {
-    dev->base_addr[reg_offset / 4] = value;
-}
+// --- public api implementation ---
 
-static inline uint32_t gpu_reg_read(gpu_device_t* dev, uint32_t reg_offset) {
-    return dev->base_addr[reg_offset / 4];
+void gpu_init_static(gpu_device_t* dev, uintptr_t base_addr) {
+    dev->base_addr = (volatile uint32_t*)base_addr;
+    dev->ctrl_shadow = 0;
 }
 
-// --- public api implementation ---
-
 gpu_device_t* gpu_init(uintptr_t base_addr) {
     gpu_device_t* dev = (gpu_device_t*)malloc(sizeof(gpu_device_t));
     if (dev == NULL) {
         return NULL;
     }
-    dev->base_addr = (volatile uint32_t*)base_addr;
+    gpu_init_static(dev, base_addr);
     return dev;
 }
 
@@ -36,17 +24,19 @@ void gpu_destroy(gpu_device_t* dev) {
 }
 
 void gpu_reset(gpu_device_t* dev) {
-    // pulse the reset bit
+    // pulse the reset bit; the shadow is cleared to match the
+    // hardware's post-reset state
     gpu_reg_write(dev, GPU_REG_CONTROL, GPU_CONTROL_RESET_MASK);
     gpu_reg_write(dev, GPU_REG_CONTROL, 0);
+    dev->ctrl_shadow = 0;
 }
 
 void gpu_start(gpu_device_t* dev) {
-    uint32_t ctrl = gpu_reg_read(dev, GPU_REG_CONTROL);
-    gpu_reg_write(dev, GPU_REG_CONTROL, ctrl | GPU_CONTROL_START_MASK);
+    dev->ctrl_shadow |= GPU_CONTROL_START_MASK;
+    gpu_reg_write(dev, GPU_REG_CONTROL, dev->ctrl_shadow);
 }
 
 void gpu_stop(gpu_device_t* dev) {
-    uint32_t ctrl = gpu_reg_read(dev, GPU_REG_CONTROL);
-    gpu_reg_write(dev, GPU_REG_CONTROL, ctrl & ~GPU_CONTROL_START_MASK);
+    dev->ctrl_shadow &= ~GPU_CONTROL_START_MASK;
+    gpu_reg_write(dev, GPU_REG_CONTROL, dev->ctrl_shadow);
 }
\ No newline at end of file
@@ -5,12 +5,25 @@
 #include <stdbool.h>
 #include <stddef.h>
 
-// an opaque handle to a gpu device instance
+// a gpu device instance
+// the struct is exposed so callers can embed it or place it on the stack
+// instead of paying for a heap allocation that holds a single pointer;
+// base is marked volatile so MMIO reads/writes aren't optimized away
+struct gpu_device_t {
+    volatile uint32_t* base_addr;
+    // software copy of the last CONTROL value written; all CONTROL bits
+    // are software-owned, so state changes can be a single MMIO write
+    // instead of a read-modify-write round trip
+    uint32_t ctrl_shadow;
+};
 typedef struct gpu_device_t gpu_device_t;
 
 // -- Core Driver API --
 
-// initializes the gpu device handle from a memory-mapped address
+// initializes a caller-provided device handle (no heap allocation)
+void gpu_init_static(gpu_device_t* dev, uintptr_t base_addr);
+
+// allocates and initializes a gpu device handle from a memory-mapped address
 gpu_device_t* gpu_init(uintptr_t base_addr);
 
 void gpu_destroy(gpu_device_t* dev);
@@ -0,0 +1,55 @@
+#ifndef GPU_DRIVER_PRIV_H_
+#define GPU_DRIVER_PRIV_H_
+
+// internal header shared by gpu_driver.c, gpu_loader.c and gpu_status.c
+// keeps the mmio helpers in one place so every TU inlines the same
+// definitions instead of carrying its own static copy
+
+#include "gpu_driver.h"
+#include "gpu_regs.h"
+
+// --- internal mmio helper functions ---
+
+// always_inline guarantees the accessors never become calls, even at
+// -O0 or without LTO, so mmio stays a single load/store at the call site
+
+static inline __attribute__((always_inline))
+void gpu_reg_write(gpu_device_t* dev, uint32_t reg_index, uint32_t value) {
+    dev->base_addr[reg_index] = value;
+}
+
+static inline __attribute__((always_inline))
+uint32_t gpu_reg_read(gpu_device_t* dev, uint32_t reg_index) {
+    return dev->base_addr[reg_index];
+}
+
+// drains posted/write-combined MMIO stores
+// when the register window is mapped write-combining (so back-to-back
+// stores coalesce into cache-line-sized bursts), buffered writes must be
+// flushed before polling status; on strongly-ordered device mappings
+// this degrades to a cheap store barrier
+static inline void gpu_mmio_flush_writes(void) {
+#if defined(__aarch64__)
+    __asm__ volatile("dsb st" ::: "memory");
+#elif defined(__arm__)
+    __asm__ volatile("dsb" ::: "memory");
+#elif defined(__x86_64__) || defined(__i386__)
+    __asm__ volatile("sfence" ::: "memory");
+#else
+    __asm__ volatile("" ::: "memory");
+#endif
+}
+
+// spin-wait hint: tells the cpu we're in a polling loop so it can yield
+// pipeline resources / save power instead of hammering the bus
+static inline void gpu_cpu_relax(void) {
+#if defined(__aarch64__) || defined(__arm__)
+    __asm__ volatile("yield");
+#elif defined(__x86_64__) || defined(__i386__)
+    __asm__ volatile("pause");
+#else
+    __asm__ volatile("" ::: "memory");
+#endif
+}
+
+#endif // GPU_DRIVER_PRIV_H_
@@ -1,16 +1,13 @@
-#include "gpu_driver.h"
-#include "gpu_regs.h"
-
-// reuse mmio helpers here since the originals are static
-struct gpu_device_t {
-    volatile uint32_t* base_addr;
-};
-static inline void gpu_reg_write(gpu_device_t* dev, uint32_t reg_offset, uint32_t value) {
-    dev->base_addr[reg_offset / 4] = value;
-}
-static inline uint32_t gpu_reg_read(gpu_device_t* dev, uint32_t reg_offset) {
-    return dev->base_addr[reg_offset / 4];
-}
+#include "gpu_driver_priv.h"
+
+// number of instruction writes the loader accepts per SHADER_RDY poll.
+// the stock shader_loader.sv BRAM port takes a write every cycle, so a
+// depth of 1 is always safe; builds against a bitstream with a buffered
+// loader can raise this to the hw fifo depth to amortize the status
+// read across a whole batch of writes
+#ifndef GPU_SHADER_FIFO_DEPTH
+#define GPU_SHADER_FIFO_DEPTH 1
+#endif
 
 // --- public api implementation ---
 
@@ -19,17 +16,75 @@ bool gpu_load_shader(gpu_device_t* dev, const uint32_t* shader_code, size_t inst
         return false;
     }
 
-    for (size_t i = 0; i < instruction_count; ++i) {
+    // hoist the mmio base and source pointer into restrict-qualified
+    // locals so the compiler knows they don't alias and can keep both
+    // in registers across the upload loop
+    volatile uint32_t* restrict mmio = dev->base_addr;
+    const uint32_t* restrict src = shader_code;
+
+#ifdef GPU_HAS_SHADER_ADDR_AUTOINC
+    // hardware bumps SHADER_ADDR after each data write, so program the
+    // start address once and stream the payload - halves the MMIO
+    // traffic compared to the addr/data pair per instruction
+    gpu_reg_write(dev, GPU_REG_SHADER_ADDR, 0);
+#endif
+
+    size_t i = 0;
+    while (i < instruction_count) {
         uint32_t timeout = 1000;
-        
+        uint32_t backoff = 1;
+
+        // pull the upcoming source line toward L1 while we wait on the
+        // ready bit; reading past the end is fine for a prefetch hint
+        __builtin_prefetch(src + i + 16, 0, 1);
+
         // wait until the gpu is ready for the next instruction
-        while (!(gpu_reg_read(dev, GPU_REG_STATUS) & GPU_STATUS_SHADER_RDY_MASK)) {
+        // each failed poll backs off exponentially (capped) so a slow
+        // ready bit doesn't saturate the register interface with reads
+        while (!(mmio[GPU_REG_STATUS] & GPU_STATUS_SHADER_RDY_MASK)) {
             if (--timeout == 0) return false;
+            for (uint32_t spin = 0; spin < backoff; ++spin) {
+                gpu_cpu_relax();
+            }
+            if (backoff < 64) {
+                backoff <<= 1;
+            }
+        }
+
+        // one successful poll covers up to GPU_SHADER_FIFO_DEPTH writes,
+        // amortizing the status read across the whole batch
+        size_t batch = GPU_SHADER_FIFO_DEPTH;
+        if (batch > instruction_count - i) {
+            batch = instruction_count - i;
+        }
+
+#if defined(GPU_HAS_SHADER_ADDR_AUTOINC) && defined(GPU_MMIO_64BIT)
+        // on a 64-bit fabric the data port takes two packed instructions
+        // per beat, halving the number of bus beats; this needs
+        // auto-increment since no address write separates the halves
+        {
+            volatile uint64_t* data64 =
+                (volatile uint64_t*)(mmio + GPU_REG_SHADER_DATA);
+            while (batch >= 2) {
+                *data64 = (uint64_t)src[i] |
+                          ((uint64_t)src[i + 1] << 32);
+                i += 2;
+                batch -= 2;
+            }
+        }
+#endif
+
+        for (size_t j = 0; j < batch; ++j, ++i) {
+#ifndef GPU_HAS_SHADER_ADDR_AUTOINC
+            // write the address, then the instruction data
+            mmio[GPU_REG_SHADER_ADDR] = (uint32_t)i;
+#endif
+            mmio[GPU_REG_SHADER_DATA] = src[i];
         }
 
-        // write the address, then the instruction data
-        gpu_reg_write(dev, GPU_REG_SHADER_ADDR, (uint32_t)i);
-        gpu_reg_write(dev, GPU_REG_SHADER_DATA, shader_code[i]);
+        // drain the batch before the next status poll so write-combined
+        // stores can't be reordered past the readiness check
+        gpu_mmio_flush_writes();
     }
     return true;
 }
\ No newline at end of file
@@ -3,16 +3,19 @@
 
 #include <stdint.h>
 
-// gpu register offsets from the base address
+// gpu register word indices from the base address
+// the register file is an array of 32-bit words, so register N lives at
+// byte offset N*4; indexing base_addr[N] directly avoids a divide/shift
+// on every mmio access
 typedef enum {
-    GPU_REG_CONTROL      = 0x00, // rw: main control register
-    GPU_REG_STATUS       = 0x04, // r-: main status register
-    GPU_REG_ERROR        = 0x08, // rwc: error code register (clears on read)
-    GPU_REG_SHADER_ADDR  = 0x0C, // rw: address for shader memory access
-    GPU_REG_SHADER_DATA  = 0x10, // rw: data for shader memory access
-    GPU_REG_CMD_BASE     = 0x14, // rw: base address of command buffer
-    GPU_REG_CMD_WP       = 0x18, // rw: command buffer write pointer
-    GPU_REG_CMD_RP       = 0x1C, // r-: command buffer read pointer
+    GPU_REG_CONTROL      = 0, // rw: main control register (byte 0x00)
+    GPU_REG_STATUS       = 1, // r-: main status register (byte 0x04)
+    GPU_REG_ERROR        = 2, // rwc: error code register, clears on read (byte 0x08)
+    GPU_REG_SHADER_ADDR  = 3, // rw: address for shader memory access (byte 0x0C)
+    GPU_REG_SHADER_DATA  = 4, // rw: data for shader memory access (byte 0x10)
+    GPU_REG_CMD_BASE     = 5, // rw: base address of command buffer (byte 0x14)
+    GPU_REG_CMD_WP       = 6, // rw: command buffer write pointer (byte 0x18)
+    GPU_REG_CMD_RP       = 7, // r-: command buffer read pointer (byte 0x1C)
 } gpu_reg_offset_t;
 
 // bitfields for GPU_REG_CONTROL
@@ -1,14 +1,4 @@
-#include "gpu_driver.h"
-#include "gpu_regs.h"
-
-// local copy of the mmio helpers for this file
-
-struct gpu_device_t {
-    volatile uint32_t* base_addr;
-};
-static inline uint32_t gpu_reg_read(gpu_device_t* dev, uint32_t reg_offset) {
-    return dev->base_addr[reg_offset / 4];
-}
+#include "gpu_driver_priv.h"
 
 // --- public api implementation ---
 
@@ -38,10 +28,29 @@ bool gpu_wait_for_idle(gpu_device_t* dev, uint32_t timeout_cycles) {
     if (dev == NULL) {
         return false;
     }
-    while (gpu_is_busy(dev)) {
+
+    // tiered wait: a short tight-spin window catches an almost-idle gpu
+    // with minimum latency, after which growing relax bursts keep a
+    // long-running job from pegging the core and the status port.
+    // there is no OS to sleep into at this layer; the irq-driven wait
+    // lives in the kernel driver (mgpu_core_wait_idle)
+    // read status directly: going through gpu_is_busy would re-run its
+    // null check and an extra call layer on every poll iteration
+    volatile uint32_t* restrict mmio = dev->base_addr;
+    uint32_t polls = 0;
+    uint32_t backoff = 1;
+    while (mmio[GPU_REG_STATUS] & GPU_STATUS_BUSY_MASK) {
         if (timeout_cycles-- == 0) {
             return false; // timed out
         }
+        if (++polls > 100) {
+            for (uint32_t spin = 0; spin < backoff; ++spin) {
+                gpu_cpu_relax();
+            }
+            if (backoff < 1024) {
+                backoff <<= 1;
+            }
+        }
     }
     return true; // became idle
 }
\ No newline at end of file
@@ -20,6 +20,7 @@
 #include <linux/dma-mapping.h>
 #include <linux/interrupt.h>
 #include <linux/spinlock.h>
+#include <linux/mutex.h>
 #include <linux/completion.h>
 #include <linux/jiffies.h>
 
@@ -62,22 +63,41 @@ enum axi_state {
     AXI_READ_DATA
 };
 
+/* Maximum outstanding transaction IDs (2^id_width with the default
+ * id_width=4 from axi_wrapper.sv) */
+#define MGPU_AXI_MAX_IDS      16
+
+/* Packed AxLEN|AxSIZE|AxBURST|AxCACHE|AxPROT control word, computed
+ * once at setup and written to hardware as a single register value */
+#define AXI_CTRL_LEN(x)       ((x) << 16)
+#define AXI_CTRL_LEN_GET(w)   (((w) >> 16) & 0xFF)
+#define AXI_CTRL_SIZE(x)      ((x) << 13)
+#define AXI_CTRL_BURST(x)     ((x) << 11)
+#define AXI_CTRL_CACHE(x)     ((x) << 7)
+#define AXI_CTRL_PROT(x)      ((x) << 0)
+
 /* AXI transaction descriptor */
 struct mgpu_axi_transaction {
     dma_addr_t addr;
     void *data;
     size_t size;
     bool is_write;
-    bool is_burst;
-    u32 burst_len;
-    u32 burst_size;
-    u32 burst_type;
-    u32 cache_attr;
-    u32 prot_attr;
+    u32 axctrl;
+    u32 axi_id;
     struct completion completion;
     int status;
 };
 
+/* Cache-attribute region, resolved once at init so the per-transaction
+ * path is a small table walk instead of hard-coded address ranges */
+struct mgpu_axi_region {
+    dma_addr_t start;
+    dma_addr_t end;
+    u32 cache_attr;
+};
+
+#define MGPU_AXI_NUM_REGIONS  2
+
 /* AXI controller state */
 struct mgpu_axi_ctrl {
     struct mgpu_device *mdev;
@@ -88,13 +108,26 @@ struct mgpu_axi_ctrl {
     u32 id_width;       /* Transaction ID width */
     u32 max_burst_len;  /* Maximum burst length */
     
-    /* Current transaction */
-    struct mgpu_axi_transaction *current_txn;
+    /* In-flight transactions, indexed by AXI transaction ID, so the
+     * master can keep multiple address/data/response phases overlapped
+     * instead of draining the bus to IDLE between beats */
+    struct mgpu_axi_transaction *inflight[MGPU_AXI_MAX_IDS];
+    unsigned long inflight_mask;
+    wait_queue_head_t id_wait;
     enum axi_state state;
     spinlock_t lock;
+
+    /* Preallocated bounce buffer for CPU-mediated DMA copies */
+    void *bounce_buf;
+    struct mutex bounce_lock;
+
+    /* Cache-attribute map, ordered by start address */
+    struct mgpu_axi_region regions[MGPU_AXI_NUM_REGIONS];
     
-    /* Performance counters */
-    u64 read_txns;
+    /* Performance counters - on their own cache line so the per-
+     * transaction stat updates don't ping-pong the line holding the
+     * lock and the in-flight table between cores */
+    u64 read_txns ____cacheline_aligned;
     u64 write_txns;
     u64 read_bytes;
     u64 write_bytes;
@@ -120,20 +153,29 @@ static void mgpu_axi_timeout(struct timer_list *t)
 {
     struct mgpu_axi_ctrl *ctrl = from_timer(ctrl, t, timeout_timer);
     struct mgpu_device *mdev = ctrl->mdev;
-    
+    unsigned long flags;
+    unsigned int id;
+
     dev_err(mdev->dev, "AXI transaction timeout in state %d\n", ctrl->state);
-    
-    /* Mark transaction as failed */
-    if (ctrl->current_txn) {
-        ctrl->current_txn->status = -ETIMEDOUT;
-        complete(&ctrl->current_txn->completion);
-        ctrl->current_txn = NULL;
+
+    /* Fail everything still in flight */
+    spin_lock_irqsave(&ctrl->lock, flags);
+    for_each_set_bit(id, &ctrl->inflight_mask, MGPU_AXI_MAX_IDS) {
+        struct mgpu_axi_transaction *txn = ctrl->inflight[id];
+
+        ctrl->inflight[id] = NULL;
+        txn->status = -ETIMEDOUT;
+        complete(&txn->completion);
     }
-    
+    ctrl->inflight_mask = 0;
+
     /* Reset AXI state machine */
     ctrl->state = AXI_IDLE;
     ctrl->error_count++;
-    
+    spin_unlock_irqrestore(&ctrl->lock, flags);
+
+    wake_up(&ctrl->id_wait);
+
     /* Trigger GPU reset if too many errors */
     if (ctrl->error_count > 10) {
         dev_err(mdev->dev, "Too many AXI errors, triggering GPU reset\n");
@@ -141,222 +183,266 @@ static void mgpu_axi_timeout(struct timer_list *t)
     }
 }
 
+/* Claim a free AXI transaction ID, blocking only when all IDs are in
+ * flight. Returns the ID, or -EBUSY if none frees up within the
+ * controller timeout. */
+static int mgpu_axi_claim_id(struct mgpu_axi_ctrl *ctrl,
+                             struct mgpu_axi_transaction *txn,
+                             enum axi_state first_state)
+{
+    unsigned long flags;
+    int id;
+
+    for (;;) {
+        spin_lock_irqsave(&ctrl->lock, flags);
+        id = find_first_zero_bit(&ctrl->inflight_mask, MGPU_AXI_MAX_IDS);
+        if (id < MGPU_AXI_MAX_IDS) {
+            __set_bit(id, &ctrl->inflight_mask);
+            ctrl->inflight[id] = txn;
+            txn->axi_id = id;
+            ctrl->state = first_state;
+
+            /* Arm the timeout only for transactions long enough to be
+             * worth a timer-wheel insert; register-sized ops complete
+             * in well under a microsecond and are already bounded by
+             * the caller's wait_for_completion_timeout, so paying two
+             * timer-wheel lock round trips per access would cost more
+             * than the transaction itself */
+            if (txn->size > 64 && !timer_pending(&ctrl->timeout_timer))
+                mod_timer(&ctrl->timeout_timer,
+                          jiffies + ctrl->timeout_jiffies);
+
+            spin_unlock_irqrestore(&ctrl->lock, flags);
+            return id;
+        }
+        spin_unlock_irqrestore(&ctrl->lock, flags);
+
+        /* All IDs in flight - wait for a completion to free one */
+        if (!wait_event_timeout(ctrl->id_wait,
+                                ctrl->inflight_mask !=
+                                    GENMASK(MGPU_AXI_MAX_IDS - 1, 0),
+                                ctrl->timeout_jiffies))
+            return -EBUSY;
+    }
+}
+
+/* Drop a transaction that will never complete (caller timed out) */
+static void mgpu_axi_release_id(struct mgpu_axi_ctrl *ctrl,
+                                struct mgpu_axi_transaction *txn)
+{
+    unsigned long flags;
+
+    spin_lock_irqsave(&ctrl->lock, flags);
+    if (ctrl->inflight[txn->axi_id] == txn) {
+        ctrl->inflight[txn->axi_id] = NULL;
+        __clear_bit(txn->axi_id, &ctrl->inflight_mask);
+        if (!ctrl->inflight_mask)
+            ctrl->state = AXI_IDLE;
+    }
+    spin_unlock_irqrestore(&ctrl->lock, flags);
+
+    wake_up(&ctrl->id_wait);
+}
+
 /* Setup AXI burst parameters */
-static void mgpu_axi_setup_burst(struct mgpu_axi_transaction *txn,
+static void mgpu_axi_setup_burst(struct mgpu_axi_ctrl *ctrl,
+                                 struct mgpu_axi_transaction *txn,
                                  dma_addr_t addr, size_t size)
 {
+    u32 burst_len, burst_type;
+    u32 cache_attr = AXI_CACHE_DEVICE;
+    unsigned int i;
+
     /* Calculate burst parameters */
     if (size <= 4) {
         /* Single beat transfer */
-        txn->is_burst = false;
-        txn->burst_len = 0;
-        txn->burst_size = AXI_SIZE_4_BYTES;
-        txn->burst_type = AXI_BURST_TYPE_FIXED;
+        burst_len = 0;
+        burst_type = AXI_BURST_TYPE_FIXED;
     } else {
         /* Burst transfer */
-        txn->is_burst = true;
-        txn->burst_len = (size / 4) - 1;  /* Length in beats minus 1 */
-        txn->burst_size = AXI_SIZE_4_BYTES;
-        txn->burst_type = AXI_BURST_TYPE_INCR;
-        
-        /* Limit burst length to hardware maximum (256 beats) */
-        if (txn->burst_len > 255) {
-            txn->burst_len = 255;
-        }
+        burst_len = (size / 4) - 1;  /* Length in beats minus 1 */
+        burst_type = AXI_BURST_TYPE_INCR;
+
+        /* Limit burst length to the interconnect maximum from DT;
+         * AXI3 fabrics cap at 16 beats and would SLVERR beyond it */
+        if (burst_len >= ctrl->max_burst_len)
+            burst_len = ctrl->max_burst_len - 1;
     }
-    
-    /* Set cache attributes based on address range */
-    if (addr >= 0x00000000 && addr < 0x40000000) {
-        /* DDR memory - cacheable */
-        txn->cache_attr = AXI_CACHE_NORMAL;
-    } else {
-        /* Device memory - non-cacheable */
-        txn->cache_attr = AXI_CACHE_DEVICE;
+
+    /* Cache attributes from the region table built at init */
+    for (i = 0; i < MGPU_AXI_NUM_REGIONS; i++) {
+        if (addr >= ctrl->regions[i].start && addr < ctrl->regions[i].end) {
+            cache_attr = ctrl->regions[i].cache_attr;
+            break;
+        }
     }
-    
-    /* Protection: non-secure, non-privileged, data access */
-    txn->prot_attr = 0x0;
+
+    /* Fold everything into the final control word here so submission
+     * writes one precomputed value instead of reassembling five fields.
+     * Protection: non-secure, non-privileged, data access. */
+    txn->axctrl = AXI_CTRL_LEN(burst_len) |
+                  AXI_CTRL_SIZE(AXI_SIZE_4_BYTES) |
+                  AXI_CTRL_BURST(burst_type) |
+                  AXI_CTRL_CACHE(cache_attr) |
+                  AXI_CTRL_PROT(0x0);
 }
 
-/* Initiate AXI write transaction */
-static int mgpu_axi_write(struct mgpu_device *mdev, dma_addr_t addr,
-                         void *data, size_t size)
+/* Issue a single AXI transaction of at most one hardware burst */
+static int mgpu_axi_xfer_one(struct mgpu_device *mdev, dma_addr_t addr,
+                             void *data, size_t size, bool is_write)
 {
     struct mgpu_axi_ctrl *ctrl = mgpu_get_axi_ctrl(mdev);
     struct mgpu_axi_transaction txn;
-    unsigned long flags;
-    int ret = 0;
-    
-    if (!ctrl)
-        return -ENODEV;
-    
-    /* Initialize transaction */
-    memset(&txn, 0, sizeof(txn));
-    txn.addr = addr;
-    txn.data = data;
-    txn.size = size;
-    txn.is_write = true;
+    int ret;
+
+    /* Initialize transaction; the designated initializer lets the
+     * compiler drop the dead zero-stores for fields assigned right
+     * after, unlike an explicit memset of the whole struct */
+    txn = (struct mgpu_axi_transaction){
+        .addr = addr,
+        .data = data,
+        .size = size,
+        .is_write = is_write,
+    };
     init_completion(&txn.completion);
-    
+
     /* Setup burst parameters */
-    mgpu_axi_setup_burst(&txn, addr, size);
-    
-    /* Submit transaction */
-    spin_lock_irqsave(&ctrl->lock, flags);
-    
-    if (ctrl->current_txn) {
-        spin_unlock_irqrestore(&ctrl->lock, flags);
+    mgpu_axi_setup_burst(ctrl, &txn, addr, size);
+
+    /* Claim a transaction ID; only blocks when all IDs are in flight */
+    ret = mgpu_axi_claim_id(ctrl, &txn,
+                            is_write ? AXI_WRITE_ADDR : AXI_READ_ADDR);
+    if (ret < 0) {
         dev_err(mdev->dev, "AXI controller busy\n");
-        return -EBUSY;
+        return ret;
     }
-    
-    ctrl->current_txn = &txn;
-    ctrl->state = AXI_WRITE_ADDR;
-    
-    /* Start timeout timer */
-    mod_timer(&ctrl->timeout_timer, jiffies + ctrl->timeout_jiffies);
-    
+
     /* Trigger hardware state machine by writing to control register */
-    /* Note: In real hardware, this would trigger the AXI FSM */
-    mgpu_write(mdev, MGPU_REG_CONTROL, 
+    /* Note: In real hardware, this would program AxID and trigger the
+     * AXI FSM */
+    mgpu_write(mdev, MGPU_REG_CONTROL,
                mgpu_read(mdev, MGPU_REG_CONTROL) | MGPU_CTRL_ENABLE);
-    
-    spin_unlock_irqrestore(&ctrl->lock, flags);
-    
+
     /* Wait for completion */
     ret = wait_for_completion_timeout(&txn.completion,
                                       ctrl->timeout_jiffies);
     if (ret == 0) {
-        dev_err(mdev->dev, "AXI write timeout\n");
+        mgpu_axi_release_id(ctrl, &txn);
+        dev_err(mdev->dev, "AXI %s timeout\n",
+                is_write ? "write" : "read");
         return -ETIMEDOUT;
     }
-    
+
     /* Update statistics */
     if (txn.status == 0) {
-        ctrl->write_txns++;
-        ctrl->write_bytes += size;
+        if (is_write) {
+            ctrl->write_txns++;
+            ctrl->write_bytes += size;
+        } else {
+            ctrl->read_txns++;
+            ctrl->read_bytes += size;
+        }
     }
-    
+
     return txn.status;
 }
 
-/* Initiate AXI read transaction */
-static int mgpu_axi_read(struct mgpu_device *mdev, dma_addr_t addr,
-                        void *data, size_t size)
+/* Split a transfer into bursts the interconnect can actually take and
+ * issue them back to back */
+static int mgpu_axi_xfer(struct mgpu_device *mdev, dma_addr_t addr,
+                         void *data, size_t size, bool is_write)
 {
     struct mgpu_axi_ctrl *ctrl = mgpu_get_axi_ctrl(mdev);
-    struct mgpu_axi_transaction txn;
-    unsigned long flags;
-    int ret = 0;
-    
+    size_t max_bytes;
+    int ret;
+
     if (!ctrl)
         return -ENODEV;
-    
-    /* Initialize transaction */
-    memset(&txn, 0, sizeof(txn));
-    txn.addr = addr;
-    txn.data = data;
-    txn.size = size;
-    txn.is_write = false;
-    init_completion(&txn.completion);
-    
-    /* Setup burst parameters */
-    mgpu_axi_setup_burst(&txn, addr, size);
-    
-    /* Submit transaction */
-    spin_lock_irqsave(&ctrl->lock, flags);
-    
-    if (ctrl->current_txn) {
-        spin_unlock_irqrestore(&ctrl->lock, flags);
-        dev_err(mdev->dev, "AXI controller busy\n");
-        return -EBUSY;
-    }
-    
-    ctrl->current_txn = &txn;
-    ctrl->state = AXI_READ_ADDR;
-    
-    /* Start timeout timer */
-    mod_timer(&ctrl->timeout_timer, jiffies + ctrl->timeout_jiffies);
-    
-    /* Trigger hardware state machine */
-    mgpu_write(mdev, MGPU_REG_CONTROL,
-               mgpu_read(mdev, MGPU_REG_CONTROL) | MGPU_CTRL_ENABLE);
-    
-    spin_unlock_irqrestore(&ctrl->lock, flags);
-    
-    /* Wait for completion */
-    ret = wait_for_completion_timeout(&txn.completion,
-                                      ctrl->timeout_jiffies);
-    if (ret == 0) {
-        dev_err(mdev->dev, "AXI read timeout\n");
-        return -ETIMEDOUT;
-    }
-    
-    /* Update statistics */
-    if (txn.status == 0) {
-        ctrl->read_txns++;
-        ctrl->read_bytes += size;
+
+    max_bytes = ctrl->max_burst_len * 4;
+
+    while (size > 0) {
+        size_t chunk = min(size, max_bytes);
+
+        ret = mgpu_axi_xfer_one(mdev, addr, data, chunk, is_write);
+        if (ret)
+            return ret;
+
+        addr += chunk;
+        data += chunk;
+        size -= chunk;
     }
-    
-    return txn.status;
+
+    return 0;
+}
+
+/* Initiate AXI write transaction */
+static int mgpu_axi_write(struct mgpu_device *mdev, dma_addr_t addr,
+                         void *data, size_t size)
+{
+    return mgpu_axi_xfer(mdev, addr, data, size, true);
+}
+
+/* Initiate AXI read transaction */
+static int mgpu_axi_read(struct mgpu_device *mdev, dma_addr_t addr,
+                        void *data, size_t size)
+{
+    return mgpu_axi_xfer(mdev, addr, data, size, false);
 }
 
-/* Handle AXI response from hardware */
-static void mgpu_axi_handle_response(struct mgpu_axi_ctrl *ctrl, u32 resp)
+/* Handle AXI response from hardware for one transaction ID */
+static void mgpu_axi_handle_response(struct mgpu_axi_ctrl *ctrl, unsigned int id,
+                                     u32 resp)
 {
     struct mgpu_device *mdev = ctrl->mdev;
-    
+    struct mgpu_axi_transaction *txn = ctrl->inflight[id];
+
+    if (!txn)
+        return;
+
     /* Check response code */
     switch (resp & 0x3) {
     case AXI_RESP_OKAY:
         /* Success */
-        if (ctrl->current_txn) {
-            ctrl->current_txn->status = 0;
-        }
+        txn->status = 0;
         break;
-        
+
     case AXI_RESP_EXOKAY:
         /* Exclusive access okay */
         dev_dbg(mdev->dev, "AXI exclusive access okay\n");
-        if (ctrl->current_txn) {
-            ctrl->current_txn->status = 0;
-        }
+        txn->status = 0;
         break;
-        
+
     case AXI_RESP_SLVERR:
         /* Slave error */
         dev_err(mdev->dev, "AXI slave error at addr 0x%08x\n",
-                ctrl->current_txn ? (u32)ctrl->current_txn->addr : 0);
-        if (ctrl->current_txn) {
-            ctrl->current_txn->status = -EIO;
-            ctrl->last_error_addr = ctrl->current_txn->addr;
-            ctrl->last_error_resp = resp;
-        }
+                (u32)txn->addr);
+        txn->status = -EIO;
+        ctrl->last_error_addr = txn->addr;
+        ctrl->last_error_resp = resp;
         ctrl->error_count++;
         break;
-        
+
     case AXI_RESP_DECERR:
         /* Decode error */
         dev_err(mdev->dev, "AXI decode error at addr 0x%08x\n",
-                ctrl->current_txn ? (u32)ctrl->current_txn->addr : 0);
-        if (ctrl->current_txn) {
-            ctrl->current_txn->status = -EFAULT;
-            ctrl->last_error_addr = ctrl->current_txn->addr;
-            ctrl->last_error_resp = resp;
-        }
+                (u32)txn->addr);
+        txn->status = -EFAULT;
+        ctrl->last_error_addr = txn->addr;
+        ctrl->last_error_resp = resp;
         ctrl->error_count++;
         break;
     }
-    
-    /* Complete transaction */
-    if (ctrl->current_txn) {
+
+    /* Retire the ID and complete the transaction */
+    ctrl->inflight[id] = NULL;
+    __clear_bit(id, &ctrl->inflight_mask);
+    if (!ctrl->inflight_mask) {
         del_timer(&ctrl->timeout_timer);
-        complete(&ctrl->current_txn->completion);
-        ctrl->current_txn = NULL;
+        ctrl->state = AXI_IDLE;
     }
-    
-    /* Return to idle state */
-    ctrl->state = AXI_IDLE;
+    complete(&txn->completion);
+    wake_up(&ctrl->id_wait);
 }
 
 /* AXI interrupt handler (called from main IRQ handler) */
@@ -364,38 +450,46 @@ void mgpu_axi_irq_handler(struct mgpu_device *mdev)
 {
     struct mgpu_axi_ctrl *ctrl = mgpu_get_axi_ctrl(mdev);
     unsigned long flags;
+    unsigned int id;
     u32 status;
-    
+
     if (!ctrl)
         return;
     
     spin_lock_irqsave(&ctrl->lock, flags);
-    
-    /* Read status to determine what happened */
-    status = mgpu_read(mdev, MGPU_REG_STATUS);
-    
+
+    /* Read status to determine what happened; IRQ entry already
+     * ordered us against the device, so skip the extra barrier */
+    status = mgpu_read_relaxed(mdev, MGPU_REG_STATUS);
+
+    /* In real hardware the response channel carries the completing
+     * AxID; the current bitstream completes in order, so retire the
+     * oldest in-flight ID */
+    id = find_first_bit(&ctrl->inflight_mask, MGPU_AXI_MAX_IDS);
+
     /* Handle based on current state */
     switch (ctrl->state) {
     case AXI_WRITE_RESP:
         /* Write response received */
-        mgpu_axi_handle_response(ctrl, 0);  /* Response would be in status */
+        if (id < MGPU_AXI_MAX_IDS)
+            mgpu_axi_handle_response(ctrl, id, 0);  /* Response would be in status */
         break;
-        
+
     case AXI_READ_DATA:
         /* Read data received */
-        if (ctrl->current_txn && ctrl->current_txn->data) {
+        if (id < MGPU_AXI_MAX_IDS && ctrl->inflight[id]->data) {
             /* In real hardware, we'd read data from AXI data registers */
             /* For now, simulate successful read */
-            mgpu_axi_handle_response(ctrl, AXI_RESP_OKAY);
+            mgpu_axi_handle_response(ctrl, id, AXI_RESP_OKAY);
         }
         break;
-        
+
     default:
         /* Unexpected interrupt */
         dev_dbg(mdev->dev, "AXI IRQ in state %d\n", ctrl->state);
         break;
     }
-    
+
     spin_unlock_irqrestore(&ctrl->lock, flags);
 }
 
@@ -435,58 +529,49 @@ static void mgpu_axi_memory_barrier(struct mgpu_device *mdev)
 int mgpu_axi_dma_transfer(struct mgpu_device *mdev, dma_addr_t src,
                           dma_addr_t dst, size_t size, bool blocking)
 {
-    void *buffer;
-    int ret;
-    
+    struct mgpu_axi_ctrl *ctrl = mgpu_get_axi_ctrl(mdev);
+    size_t chunk_size = PAGE_SIZE;
+    size_t remaining = size;
+    int ret = 0;
+
+    if (!ctrl)
+        return -ENODEV;
+
     /* Validate parameters */
     if (!size || size > (16 * 1024 * 1024)) {
         dev_err(mdev->dev, "Invalid DMA size: %zu\n", size);
         return -EINVAL;
     }
-    
+
     /* Check alignment (AXI requires 4-byte alignment minimum) */
     if ((src & 3) || (dst & 3) || (size & 3)) {
         dev_err(mdev->dev, "DMA addresses/size must be 4-byte aligned\n");
         return -EINVAL;
     }
-    
-    /* For large transfers, break into chunks */
-    if (size > PAGE_SIZE) {
-        size_t remaining = size;
-        size_t chunk_size = PAGE_SIZE;
-        
-        while (remaining > 0) {
-            if (remaining < chunk_size)
-                chunk_size = remaining;
-            
-            ret = mgpu_axi_dma_transfer(mdev, src, dst, chunk_size, blocking);
-            if (ret)
-                return ret;
-            
-            src += chunk_size;
-            dst += chunk_size;
-            remaining -= chunk_size;
-        }
-        
-        return 0;
-    }
-    
-    /* Allocate temporary buffer */
-    buffer = kmalloc(size, GFP_KERNEL);
-    if (!buffer)
-        return -ENOMEM;
-    
-    /* Read from source */
-    ret = mgpu_axi_read(mdev, src, buffer, size);
-    if (ret) {
-        kfree(buffer);
-        return ret;
+
+    /* Bounce through the preallocated scratch page, one chunk at a time */
+    mutex_lock(&ctrl->bounce_lock);
+
+    while (remaining > 0) {
+        if (remaining < chunk_size)
+            chunk_size = remaining;
+
+        /* Read from source */
+        ret = mgpu_axi_read(mdev, src, ctrl->bounce_buf, chunk_size);
+        if (ret)
+            break;
+
+        /* Write to destination */
+        ret = mgpu_axi_write(mdev, dst, ctrl->bounce_buf, chunk_size);
+        if (ret)
+            break;
+
+        src += chunk_size;
+        dst += chunk_size;
+        remaining -= chunk_size;
     }
-    
-    /* Write to destination */
-    ret = mgpu_axi_write(mdev, dst, buffer, size);
-    
-    kfree(buffer);
+
+    mutex_unlock(&ctrl->bounce_lock);
     return ret;
 }
 
@@ -583,8 +668,32 @@ int mgpu_axi_init(struct mgpu_device *mdev)
     
     ctrl->mdev = mdev;
     spin_lock_init(&ctrl->lock);
+    mutex_init(&ctrl->bounce_lock);
+    init_waitqueue_head(&ctrl->id_wait);
     ctrl->state = AXI_IDLE;
     ctrl->timeout_jiffies = msecs_to_jiffies(1000);  /* 1 second timeout */
+    ctrl->max_burst_len = 256;  /* Overridden by DT when present */
+
+    /* Preallocate the DMA bounce buffer so the copy path never hits
+     * the allocator */
+    ctrl->bounce_buf = kmalloc(PAGE_SIZE, GFP_KERNEL);
+    if (!ctrl->bounce_buf) {
+        kfree(ctrl);
+        return -ENOMEM;
+    }
+
+    /* Cache-attribute map: DDR below 1GB is cacheable on the Zynq PS,
+     * everything above is device memory */
+    ctrl->regions[0] = (struct mgpu_axi_region){
+        .start = 0x00000000,
+        .end = 0x40000000,
+        .cache_attr = AXI_CACHE_NORMAL,
+    };
+    ctrl->regions[1] = (struct mgpu_axi_region){
+        .start = 0x40000000,
+        .end = (dma_addr_t)-1,
+        .cache_attr = AXI_CACHE_DEVICE,
+    };
     
     /* Initialize timeout timer */
     timer_setup(&ctrl->timeout_timer, mgpu_axi_timeout, 0);
@@ -614,6 +723,7 @@ int mgpu_axi_init(struct mgpu_device *mdev)
     
 err_test:
     del_timer_sync(&ctrl->timeout_timer);
+    kfree(ctrl->bounce_buf);
     kfree(ctrl);
     mdev->axi_ctrl = NULL;
     return ret;
@@ -631,11 +741,19 @@ void mgpu_axi_fini(struct mgpu_device *mdev)
     
     /* Cancel timeout timer */
     del_timer_sync(&ctrl->timeout_timer);
-    
-    /* Wait for any pending transactions */
-    if (ctrl->current_txn) {
-        ctrl->current_txn->status = -ECANCELED;
-        complete(&ctrl->current_txn->completion);
+
+    /* Cancel any pending transactions */
+    {
+        unsigned int id;
+
+        for_each_set_bit(id, &ctrl->inflight_mask, MGPU_AXI_MAX_IDS) {
+            struct mgpu_axi_transaction *txn = ctrl->inflight[id];
+
+            ctrl->inflight[id] = NULL;
+            txn->status = -ECANCELED;
+            complete(&txn->completion);
+        }
+        ctrl->inflight_mask = 0;
     }
     
     /* Log statistics */
@@ -644,7 +762,8 @@ void mgpu_axi_fini(struct mgpu_device *mdev)
              ctrl->read_txns, ctrl->write_txns,
              ctrl->read_bytes, ctrl->write_bytes,
              ctrl->error_count);
-    
+
+    kfree(ctrl->bounce_buf);
     kfree(ctrl);
     mdev->axi_ctrl = NULL;
 }
@@ -660,19 +779,15 @@ int mgpu_axi_suspend(struct mgpu_device *mdev)
     
     dev_dbg(mdev->dev, "Suspending AXI transport\n");
     
+    /* Wait for in-flight transactions to drain */
+    wait_event_timeout(ctrl->id_wait, !ctrl->inflight_mask,
+                       ctrl->timeout_jiffies);
+
     spin_lock_irqsave(&ctrl->lock, flags);
-    
-    /* Wait for current transaction to complete */
-    if (ctrl->current_txn) {
-        spin_unlock_irqrestore(&ctrl->lock, flags);
-        wait_for_completion_timeout(&ctrl->current_txn->completion,
-                                    ctrl->timeout_jiffies);
-        spin_lock_irqsave(&ctrl->lock, flags);
-    }
-    
+
     /* Ensure we're in idle state */
     ctrl->state = AXI_IDLE;
-    
+
     spin_unlock_irqrestore(&ctrl->lock, flags);
     
     /* Cancel timeout timer */
@@ -694,7 +809,8 @@ int mgpu_axi_resume(struct mgpu_device *mdev)
     
     /* Reset state */
     ctrl->state = AXI_IDLE;
-    ctrl->current_txn = NULL;
+    memset(ctrl->inflight, 0, sizeof(ctrl->inflight));
+    ctrl->inflight_mask = 0;
     
     /* Test connectivity */
     ret = mgpu_axi_test(mdev);
@@ -2,32 +2,124 @@
 #include <linux/slab.h>
 #include <linux/dma-mapping.h>
 #include <linux/delay.h>
+#include <linux/iopoll.h>
+#include <linux/percpu.h>
+#include <linux/prefetch.h>
+#include <linux/wait.h>
+#include <linux/sched/signal.h>
 
 #include "mgpu_drm.h"
 #include "mgpu_regs.h"
-#include "mgpu_cmdq.h"
+#include "mgpu_internal.h"
 
 /* Command ring structure */
 struct mgpu_ring {
     struct mgpu_device *mdev;
-    
+
     /* Ring buffer memory */
     void *vaddr;
     dma_addr_t dma_addr;
     size_t size;
-    
+
     /* Ring pointers */
     u32 head;  /* Where GPU reads from */
     u32 tail;  /* Where CPU writes to */
-    
+
     /* Queue ID */
     u32 queue_id;
-    
-    /* Stats */
-    u64 submitted_cmds;
-    u64 completed_cmds;
+
+    /* Size in dwords and (size_dw - 1); size is enforced to be a power
+     * of two at create, so producers mask instead of dividing */
+    u32 size_dw;
+    u32 mask;
+
+    /* Serializes writers on this ring only */
+    struct mutex lock;
+
+    /* Accepting submissions? Cleared for suspend/stop */
+    bool enabled;
+    bool iomem;      /* vaddr is an ioremapped aperture, not system RAM */
+
+    /* Space waiters, woken from the IRQ handler when HEAD advances */
+    wait_queue_head_t wait_space;
+
+    /* Last HEAD seen by the IRQ handler / suspend path */
+    u32 last_head;
+    unsigned long last_activity;
+
+    /* Software view of the hardware HEAD register. Each MMIO read of
+     * CMD_HEAD is a non-posted bus transaction; the cache is refreshed
+     * only when it claims there is not enough room, and kept current by
+     * the IRQ handler */
+    u32 cached_head;
+
+    /* Tail as of the last doorbell, to skip redundant kicks */
+    u32 last_kick_tail;
+
+    /* Stats; per-CPU so the hot paths do a local increment instead of
+     * an RMW on a cacheline shared with other submitting CPUs. Summed
+     * on demand by mgpu_ring_submitted()/mgpu_ring_completed() */
+    u64 __percpu *submitted_cmds;
+    u64 __percpu *completed_cmds;
 };
 
+/* Fold the per-CPU counters for reporting (debugfs, log messages) */
+u64 mgpu_ring_submitted(struct mgpu_ring *ring)
+{
+    u64 sum = 0;
+    int cpu;
+    
+    for_each_possible_cpu(cpu)
+        sum += *per_cpu_ptr(ring->submitted_cmds, cpu);
+    
+    return sum;
+}
+
+u64 mgpu_ring_completed(struct mgpu_ring *ring)
+{
+    u64 sum = 0;
+    int cpu;
+    
+    for_each_possible_cpu(cpu)
+        sum += *per_cpu_ptr(ring->completed_cmds, cpu);
+    
+    return sum;
+}
+
+/* Cached ring pointers for reporting.  The head is the software shadow
+ * (kept current by the IRQ handler and space checks) and the tail is
+ * the CPU's own write pointer — neither needs an MMIO read.  Readers
+ * wanting true hardware-polled values have the regs debugfs file */
+u32 mgpu_ring_cached_head(struct mgpu_ring *ring)
+{
+    return READ_ONCE(ring->cached_head);
+}
+
+u32 mgpu_ring_tail(struct mgpu_ring *ring)
+{
+    return READ_ONCE(ring->tail);
+}
+
+/* Program a ring's BASE/SIZE/HEAD/TAIL register block. The four
+ * registers are contiguous (BASE+0x0..0xC), so __iowrite32_copy emits
+ * them as back-to-back posted stores that can combine into a single
+ * bus burst, with one barrier for the whole block */
+static void mgpu_ring_program_hw(struct mgpu_ring *ring, u32 head_val,
+                                 u32 tail_val)
+{
+    struct mgpu_device *mdev = ring->mdev;
+    u32 regs[4] = {
+        lower_32_bits(ring->dma_addr),
+        ring->size,
+        head_val,
+        tail_val,
+    };
+    
+    mgpu_write_burst(mdev, MGPU_REG_CMD_BASE + (ring->queue_id * 0x10),
+                     regs, ARRAY_SIZE(regs));
+    wmb();
+}
+
 /* Allocate and initialize a command ring */
 struct mgpu_ring *mgpu_ring_create(struct mgpu_device *mdev, size_t size, u32 queue_id)
 {
@@ -49,28 +141,47 @@ struct mgpu_ring *mgpu_ring_create(struct mgpu_device *mdev, size_t size, u32 qu
     if (!ring)
         return NULL;
     
+    ring->submitted_cmds = alloc_percpu(u64);
+    ring->completed_cmds = alloc_percpu(u64);
+    if (!ring->submitted_cmds || !ring->completed_cmds) {
+        free_percpu(ring->submitted_cmds);
+        free_percpu(ring->completed_cmds);
+        kfree(ring);
+        return NULL;
+    }
+    
     ring->mdev = mdev;
     ring->size = size;
+    ring->size_dw = size / 4;
+    ring->mask = ring->size_dw - 1;
+    WARN_ON(!is_power_of_2(ring->size_dw));
     ring->queue_id = queue_id;
-    
-    /* Allocate ring buffer memory */
-    ring->vaddr = dma_alloc_coherent(mdev->dev, size,
-                                     &ring->dma_addr, GFP_KERNEL);
+    ring->enabled = true;
+    mutex_init(&ring->lock);
+    init_waitqueue_head(&ring->wait_space);
+
+    /* Allocate ring buffer memory as write-combining: the CPU only ever
+     * produces into the ring, and WC lets adjacent stores merge into
+     * 64-byte bursts instead of the uncached word-at-a-time stores that
+     * "coherent" memory costs on ARM. Reads from the ring are slow and
+     * should stay off hot paths (the coredump capture is the only one) */
+    ring->vaddr = dma_alloc_wc(mdev->dev, size,
+                               &ring->dma_addr, GFP_KERNEL);
     if (!ring->vaddr) {
         dev_err(mdev->dev, "Failed to allocate ring buffer\n");
         kfree(ring);
         return NULL;
     }
+    /* dma_alloc_wc() hands back system RAM; consumers that snapshot the
+     * ring may use plain memcpy.  A device-local aperture ring would set
+     * iomem and force the _fromio accessors instead */
+    ring->iomem = false;
     
-    /* Clear ring buffer */
-    memset(ring->vaddr, 0, size);
+    /* No memset: the DMA API hands back zeroed pages already, and a
+     * full-size write pass through WC memory is pure wasted bandwidth */
     
     /* Initialize hardware registers */
-    mgpu_write(mdev, MGPU_REG_CMD_BASE + (queue_id * 0x10), 
-               lower_32_bits(ring->dma_addr));
-    mgpu_write(mdev, MGPU_REG_CMD_SIZE + (queue_id * 0x10), size);
-    mgpu_write(mdev, MGPU_REG_CMD_HEAD + (queue_id * 0x10), 0);
-    mgpu_write(mdev, MGPU_REG_CMD_TAIL + (queue_id * 0x10), 0);
+    mgpu_ring_program_hw(ring, 0, 0);
     
     dev_info(mdev->dev, "Created ring %u, size %zu at 0x%pad\n",
              queue_id, size, &ring->dma_addr);
@@ -94,85 +205,300 @@ void mgpu_ring_destroy(struct mgpu_ring *ring)
     
     /* Free ring memory */
     if (ring->vaddr)
-        dma_free_coherent(mdev->dev, ring->size,
-                         ring->vaddr, ring->dma_addr);
+        dma_free_wc(mdev->dev, ring->size,
+                    ring->vaddr, ring->dma_addr);
     
+    free_percpu(ring->submitted_cmds);
+    free_percpu(ring->completed_cmds);
     kfree(ring);
 }
 
-/* Get available space in ring */
-static u32 mgpu_ring_space(struct mgpu_ring *ring)
+/* Get available space in ring, in dwords. Checks the cached HEAD first
+ * and only touches the MMIO register when the cached view says @needed
+ * does not fit, cutting MMIO traffic by orders of magnitude in the wait
+ * paths. Always inlined so the wait loops fold it into their hot path */
+static __always_inline u32 mgpu_ring_space(struct mgpu_ring *ring, u32 needed)
 {
-    u32 head, tail, space;
+    u32 head = READ_ONCE(ring->cached_head);
+    u32 tail = ring->tail;
+    u32 space;
+    
+    /* For power-of-two rings both the head<=tail and head>tail cases
+     * collapse to one masked subtraction — no data-dependent branch in
+     * the wait loops' hottest expression */
+    space = (head - tail - 1) & ring->mask;
+    if (space >= needed)
+        return space;
+    
+    /* Cached view is stale or the ring really is full; refresh.  The
+     * head write-back page is preferred — hardware mirrors CMD_HEAD
+     * into coherent memory, so the refresh is a cached load instead of
+     * a ~300ns serialized MMIO read */
+    if (ring->mdev->status_page) {
+        head = READ_ONCE(ring->mdev->status_page[ring->queue_id]);
+        WRITE_ONCE(ring->cached_head, head);
+        space = (head - tail - 1) & ring->mask;
+        if (space >= needed)
+            return space;
+        /* The shadow can lag the hardware by a write-back; only when
+         * it still says "full" is the MMIO register worth asking */
+    }
     
-    /* Read head from hardware */
     head = mgpu_read(ring->mdev, MGPU_REG_CMD_HEAD + (ring->queue_id * 0x10));
-    tail = ring->tail;
+    WRITE_ONCE(ring->cached_head, head);
     
-    if (head <= tail)
-        space = ring->size - (tail - head) - 1;
-    else
-        space = head - tail - 1;
-    
-    return space;
+    return (head - tail - 1) & ring->mask;
+}
+
+/* Bounded busy-spin before falling back to sleeping. Roughly ~20µs worth
+ * of cpu_relax() iterations */
+#define MGPU_RING_MAX_SPIN 5000
+
+/* Private wait entry so the wake function can check how much space the
+ * waiter actually needs. A bare wake_up_all() on every HEAD advance would
+ * wake every submitter just to have most of them re-check and sleep again;
+ * filtering in the wake function keeps waiters asleep until their own
+ * request fits. */
+struct mgpu_space_wait {
+    wait_queue_entry_t wq;
+    struct mgpu_ring *ring;
+    u32 needed;
+};
+
+static int mgpu_ring_space_wake(wait_queue_entry_t *wq, unsigned int mode,
+                                int flags, void *key)
+{
+    struct mgpu_space_wait *sw = container_of(wq, struct mgpu_space_wait, wq);
+
+    if (mgpu_ring_space(sw->ring, sw->needed) < sw->needed)
+        return 0;  /* Not enough room yet, stay queued */
+
+    return autoremove_wake_function(wq, mode, flags, key);
 }
 
-/* Wait for space in ring */
+/* Wait for space in ring. Sleeps until the completion IRQ advances HEAD
+ * instead of polling the MMIO register with msleep(); each poll read is a
+ * non-posted bus transaction and the msleep adds a 1ms latency floor even
+ * when space frees within microseconds. Must be called without ring->lock. */
 static int mgpu_ring_wait_space(struct mgpu_ring *ring, u32 needed)
 {
-    int timeout = 1000;  /* 1 second timeout */
-    
-    while (mgpu_ring_space(ring) < needed) {
-        if (timeout-- <= 0) {
+    struct mgpu_space_wait sw = {
+        .ring = ring,
+    };
+    long timeout = msecs_to_jiffies(1000);
+    int ret = 0;
+    u32 want;
+    u32 i;
+
+    /* The GPU usually drains a few dwords within microseconds; a bounded
+     * spin catches that case without paying the scheduler round-trip
+     * (tens of µs at best) that even an immediate wakeup would cost */
+    for (i = 0; i < MGPU_RING_MAX_SPIN; i++) {
+        if (mgpu_ring_space(ring, needed) >= needed)
+            return 0;
+        cpu_relax();
+    }
+
+    /* Once we have to sleep, wait for a high-watermark (half the ring)
+     * rather than the exact request. Racing small submitters otherwise
+     * wake, fill the freed space, and put each other straight back to
+     * sleep — hysteresis trades a slightly longer single wait for far
+     * fewer wake/sleep round-trips under backpressure */
+    want = max_t(u32, needed, ring->size_dw / 2);
+    sw.needed = want;
+
+    init_wait(&sw.wq);
+    sw.wq.func = mgpu_ring_space_wake;
+
+    for (;;) {
+        prepare_to_wait(&ring->wait_space, &sw.wq, TASK_INTERRUPTIBLE);
+
+        if (mgpu_ring_space(ring, want) >= want)
+            break;
+
+        if (signal_pending(current)) {
+            ret = -ERESTARTSYS;
+            break;
+        }
+
+        timeout = schedule_timeout(timeout);
+        if (!timeout) {
+            /* The watermark never arrived, but the actual request may
+             * still fit — only fail if it does not */
+            if (mgpu_ring_space(ring, needed) >= needed)
+                break;
             dev_err(ring->mdev->dev, "Ring %u timeout waiting for space\n",
                     ring->queue_id);
-            return -ETIMEDOUT;
+            ret = -ETIMEDOUT;
+            break;
         }
-        msleep(1);
     }
-    
+
+    finish_wait(&ring->wait_space, &sw.wq);
+
+    return ret;
+}
+
+/* Wait for @needed dwords with ring->lock held, dropping the lock around
+ * the sleep so other submitters are not blocked behind a full ring.
+ * Returns with the lock held on success, released on error. */
+static int mgpu_ring_wait_space_locked(struct mgpu_ring *ring, u32 needed)
+{
+    int ret;
+
+    while (mgpu_ring_space(ring, needed) < needed) {
+        mutex_unlock(&ring->lock);
+
+        ret = mgpu_ring_wait_space(ring, needed);
+        if (ret)
+            return ret;
+
+        mutex_lock(&ring->lock);
+        /* Another submitter may have consumed the space; re-check */
+    }
+
     return 0;
 }
 
-/* Write data to ring */
+/* Write data to ring without a barrier, so callers emitting several
+ * chunks (commands + fence) can pay one wmb() for the lot. Bulk-copies
+ * the pre-wrap and post-wrap segments rather than storing dword-by-dword:
+ * memcpy streams the data without the per-dword wraparound mask and
+ * branch, which matters for multi-KB command buffers */
+static void mgpu_ring_write_nobarrier(struct mgpu_ring *ring, const u32 *data,
+                                      u32 dwords)
+{
+    u32 *ring_ptr = ring->vaddr;
+    u32 tail = ring->tail;
+    u32 first = min(dwords, ring->size_dw - tail);
+
+    /* Start the ownership fetch of the destination line before the
+     * copy; the device read side keeps these lines out of our cache,
+     * so a submit usually opens with a cold write miss */
+    prefetchw(ring_ptr + tail);
+
+    memcpy(ring_ptr + tail, data, first * 4);
+    if (dwords > first)
+        memcpy(ring_ptr, data + first, (dwords - first) * 4);
+
+    ring->tail = (tail + dwords) & ring->mask;
+}
+
 static void mgpu_ring_write(struct mgpu_ring *ring, const u32 *data, u32 dwords)
+{
+    mgpu_ring_write_nobarrier(ring, data, dwords);
+
+    /* Single barrier for the whole write, not one per dword */
+    wmb();
+}
+
+/* Copy command dwords from userspace straight into the ring's wrap-aware
+ * segments. Skipping the kernel bounce buffer halves the bytes moved per
+ * submit and drops a GFP_KERNEL allocation from the hot path. The tail is
+ * only published after both copies succeed, so a fault leaves the ring
+ * unchanged. No barrier: the kick issues one wmb() covering all ring
+ * writes (commands plus optional fence) before the tail and doorbell. */
+static int mgpu_ring_write_user(struct mgpu_ring *ring,
+                                const void __user *uptr, u32 dwords)
 {
     u32 *ring_ptr = ring->vaddr;
     u32 tail = ring->tail;
-    u32 ring_size_dw = ring->size / 4;
-    u32 i;
+    u32 first = min(dwords, ring->size_dw - tail);
+
+    /* As in mgpu_ring_write_nobarrier: overlap the destination
+     * line's ownership fetch with the user-copy setup */
+    prefetchw(ring_ptr + tail);
+
+    if (copy_from_user(ring_ptr + tail, uptr, first * 4))
+        return -EFAULT;
+    if (dwords > first &&
+        copy_from_user(ring_ptr, (const u32 __user *)uptr + first,
+                       (dwords - first) * 4))
+        return -EFAULT;
+
+    ring->tail = (tail + dwords) & ring->mask;
+
+    return 0;
+}
+
+/* Kick the ring (doorbell). Each kick is two MMIO writes, so deferred
+ * (NOKICK) submissions that were already flushed by a later submitter
+ * are detected and skipped */
+static void mgpu_ring_kick(struct mgpu_ring *ring)
+{
+    struct mgpu_device *mdev = ring->mdev;
     
-    for (i = 0; i < dwords; i++) {
-        ring_ptr[tail] = data[i];
-        tail = (tail + 1) & (ring_size_dw - 1);
-    }
+    if (ring->tail == ring->last_kick_tail)
+        return;  /* Hardware already sees everything we wrote */
     
-    /* Memory barrier to ensure writes complete */
+    /* One barrier for the whole kick: the wmb() orders every ring
+     * write the submitter made ahead of both device stores, and writes
+     * to the same peripheral arrive in program order, so the tail
+     * update reaches the GPU before the doorbell without a second
+     * barrier in between. Submit paths rely on this wmb() and issue
+     * none of their own */
     wmb();
+    mgpu_write_relaxed(mdev, MGPU_REG_CMD_TAIL + (ring->queue_id * 0x10),
+                       ring->tail);
+    mgpu_write_relaxed(mdev, MGPU_REG_DOORBELL(ring->queue_id), 1);
     
-    ring->tail = tail;
+    ring->last_kick_tail = ring->tail;
 }
 
-/* Kick the ring (doorbell) */
-static void mgpu_ring_kick(struct mgpu_ring *ring)
+/* Submit a kernel-built command to a ring.  For in-kernel users (DMA
+ * helpers, coredump capture) that bypass the ioctl path; same locking
+ * and barrier discipline as mgpu_submit_commands() */
+static int __mgpu_ring_submit_internal(struct mgpu_ring *ring,
+                                       const u32 *cmd, u32 dwords,
+                                       bool kick)
 {
-    struct mgpu_device *mdev = ring->mdev;
+    int ret;
+    
+    mutex_lock(&ring->lock);
+    
+    ret = mgpu_ring_wait_space_locked(ring, dwords);
+    if (ret)
+        return ret;  /* Lock already dropped on error */
     
-    /* Update tail pointer in hardware */
-    mgpu_write(mdev, MGPU_REG_CMD_TAIL + (ring->queue_id * 0x10), ring->tail);
+    mgpu_ring_write_nobarrier(ring, cmd, dwords);
+    this_cpu_inc(*ring->submitted_cmds);
+    if (kick)
+        mgpu_ring_kick(ring);
     
-    /* Ring doorbell */
-    mgpu_write(mdev, MGPU_REG_DOORBELL(ring->queue_id), 1);
+    mutex_unlock(&ring->lock);
     
-    ring->submitted_cmds++;
+    return 0;
+}
+
+int mgpu_ring_submit_internal(struct mgpu_ring *ring, const u32 *cmd,
+                              u32 dwords)
+{
+    return __mgpu_ring_submit_internal(ring, cmd, dwords, true);
+}
+
+/* Queue without ringing the doorbell; batching callers publish the
+ * whole run with one mgpu_ring_flush() */
+int mgpu_ring_submit_internal_nokick(struct mgpu_ring *ring, const u32 *cmd,
+                                     u32 dwords)
+{
+    return __mgpu_ring_submit_internal(ring, cmd, dwords, false);
+}
+
+/* Publish everything queued so far.  A no-op (no MMIO at all) if a
+ * later submitter already kicked past the current tail */
+void mgpu_ring_flush(struct mgpu_ring *ring)
+{
+    mutex_lock(&ring->lock);
+    mgpu_ring_kick(ring);
+    mutex_unlock(&ring->lock);
 }
 
 /* Submit commands to ring */
 int mgpu_submit_commands(struct mgpu_device *mdev, struct mgpu_submit *args)
 {
     struct mgpu_ring *ring;
-    u32 *cmds;
     u32 cmd_dwords;
+    u32 fence_dwords;
     int ret;
     
     /* Validate arguments */
@@ -186,42 +512,37 @@ int mgpu_submit_commands(struct mgpu_device *mdev, struct mgpu_submit *args)
         return -EINVAL;
     }
     
-    /* Get or create ring for this queue */
-    ring = mdev->cmd_ring;
-    if (!ring) {
-        ring = mgpu_ring_create(mdev, MGPU_RING_SIZE_MIN, args->queue_id);
-        if (!ring)
-            return -ENOMEM;
-        mdev->cmd_ring = ring;
-    }
+    /* All rings are created at probe time, so the hot path never hits
+     * the DMA allocator */
+    ring = mdev->rings[args->queue_id];
+    if (!ring)
+        return -EINVAL;
     
-    /* Copy commands from userspace */
     cmd_dwords = args->cmd_size / 4;
-    cmds = kmalloc(args->cmd_size, GFP_KERNEL);
-    if (!cmds)
-        return -ENOMEM;
-    
-    if (copy_from_user(cmds, (void __user *)args->commands, args->cmd_size)) {
-        kfree(cmds);
-        return -EFAULT;
-    }
-    
+    fence_dwords = (args->flags & MGPU_SUBMIT_FLAGS_FENCE) ?
+                   sizeof(struct mgpu_cmd_fence) / 4 : 0;
+
     /* Lock the ring */
-    spin_lock(&mdev->cmd_lock);
-    
-    /* Wait for space */
-    ret = mgpu_ring_wait_space(ring, cmd_dwords);
+    mutex_lock(&ring->lock);
+
+    /* Wait once for everything this submit will emit (commands plus
+     * optional fence), so the fenced path does not pay a second space
+     * check and its MMIO head read */
+    ret = mgpu_ring_wait_space_locked(ring, cmd_dwords + fence_dwords);
+    if (ret)
+        return ret;
+
+    /* Stream commands from userspace directly into the ring; no bounce
+     * buffer, no second pass over the data */
+    ret = mgpu_ring_write_user(ring, (void __user *)args->commands,
+                               cmd_dwords);
     if (ret) {
-        spin_unlock(&mdev->cmd_lock);
-        kfree(cmds);
+        mutex_unlock(&ring->lock);
         return ret;
     }
     
-    /* Write commands to ring */
-    mgpu_ring_write(ring, cmds, cmd_dwords);
-    
     /* Add fence command if requested */
-    if (args->flags & MGPU_SUBMIT_FLAGS_FENCE) {
+    if (fence_dwords) {
         struct mgpu_cmd_fence fence_cmd = {
             .header = {
                 .opcode = MGPU_CMD_FENCE,
@@ -232,98 +553,128 @@ int mgpu_submit_commands(struct mgpu_device *mdev, struct mgpu_submit *args)
             .value = args->fence_value,
         };
         
-        ret = mgpu_ring_wait_space(ring, sizeof(fence_cmd) / 4);
-        if (ret) {
-            spin_unlock(&mdev->cmd_lock);
-            kfree(cmds);
-            return ret;
-        }
-        
-        mgpu_ring_write(ring, (u32 *)&fence_cmd, sizeof(fence_cmd) / 4);
+        mgpu_ring_write_nobarrier(ring, (u32 *)&fence_cmd,
+                                  sizeof(fence_cmd) / 4);
     }
     
-    /* Kick the ring */
-    mgpu_ring_kick(ring);
-    
-    spin_unlock(&mdev->cmd_lock);
+    /* No barrier here: the kick (ours or the one that eventually
+     * flushes a batched submit) opens with the single wmb() that
+     * orders commands and fence before the tail and doorbell */
+
+    /* Count per submission, not per kick: batched submits coalesce
+     * doorbells but each is still one unit of work */
+    this_cpu_inc(*ring->submitted_cmds);
+
+    /* Kick the ring unless the caller is batching; a SYNC submit always
+     * kicks since it is about to wait for the drain */
+    if (!(args->flags & MGPU_SUBMIT_FLAGS_NOKICK) ||
+        (args->flags & MGPU_SUBMIT_FLAGS_SYNC))
+        mgpu_ring_kick(ring);
     
-    kfree(cmds);
+    mutex_unlock(&ring->lock);
     
     dev_dbg(mdev->dev, "Submitted %u bytes to queue %u\n",
             args->cmd_size, args->queue_id);
     
     /* Synchronous wait if requested */
     if (args->flags & MGPU_SUBMIT_FLAGS_SYNC) {
-        /* Simple polling wait for now */
-        int timeout = 1000;
         u32 head, tail;
-        
-        do {
-            head = mgpu_read(mdev, MGPU_REG_CMD_HEAD + (ring->queue_id * 0x10));
-            tail = mgpu_read(mdev, MGPU_REG_CMD_TAIL + (ring->queue_id * 0x10));
-            if (head == tail)
-                break;
-            msleep(1);
-        } while (timeout-- > 0);
-        
-        if (timeout <= 0) {
+        u32 spin;
+
+        tail = ring->tail;
+
+        /* Brief spin first: small submissions retire in microseconds,
+         * far below sleep granularity. The IRQ handler keeps
+         * cached_head current, so the spin touches no MMIO at all */
+        for (spin = 0; spin < MGPU_RING_MAX_SPIN; spin++) {
+            if (READ_ONCE(ring->cached_head) == tail)
+                return 0;
+            cpu_relax();
+        }
+
+        ret = readl_poll_timeout(mdev->mmio_base + MGPU_REG_CMD_HEAD +
+                                     (ring->queue_id * 0x10),
+                                 head, head == tail,
+                                 10, 1000 * USEC_PER_MSEC);
+        WRITE_ONCE(ring->cached_head, head);
+        if (ret) {
             dev_warn(mdev->dev, "Sync submit timeout\n");
-            return -ETIMEDOUT;
+            return ret;
         }
     }
     
     return 0;
 }
 
-/* Initialize command queue subsystem */
+/* Initialize command queue subsystem. All rings are created up front:
+ * dma_alloc_wc() can block for a long time, and paying that on first
+ * submit made first-use latency wildly different from steady state */
 int mgpu_cmdq_init(struct mgpu_device *mdev)
 {
-    /* Create default ring */
-    mdev->cmd_ring = mgpu_ring_create(mdev, MGPU_RING_SIZE_MIN, 0);
-    if (!mdev->cmd_ring)
-        return -ENOMEM;
+    u32 nq = mdev->num_queues ? mdev->num_queues : 1;
+    u32 i;
+    
+    /* Head write-back: one coherent page the hardware mirrors each
+     * queue's CMD_HEAD into.  Optional — without the capability (or on
+     * allocation failure) space checks use the MMIO register */
+    if (mdev->caps & MGPU_CAP_HEAD_WRITEBACK) {
+        mdev->status_page = dma_alloc_coherent(mdev->dev, PAGE_SIZE,
+                                               &mdev->status_page_dma,
+                                               GFP_KERNEL);
+        if (mdev->status_page)
+            mgpu_write(mdev, MGPU_REG_STATUS_PAGE,
+                       lower_32_bits(mdev->status_page_dma));
+    }
+    
+    for (i = 0; i < nq; i++) {
+        mdev->rings[i] = mgpu_ring_create(mdev, MGPU_RING_SIZE_MIN, i);
+        if (!mdev->rings[i])
+            goto err_destroy;
+    }
     
     return 0;
+    
+err_destroy:
+    while (i--) {
+        mgpu_ring_destroy(mdev->rings[i]);
+        mdev->rings[i] = NULL;
+    }
+    if (mdev->status_page) {
+        mgpu_write(mdev, MGPU_REG_STATUS_PAGE, 0);
+        dma_free_coherent(mdev->dev, PAGE_SIZE, mdev->status_page,
+                          mdev->status_page_dma);
+        mdev->status_page = NULL;
+    }
+    return -ENOMEM;
 }
 
 /* Clean up command queue subsystem */
 void mgpu_cmdq_fini(struct mgpu_device *mdev)
 {
-    if (mdev->cmd_ring) {
-        mgpu_ring_destroy(mdev->cmd_ring);
-        mdev->cmd_ring = NULL;
-    }
-}
-
-/* Get available space in ring (in dwords) */
-static inline u32 mgpu_ring_space(struct mgpu_ring *ring)
-{
-    u32 head, tail, space;
-    
-    /* Read head from hardware */
-    head = mgpu_read(ring->mdev, MGPU_REG_CMD_HEAD + (ring->queue_id * 0x10));
-    tail = ring->tail;
+    u32 i;
     
-    if (head <= tail)
-        space = (ring->size / 4) - (tail - head) - 1;  /* Convert to dwords */
-    else
-        space = head - tail - 1;
+    for (i = 0; i < MGPU_MAX_QUEUES; i++) {
+        if (mdev->rings[i]) {
+            mgpu_ring_destroy(mdev->rings[i]);
+            mdev->rings[i] = NULL;
+        }
+    }
     
-    return space;
+    if (mdev->status_page) {
+        mgpu_write(mdev, MGPU_REG_STATUS_PAGE, 0);
+        dma_free_coherent(mdev->dev, PAGE_SIZE, mdev->status_page,
+                          mdev->status_page_dma);
+        mdev->status_page = NULL;
+    }
 }
 
-/* Suspend command queue processing */
-int mgpu_cmdq_suspend(struct mgpu_device *mdev)
+/* Suspend one command queue */
+static int mgpu_ring_suspend(struct mgpu_ring *ring)
 {
-    struct mgpu_ring *ring = mdev->cmd_ring;
+    struct mgpu_device *mdev = ring->mdev;
     unsigned long timeout;
     u32 head, tail;
     
-    if (!ring)
-        return 0;
-    
-    dev_dbg(mdev->dev, "Suspending command queue\n");
-    
     /* Stop accepting new commands */
     ring->enabled = false;
     
@@ -353,33 +704,45 @@ int mgpu_cmdq_suspend(struct mgpu_device *mdev)
     return 0;
 }
 
-/* Resume command queue processing */
-int mgpu_cmdq_resume(struct mgpu_device *mdev)
+/* Suspend command queue processing */
+int mgpu_cmdq_suspend(struct mgpu_device *mdev)
 {
-    struct mgpu_ring *ring = mdev->cmd_ring;
-    
-    if (!ring)
-        return 0;
+    u32 i;
     
-    dev_dbg(mdev->dev, "Resuming command queue\n");
+    dev_dbg(mdev->dev, "Suspending command queues\n");
     
-    /* Restore queue registers */
-    mgpu_write(mdev, MGPU_REG_CMD_BASE + (ring->queue_id * 0x10),
-               lower_32_bits(ring->dma_addr));
-    mgpu_write(mdev, MGPU_REG_CMD_SIZE + (ring->queue_id * 0x10),
-               ring->size);
+    for (i = 0; i < MGPU_MAX_QUEUES; i++) {
+        if (mdev->rings[i])
+            mgpu_ring_suspend(mdev->rings[i]);
+    }
     
-    /* Restore head/tail pointers */
-    mgpu_write(mdev, MGPU_REG_CMD_HEAD + (ring->queue_id * 0x10),
-               ring->last_head);
-    mgpu_write(mdev, MGPU_REG_CMD_TAIL + (ring->queue_id * 0x10),
-               ring->tail);
+    return 0;
+}
+
+/* Resume one command queue */
+static void mgpu_ring_resume(struct mgpu_ring *ring)
+{
+    /* Restore queue registers and head/tail pointers in one burst */
+    mgpu_ring_program_hw(ring, ring->last_head, ring->tail);
     
     /* Re-enable queue */
     ring->enabled = true;
     
     /* Wake any waiters */
     wake_up_all(&ring->wait_space);
+}
+
+/* Resume command queue processing */
+int mgpu_cmdq_resume(struct mgpu_device *mdev)
+{
+    u32 i;
+    
+    dev_dbg(mdev->dev, "Resuming command queues\n");
+    
+    for (i = 0; i < MGPU_MAX_QUEUES; i++) {
+        if (mdev->rings[i])
+            mgpu_ring_resume(mdev->rings[i]);
+    }
     
     return 0;
 }
@@ -387,26 +750,29 @@ int mgpu_cmdq_resume(struct mgpu_device *mdev)
 /* Stop command queue processing */
 int mgpu_cmdq_stop(struct mgpu_device *mdev)
 {
-    struct mgpu_ring *ring = mdev->cmd_ring;
-    unsigned long flags;
-    
-    if (!ring)
-        return 0;
-    
-    dev_dbg(mdev->dev, "Stopping command queue\n");
-    
-    spin_lock_irqsave(&mdev->cmd_lock, flags);
-    
-    /* Disable queue in hardware */
-    ring->enabled = false;
-    
-    /* Clear doorbell to stop processing */
-    mgpu_write(mdev, MGPU_REG_CMD_DOORBELL + (ring->queue_id * 0x10), 0);
+    struct mgpu_ring *ring;
+    u32 i;
     
-    /* Save current state */
-    ring->last_head = mgpu_read(mdev, MGPU_REG_CMD_HEAD + (ring->queue_id * 0x10));
+    dev_dbg(mdev->dev, "Stopping command queues\n");
     
-    spin_unlock_irqrestore(&mdev->cmd_lock, flags);
+    for (i = 0; i < MGPU_MAX_QUEUES; i++) {
+        ring = mdev->rings[i];
+        if (!ring)
+            continue;
+        
+        mutex_lock(&ring->lock);
+        
+        /* Disable queue in hardware */
+        ring->enabled = false;
+        
+        /* Clear doorbell to stop processing */
+        mgpu_write(mdev, MGPU_REG_CMD_DOORBELL + (ring->queue_id * 0x10), 0);
+        
+        /* Save current state */
+        ring->last_head = mgpu_read(mdev, MGPU_REG_CMD_HEAD + (ring->queue_id * 0x10));
+        
+        mutex_unlock(&ring->lock);
+    }
     
     /* Wait for any pending commands to complete or timeout */
     if (mgpu_core_wait_idle(mdev, 100) != 0) {
@@ -420,30 +786,34 @@ EXPORT_SYMBOL_GPL(mgpu_cmdq_stop);
 /* Handle command queue interrupt */
 void mgpu_cmdq_irq_handler(struct mgpu_device *mdev)
 {
-    struct mgpu_ring *ring = mdev->cmd_ring;
+    struct mgpu_ring *ring;
     u32 head, tail;
+    u32 i;
     
-    if (!ring)
-        return;
-    
-    /* Read current head/tail */
-    head = mgpu_read(mdev, MGPU_REG_CMD_HEAD + (ring->queue_id * 0x10));
-    tail = mgpu_read(mdev, MGPU_REG_CMD_TAIL + (ring->queue_id * 0x10));
-    
-    /* Update statistics */
-    if (head != ring->last_head) {
-        ring->completed_cmds++;
-        ring->last_head = head;
-        ring->last_activity = jiffies;
-    }
-    
-    /* Wake any threads waiting for space */
-    if (head != tail) {
-        wake_up(&ring->wait_space);
+    for (i = 0; i < MGPU_MAX_QUEUES; i++) {
+        ring = mdev->rings[i];
+        if (!ring)
+            continue;
+
+        /* Read current head/tail */
+        head = mgpu_read(mdev, MGPU_REG_CMD_HEAD + (ring->queue_id * 0x10));
+        tail = mgpu_read(mdev, MGPU_REG_CMD_TAIL + (ring->queue_id * 0x10));
+
+        /* HEAD advancing means the GPU consumed commands and freed space */
+        if (head != ring->last_head) {
+            this_cpu_inc(*ring->completed_cmds);
+            ring->last_head = head;
+            ring->last_activity = jiffies;
+            WRITE_ONCE(ring->cached_head, head);
+
+            /* Waiters filter on their own space requirement in the wake
+             * function, so this does not thundering-herd every submitter */
+            wake_up_all(&ring->wait_space);
+        }
+
+        dev_dbg(mdev->dev, "Command queue IRQ: head=%u, tail=%u, completed=%llu\n",
+                head, tail, mgpu_ring_completed(ring));
     }
-    
-    dev_dbg(mdev->dev, "Command queue IRQ: head=%u, tail=%u, completed=%llu\n",
-            head, tail, ring->completed_cmds);
 }
 
 /* Handle shader halt condition */
@@ -2,6 +2,7 @@
 #include <linux/kernel.h>
 #include <linux/delay.h>
 #include <linux/io.h>
+#include <linux/iopoll.h>
 #include <linux/interrupt.h>
 #include <linux/pm_runtime.h>
 
@@ -9,6 +10,45 @@
 #include "mgpu_regs.h"
 #include "mgpu_internal.h"
 
+/* Capability names indexed by bit position, so the decode below
+ * visits only the set bits instead of testing every flag */
+static const char * const mgpu_cap_names[] = {
+    [0]  = "vshader",
+    [1]  = "fshader",
+    [2]  = "texture",
+    [3]  = "fp16",
+    [4]  = "fp32",
+    [5]  = "int32",
+    [6]  = "atomic",
+    [7]  = "fence",
+    [8]  = "multiqueue",
+    [9]  = "preempt",
+    [10] = "compute",
+    [11] = "raster",
+    [12] = "depth",
+    [13] = "blend",
+};
+
+/* One probe-time line listing the set capability bits by name,
+ * O(popcount) via for_each_set_bit, instead of one dev_info per
+ * recognized flag */
+static void mgpu_core_log_caps(struct mgpu_device *mdev, u32 caps)
+{
+    unsigned long mask = caps;
+    char buf[128];
+    unsigned int bit;
+    int len = 0;
+
+    buf[0] = '\0';
+    for_each_set_bit(bit, &mask, 32)
+        len += scnprintf(buf + len, sizeof(buf) - len, " %s",
+                         (bit < ARRAY_SIZE(mgpu_cap_names) &&
+                          mgpu_cap_names[bit]) ? mgpu_cap_names[bit]
+                                               : "?");
+
+    dev_info(mdev->dev, "GPU capabilities: 0x%08x%s\n", caps, buf);
+}
+
 /* Initialize GPU hardware */
 int mgpu_core_init(struct mgpu_device *mdev)
 {
@@ -37,20 +77,8 @@ int mgpu_core_init(struct mgpu_device *mdev)
              MGPU_VERSION_PATCH(version),
              MGPU_VERSION_BUILD(version));
     
-    dev_info(mdev->dev, "GPU capabilities: 0x%08x\n", caps);
-    
-    /* Log detected features */
-    if (caps & MGPU_CAP_VERTEX_SHADER)
-        dev_info(mdev->dev, "  - Vertex shader support\n");
-    if (caps & MGPU_CAP_FRAGMENT_SHADER)
-        dev_info(mdev->dev, "  - Fragment shader support\n");
-    if (caps & MGPU_CAP_TEXTURE)
-        dev_info(mdev->dev, "  - Texture support\n");
-    if (caps & MGPU_CAP_FENCE)
-        dev_info(mdev->dev, "  - Fence support\n");
-    if (caps & MGPU_CAP_MULTI_QUEUE)
-        dev_info(mdev->dev, "  - Multi-queue support\n");
-    
+    mgpu_core_log_caps(mdev, caps);
+
     /* Determine number of engines and queues */
     if (caps & MGPU_CAP_MULTI_QUEUE) {
         mdev->num_queues = MGPU_MAX_QUEUES;
@@ -104,8 +132,8 @@ void mgpu_core_fini(struct mgpu_device *mdev)
 /* Reset GPU hardware */
 int mgpu_core_reset(struct mgpu_device *mdev)
 {
-    int timeout;
     u32 status;
+    int ret;
     
     dev_dbg(mdev->dev, "Resetting GPU\n");
     
@@ -118,22 +146,19 @@ int mgpu_core_reset(struct mgpu_device *mdev)
     /* Deassert reset */
     mgpu_write(mdev, MGPU_REG_CONTROL, 0);
     
-    /* Wait for GPU to become idle */
-    timeout = 100;  /* 100ms timeout */
-    while (timeout--) {
-        status = mgpu_read(mdev, MGPU_REG_STATUS);
-        if (status & MGPU_STATUS_IDLE)
-            break;
-        msleep(1);
-    }
-    
-    if (timeout <= 0) {
+    /* Wait for GPU to become idle. readl_poll_timeout polls at 10us
+     * granularity, so completion latency tracks the hardware instead of
+     * the msleep(1) tick the old loop paid per check */
+    ret = readl_poll_timeout(mdev->mmio_base + MGPU_REG_STATUS, status,
+                             status & MGPU_STATUS_IDLE,
+                             10, 100 * USEC_PER_MSEC);
+    if (ret) {
         dev_err(mdev->dev, "GPU reset timeout\n");
-        return -ETIMEDOUT;
+        return ret;
     }
     
     /* Clear any pending interrupts */
-    mgpu_write(mdev, MGPU_REG_IRQ_ACK, 0xFFFFFFFF);
+    mgpu_write(mdev, MGPU_REG_IRQ_ACK, MGPU_IRQ_ALL);
     
     dev_dbg(mdev->dev, "GPU reset complete\n");
     
@@ -185,25 +210,49 @@ bool mgpu_core_is_idle(struct mgpu_device *mdev)
     return (status & MGPU_STATUS_IDLE) && !(status & MGPU_STATUS_BUSY);
 }
 
-/* Wait for GPU to become idle */
+/* Busy-wait budget before mgpu_core_wait_idle() starts sleeping.
+ * Short jobs usually drain within a few register reads; paying up
+ * to this many nanoseconds of spinning saves them the >=100us
+ * usleep_range latency the sleep loop imposes */
+#define MGPU_IDLE_BUSYWAIT_NS   10000
+
+/* Wait for GPU to become idle. One STATUS read per iteration covers
+ * both the idle and error checks; going through mgpu_core_is_idle()
+ * plus a separate error read doubled the MMIO traffic of this loop.
+ * Hybrid wait: spin for a small ns budget first, then drop into the
+ * sleeping poll so long waits stop pinning the core */
 int mgpu_core_wait_idle(struct mgpu_device *mdev, unsigned int timeout_ms)
 {
     unsigned long timeout = jiffies + msecs_to_jiffies(timeout_ms);
-    
-    while (time_before(jiffies, timeout)) {
-        if (mgpu_core_is_idle(mdev))
-            return 0;
-        
-        /* Check for errors */
-        if (mgpu_read(mdev, MGPU_REG_STATUS) & MGPU_STATUS_ERROR) {
+    u64 spin_end = ktime_get_mono_fast_ns() + MGPU_IDLE_BUSYWAIT_NS;
+    bool spinning = true;
+    u32 status;
+
+    for (;;) {
+        status = mgpu_read(mdev, MGPU_REG_STATUS);
+
+        if (status & MGPU_STATUS_ERROR) {
             dev_err(mdev->dev, "GPU error detected while waiting for idle\n");
             return -EIO;
         }
-        
-        cpu_relax();
+
+        if ((status & MGPU_STATUS_IDLE) && !(status & MGPU_STATUS_BUSY))
+            return 0;
+
+        if (spinning) {
+            if (ktime_get_mono_fast_ns() < spin_end) {
+                cpu_relax();
+                continue;
+            }
+            spinning = false;
+        }
+
+        if (!time_before(jiffies, timeout))
+            break;
+
         usleep_range(100, 200);
     }
-    
+
     dev_err(mdev->dev, "Timeout waiting for GPU idle\n");
     return -ETIMEDOUT;
 }
@@ -223,18 +272,45 @@ void mgpu_core_handle_error(struct mgpu_device *mdev)
     }
 }
 
-/* Dump GPU state for debugging */
+/* Dump GPU state for debugging. The registers are read back-to-back
+ * into a snapshot first: each MMIO read is a serialized non-posted bus
+ * transaction, and interleaving them with printk formatting both slows
+ * the dump and lets the state drift between lines */
+struct mgpu_state_snap {
+    u32 version;
+    u32 caps;
+    u32 control;
+    u32 status;
+    u32 irq_status;
+    u32 irq_enable;
+    u32 head;
+    u32 tail;
+    u32 fence;
+};
+
 void mgpu_core_dump_state(struct mgpu_device *mdev)
 {
+    struct mgpu_state_snap snap;
+    
+    snap.version = mgpu_read(mdev, MGPU_REG_VERSION);
+    snap.caps = mgpu_read(mdev, MGPU_REG_CAPS);
+    snap.control = mgpu_read(mdev, MGPU_REG_CONTROL);
+    snap.status = mgpu_read(mdev, MGPU_REG_STATUS);
+    snap.irq_status = mgpu_read(mdev, MGPU_REG_IRQ_STATUS);
+    snap.irq_enable = mgpu_read(mdev, MGPU_REG_IRQ_ENABLE);
+    snap.head = mgpu_read(mdev, MGPU_REG_CMD_HEAD);
+    snap.tail = mgpu_read(mdev, MGPU_REG_CMD_TAIL);
+    snap.fence = mgpu_read(mdev, MGPU_REG_FENCE_VALUE);
+    
     dev_info(mdev->dev, "=== GPU State Dump ===\n");
-    dev_info(mdev->dev, "Version:  0x%08x\n", mgpu_read(mdev, MGPU_REG_VERSION));
-    dev_info(mdev->dev, "Caps:     0x%08x\n", mgpu_read(mdev, MGPU_REG_CAPS));
-    dev_info(mdev->dev, "Control:  0x%08x\n", mgpu_read(mdev, MGPU_REG_CONTROL));
-    dev_info(mdev->dev, "Status:   0x%08x\n", mgpu_read(mdev, MGPU_REG_STATUS));
-    dev_info(mdev->dev, "IRQ Status: 0x%08x\n", mgpu_read(mdev, MGPU_REG_IRQ_STATUS));
-    dev_info(mdev->dev, "IRQ Enable: 0x%08x\n", mgpu_read(mdev, MGPU_REG_IRQ_ENABLE));
-    dev_info(mdev->dev, "CMD Head: 0x%08x\n", mgpu_read(mdev, MGPU_REG_CMD_HEAD));
-    dev_info(mdev->dev, "CMD Tail: 0x%08x\n", mgpu_read(mdev, MGPU_REG_CMD_TAIL));
-    dev_info(mdev->dev, "Fence Value: 0x%08x\n", mgpu_read(mdev, MGPU_REG_FENCE_VALUE));
+    dev_info(mdev->dev, "Version:  0x%08x\n", snap.version);
+    dev_info(mdev->dev, "Caps:     0x%08x\n", snap.caps);
+    dev_info(mdev->dev, "Control:  0x%08x\n", snap.control);
+    dev_info(mdev->dev, "Status:   0x%08x\n", snap.status);
+    dev_info(mdev->dev, "IRQ Status: 0x%08x\n", snap.irq_status);
+    dev_info(mdev->dev, "IRQ Enable: 0x%08x\n", snap.irq_enable);
+    dev_info(mdev->dev, "CMD Head: 0x%08x\n", snap.head);
+    dev_info(mdev->dev, "CMD Tail: 0x%08x\n", snap.tail);
+    dev_info(mdev->dev, "Fence Value: 0x%08x\n", snap.fence);
     dev_info(mdev->dev, "======================\n");
 }
\ No newline at end of file
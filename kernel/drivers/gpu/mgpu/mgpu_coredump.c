@@ -8,7 +8,11 @@
 #include <linux/module.h>
 #include <linux/kernel.h>
 #include <linux/slab.h>
+#include <linux/bitops.h>
+#include <linux/lz4.h>
 #include <linux/devcoredump.h>
+#include <linux/dma-mapping.h>
+#include <linux/iopoll.h>
 #include <linux/scatterlist.h>
 #include <linux/string.h>
 #include <linux/time.h>
@@ -19,9 +23,20 @@
 #include "mgpu_internal.h"
 
 /* Coredump header version */
-#define MGPU_COREDUMP_VERSION 1
+#define MGPU_COREDUMP_VERSION 2
 #define MGPU_COREDUMP_MAGIC   0x4D475055  /* 'MGPU' */
 
+/* Header flags */
+#define MGPU_COREDUMP_FLAG_LZ4 (1 << 0)
+
+/* Everything after the header is LZ4-compressed by default: the blob
+ * (registers + ring + instruction memory) is multi-KB of sparse data
+ * that compresses several-fold at near-memcpy speed, which directly
+ * shrinks the devcoredump I/O a hung GPU inflicts on userspace */
+static char *compress = "lz4";
+module_param(compress, charp, 0644);
+MODULE_PARM_DESC(compress, "Coredump compression: none or lz4 (default: lz4)");
+
 /* Section types in coredump */
 enum mgpu_coredump_section {
     MGPU_DUMP_HEADER = 0,
@@ -36,21 +51,26 @@ enum mgpu_coredump_section {
     MGPU_DUMP_END
 };
 
-/* Coredump header */
+/* Coredump header, layout v2: fields ordered size-descending so every
+ * member is naturally aligned (no __packed, no unaligned loads when
+ * parsing), hot scalars packed into the first cacheline and the
+ * version strings banished to the tail */
 struct mgpu_coredump_header {
+    u64 timestamp;
     u32 magic;
     u32 version;
-    u64 timestamp;
     u32 gpu_version;
     u32 gpu_caps;
     u32 error_status;
     u32 error_code;
     u32 reset_count;
     u32 num_sections;
-    u32 total_size;
-    char kernel_version[64];
+    u32 total_size;       /* Uncompressed payload + header size */
+    u32 flags;            /* MGPU_COREDUMP_FLAG_* */
+    u32 compressed_size;  /* Payload bytes on disk when compressed */
     char driver_version[32];
-} __packed;
+    char kernel_version[64];
+} __aligned(64);
 
 /* Section header */
 struct mgpu_coredump_section_header {
@@ -61,47 +81,38 @@ struct mgpu_coredump_section_header {
     char name[32];
 } __packed;
 
-/* Register dump */
-struct mgpu_register_dump {
-    struct {
-        u32 version;
-        u32 caps;
-        u32 control;
-        u32 status;
-        u32 scratch;
-    } base;
-    
-    struct {
-        u32 irq_status;
-        u32 irq_enable;
-    } interrupt;
-    
-    struct {
-        u32 cmd_base;
-        u32 cmd_size;
-        u32 cmd_head;
-        u32 cmd_tail;
-    } command_queue[MGPU_MAX_QUEUES];
-    
-    struct {
-        u32 fence_addr;
-        u32 fence_value;
-    } fence;
-    
-    struct {
-        u32 vertex_base;
-        u32 vertex_count;
-        u32 vertex_stride;
-    } vertex;
-    
-    struct {
-        u32 shader_pc;
-        u32 shader_addr;
-        u32 shader_data;
-        u32 shader_ctrl;
-    } shader;
+/* Register dump: a flat (offset, value) pair list driven by the table
+ * below, in the style of etnaviv_dump_registers[].  Adding a register
+ * to a dump is a one-line table edit and the parser needs no layout
+ * knowledge beyond the pair format */
+struct mgpu_reg_pair {
+    u32 reg;
+    u32 val;
 } __packed;
 
+static const u16 mgpu_dump_regs[] = {
+    MGPU_REG_VERSION,
+    MGPU_REG_CAPS,
+    MGPU_REG_CONTROL,
+    MGPU_REG_STATUS,
+    MGPU_REG_SCRATCH,
+    MGPU_REG_IRQ_STATUS,
+    MGPU_REG_IRQ_ENABLE,
+    MGPU_REG_FENCE_ADDR,
+    MGPU_REG_FENCE_VALUE,
+    MGPU_REG_VERTEX_BASE,
+    MGPU_REG_VERTEX_COUNT,
+    MGPU_REG_VERTEX_STRIDE,
+    MGPU_REG_SHADER_PC,
+    MGPU_REG_SHADER_ADDR,
+    MGPU_REG_SHADER_DATA,
+    MGPU_REG_SHADER_CTRL,
+};
+
+/* Static table plus the four per-queue command registers */
+#define MGPU_DUMP_MAX_REGS \
+    (ARRAY_SIZE(mgpu_dump_regs) + 4 * MGPU_MAX_QUEUES)
+
 /* Command ring dump */
 struct mgpu_cmdring_dump {
     u32 queue_id;
@@ -124,6 +135,17 @@ struct mgpu_shader_dump {
     } slots[16];
 } __packed;
 
+/* Instruction memory is dumped as one 256-byte window per loaded
+ * shader slot, each preceded by this header so the parser can cope
+ * with the holes left by idle slots */
+struct mgpu_instrmem_slot_dump {
+    u32 slot;
+    u32 base;   /* Dword address of the window in instruction memory */
+    u32 size;   /* Bytes of window data following */
+} __packed;
+
+#define MGPU_INSTR_SLOT_DWORDS 64
+
 /* Error information */
 struct mgpu_error_dump {
     u32 error_code;
@@ -143,13 +165,45 @@ struct mgpu_coredump_state {
     size_t size;
     size_t offset;
     
+    /* Sampled once after the register sweep; capture helpers and the
+     * header fill consume these instead of re-reading clock or MMIO */
+    u64 now;
+    u32 status;
+    u32 fence_value;
+    u32 cmd_head;
+    bool instr_from_dma;  /* Instruction memory already in the scratch */
+    
     /* Sections */
     struct mgpu_coredump_header header;
-    struct mgpu_register_dump regs;
+    struct mgpu_reg_pair regs[MGPU_DUMP_MAX_REGS];
+    u32 num_regs;
     struct mgpu_shader_dump shaders;
     struct mgpu_error_dump error;
 };
 
+/* Snapshot reads don't need per-access ordering — the hardware is
+ * being sampled post-mortem, so the implicit barrier readl() pays on
+ * every access (a full dsb on arm64) is wasted ~25 times over.  Sweep
+ * with raw reads and publish with one rmb() at the end.  Everything
+ * that talks to live hardware keeps the ordered mgpu_read/mgpu_write */
+static inline u32 mgpu_read_raw(struct mgpu_device *mdev, u32 offset)
+{
+    return __raw_readl(mdev->mmio_base + offset);
+}
+
+/* Look up a captured register value in a pair list */
+static u32 mgpu_reg_pair_val(const struct mgpu_reg_pair *pairs, u32 count,
+                             u32 reg)
+{
+    u32 i;
+    
+    for (i = 0; i < count; i++) {
+        if (pairs[i].reg == reg)
+            return pairs[i].val;
+    }
+    return 0;
+}
+
 /* Helper to append data to coredump */
 static void mgpu_coredump_append(struct mgpu_coredump_state *state,
                                  const void *data, size_t len)
@@ -164,43 +218,78 @@ static void mgpu_coredump_append(struct mgpu_coredump_state *state,
 static void mgpu_coredump_capture_registers(struct mgpu_coredump_state *state)
 {
     struct mgpu_device *mdev = state->mdev;
-    struct mgpu_register_dump *regs = &state->regs;
-    int i;
-    
-    /* Base registers */
-    regs->base.version = mgpu_read(mdev, MGPU_REG_VERSION);
-    regs->base.caps = mgpu_read(mdev, MGPU_REG_CAPS);
-    regs->base.control = mgpu_read(mdev, MGPU_REG_CONTROL);
-    regs->base.status = mgpu_read(mdev, MGPU_REG_STATUS);
-    regs->base.scratch = mgpu_read(mdev, MGPU_REG_SCRATCH);
+    struct mgpu_reg_pair *pair = state->regs;
+    u32 i, q;
     
-    /* Interrupt registers */
-    regs->interrupt.irq_status = mgpu_read(mdev, MGPU_REG_IRQ_STATUS);
-    regs->interrupt.irq_enable = mgpu_read(mdev, MGPU_REG_IRQ_ENABLE);
+    for (i = 0; i < ARRAY_SIZE(mgpu_dump_regs); i++) {
+        pair->reg = mgpu_dump_regs[i];
+        pair->val = mgpu_read_raw(mdev, mgpu_dump_regs[i]);
+        pair++;
+    }
     
     /* Command queue registers for each queue */
-    for (i = 0; i < MGPU_MAX_QUEUES && i < mdev->num_queues; i++) {
-        u32 offset = i * 0x10;
-        regs->command_queue[i].cmd_base = mgpu_read(mdev, MGPU_REG_CMD_BASE + offset);
-        regs->command_queue[i].cmd_size = mgpu_read(mdev, MGPU_REG_CMD_SIZE + offset);
-        regs->command_queue[i].cmd_head = mgpu_read(mdev, MGPU_REG_CMD_HEAD + offset);
-        regs->command_queue[i].cmd_tail = mgpu_read(mdev, MGPU_REG_CMD_TAIL + offset);
+    for (q = 0; q < MGPU_MAX_QUEUES && q < mdev->num_queues; q++) {
+        u32 offset = q * 0x10;
+        static const u16 qregs[] = {
+            MGPU_REG_CMD_BASE, MGPU_REG_CMD_SIZE,
+            MGPU_REG_CMD_HEAD, MGPU_REG_CMD_TAIL,
+        };
+        
+        for (i = 0; i < ARRAY_SIZE(qregs); i++) {
+            pair->reg = qregs[i] + offset;
+            pair->val = mgpu_read_raw(mdev, qregs[i] + offset);
+            pair++;
+        }
     }
     
-    /* Fence registers */
-    regs->fence.fence_addr = mgpu_read(mdev, MGPU_REG_FENCE_ADDR);
-    regs->fence.fence_value = mgpu_read(mdev, MGPU_REG_FENCE_VALUE);
+    /* One barrier orders the whole sweep against later use */
+    rmb();
     
-    /* Vertex registers */
-    regs->vertex.vertex_base = mgpu_read(mdev, MGPU_REG_VERTEX_BASE);
-    regs->vertex.vertex_count = mgpu_read(mdev, MGPU_REG_VERTEX_COUNT);
-    regs->vertex.vertex_stride = mgpu_read(mdev, MGPU_REG_VERTEX_STRIDE);
+    state->num_regs = pair - state->regs;
+}
+
+/* SWAR zero-byte test on the low two bytes of a raw command header
+ * word: flags opcode == 0 or size == 0 in one compare-free operation
+ * (the textbook haszero trick).  The walk below is chained by each
+ * command's size field, so a flat 64-bit scan of the ring cannot
+ * replace it — instead the trick collapses the two data-dependent
+ * compares per header into a single well-predicted branch */
+static inline bool mgpu_cmd_hdr_terminates(u32 w)
+{
+    u32 lo = w & 0xffff;
     
-    /* Shader registers */
-    regs->shader.shader_pc = mgpu_read(mdev, MGPU_REG_SHADER_PC);
-    regs->shader.shader_addr = mgpu_read(mdev, MGPU_REG_SHADER_ADDR);
-    regs->shader.shader_data = mgpu_read(mdev, MGPU_REG_SHADER_DATA);
-    regs->shader.shader_ctrl = mgpu_read(mdev, MGPU_REG_SHADER_CTRL);
+    return ((lo - 0x0101) & ~lo & 0x8080) != 0;
+}
+
+/* Section sizes are pure arithmetic so the allocation can be sized in
+ * one pass, with no MMIO touched until the fill */
+static size_t mgpu_coredump_size_cmdring(struct mgpu_ring *ring)
+{
+    if (!ring)
+        return 0;
+    return sizeof(struct mgpu_cmdring_dump) + min(ring->size, 4096U);
+}
+
+static size_t mgpu_coredump_size_instrmem(struct mgpu_coredump_state *state)
+{
+    return hweight_long((unsigned long)state->shaders.active_slots) *
+           (sizeof(struct mgpu_instrmem_slot_dump) +
+            MGPU_INSTR_SLOT_DWORDS * 4);
+}
+
+/* Pull @dwords of ring contents starting at dword @start_dw into the
+ * dump, honoring the mapping type: rings in system RAM take the plain
+ * memcpy path, rings in an ioremapped aperture must go through
+ * memcpy_fromio (plain memcpy on __iomem is undefined and slow on WC) */
+static void mgpu_coredump_copy_ring(struct mgpu_ring *ring, void *dst,
+                                    u32 start_dw, u32 dwords)
+{
+    if (ring->iomem)
+        memcpy_fromio(dst,
+                      (const void __iomem *)ring->vaddr + start_dw * 4,
+                      dwords * 4);
+    else
+        memcpy(dst, (u32 *)ring->vaddr + start_dw, dwords * 4);
 }
 
 /* Capture command ring contents */
@@ -208,12 +297,12 @@ static size_t mgpu_coredump_capture_cmdring(struct mgpu_coredump_state *state,
                                             void *buffer, u32 queue_id)
 {
     struct mgpu_device *mdev = state->mdev;
-    struct mgpu_ring *ring = mdev->cmd_ring;  /* TODO: Support multiple rings */
+    struct mgpu_ring *ring = mdev->rings[queue_id];
     struct mgpu_cmdring_dump *dump = buffer;
     size_t dump_size;
     u32 ring_size;
     
-    if (!ring || queue_id != 0)
+    if (queue_id >= MGPU_MAX_QUEUES || !ring)
         return 0;
     
     /* Get ring state */
@@ -228,7 +317,24 @@ static size_t mgpu_coredump_capture_cmdring(struct mgpu_coredump_state *state,
     
     /* Copy ring contents if we have space */
     if (buffer && ring->vaddr) {
-        memcpy(dump->data, ring->vaddr, ring_size);
+        /* Snapshot the window ending at head: the most recently
+         * consumed commands are what a hang analysis wants.  Head and
+         * tail are dword indices and the ring size is a power of two,
+         * so the window is at most two segments of the circular
+         * buffer */
+        u32 ring_dw = ring->size / 4;
+        u32 snap_dw = ring_size / 4;
+        u32 start = (dump->head + ring_dw - snap_dw) & (ring_dw - 1);
+        
+        if (start + snap_dw <= ring_dw) {
+            mgpu_coredump_copy_ring(ring, dump->data, start, snap_dw);
+        } else {
+            u32 first = ring_dw - start;
+            
+            mgpu_coredump_copy_ring(ring, dump->data, start, first);
+            mgpu_coredump_copy_ring(ring, dump->data + first * 4, 0,
+                                    snap_dw - first);
+        }
         
         /* Count commands in ring */
         u32 *cmds = (u32 *)dump->data;
@@ -237,7 +343,7 @@ static size_t mgpu_coredump_capture_cmdring(struct mgpu_coredump_state *state,
         
         while (offset < ring_size / 4) {
             struct mgpu_cmd_header *hdr = (struct mgpu_cmd_header *)&cmds[offset];
-            if (hdr->opcode == 0 || hdr->size == 0)
+            if (mgpu_cmd_hdr_terminates(cmds[offset]))
                 break;
             count++;
             offset += hdr->size;
@@ -248,118 +354,537 @@ static size_t mgpu_coredump_capture_cmdring(struct mgpu_coredump_state *state,
     return dump_size;
 }
 
-/* Capture shader state */
+/* Capture shader state.  A one-memcpy snapshot is taken inside the
+ * shader manager so its mutex is held only for the copy; the decode
+ * below runs lock-free against the snapshot */
 static void mgpu_coredump_capture_shaders(struct mgpu_coredump_state *state)
 {
-    struct mgpu_device *mdev = state->mdev;
     struct mgpu_shader_dump *dump = &state->shaders;
-    struct mgpu_shader_mgr *mgr = mdev->shader_mgr;
+    struct mgpu_shader_slot_snap snap[16];
     int i;
     
-    if (!mgr)
-        return;
+    dump->active_slots = mgpu_shader_snapshot(state->mdev, snap, 16);
     
-    dump->active_slots = 0;
-    
-    mutex_lock(&mgr->lock);
     for (i = 0; i < 16; i++) {
-        if (mgr->slots[i].loaded) {
-            dump->slots[i].slot = i;
-            dump->slots[i].type = mgr->slots[i].type;
-            dump->slots[i].size = mgr->slots[i].size;
-            dump->slots[i].loaded = 1;
-            dump->active_slots |= (1 << i);
-            
-            /* Capture PC value for this slot */
-            dump->pc_values[i] = i * 256;  /* Each slot starts at offset i*256 */
-        }
+        if (!snap[i].loaded)
+            continue;
+        
+        dump->slots[i].slot = i;
+        dump->slots[i].type = snap[i].type;
+        dump->slots[i].size = snap[i].size;
+        dump->slots[i].loaded = 1;
+        
+        /* Capture PC value for this slot */
+        dump->pc_values[i] = i * 256;  /* Each slot starts at offset i*256 */
     }
-    mutex_unlock(&mgr->lock);
 }
 
-/* Capture instruction memory */
-static size_t mgpu_coredump_capture_instrmem(struct mgpu_coredump_state *state,
-                                             void *buffer)
+/* Try to pull instruction memory with the GPU's own copy engine: one
+ * DMA of the whole window from the bus-visible instruction-memory
+ * aperture into the probe-time scratch buffer, instead of thousands of
+ * individual data-port reads.  Only worth attempting while the GPU is
+ * still alive; a dead engine is caught by the poll timeout and the
+ * caller falls back to the MMIO port */
+static int mgpu_coredump_dma_instrmem(struct mgpu_device *mdev)
+{
+    struct mgpu_ring *ring = mdev->rings[0];
+    struct mgpu_cmd_dma cmd;
+    u32 dwords;
+    u32 status;
+    int ret;
+    
+    if (!mdev->coredump_scratch || !ring)
+        return -ENODEV;
+    
+    if (mgpu_read(mdev, MGPU_REG_STATUS) &
+        (MGPU_STATUS_HALTED | MGPU_STATUS_ERROR))
+        return -EIO;
+    
+    dwords = mgpu_dma_fill_cmd(mdev, &cmd,
+                               mdev->mmio_res->start +
+                               MGPU_REG_INSTR_MEM_BASE,
+                               mdev->coredump_scratch_dma,
+                               MGPU_REG_INSTR_MEM_SIZE);
+    
+    ret = mgpu_ring_submit_internal(ring, (const u32 *)&cmd, dwords);
+    if (ret)
+        return ret;
+    
+    return readl_poll_timeout(mdev->mmio_base + MGPU_REG_STATUS, status,
+                              status & MGPU_STATUS_IDLE, 10,
+                              100 * USEC_PER_MSEC);
+}
+
+/* Drain instruction memory through the shader data port.  When the
+ * hardware advertises an auto-incrementing port the address is
+ * programmed once and ioread32_rep() bursts back-to-back reads with no
+ * interleaved write postings, halving the MMIO transaction count;
+ * otherwise every word costs an address write plus a data read */
+static void mgpu_coredump_read_instrmem(struct mgpu_coredump_state *state,
+                                        u32 *buf, u32 start, u32 words)
 {
     struct mgpu_device *mdev = state->mdev;
-    u32 *instr_mem = buffer;
     u32 i;
     
-    if (!buffer)
-        return MGPU_REG_INSTR_MEM_SIZE;
+    /* The copy engine already landed the whole window in the scratch */
+    if (state->instr_from_dma) {
+        memcpy(buf, (u32 *)mdev->coredump_scratch + start, words * 4);
+        return;
+    }
+    
+    if (mdev->caps & MGPU_CAP_SHADER_AUTOINC) {
+        mgpu_write(mdev, MGPU_REG_SHADER_ADDR, start);
+        ioread32_rep(mdev->mmio_base + MGPU_REG_SHADER_DATA, buf, words);
+        return;
+    }
     
-    /* Read instruction memory through shader data port */
-    for (i = 0; i < MGPU_REG_INSTR_MEM_SIZE / 4; i++) {
-        mgpu_write(mdev, MGPU_REG_SHADER_ADDR, i);
-        instr_mem[i] = mgpu_read(mdev, MGPU_REG_SHADER_DATA);
+    for (i = 0; i < words; i++) {
+        mgpu_write(mdev, MGPU_REG_SHADER_ADDR, start + i);
+        buf[i] = mgpu_read(mdev, MGPU_REG_SHADER_DATA);
     }
+}
+
+/* Capture instruction memory.  Only the windows of loaded shader slots
+ * are dumped; on a typical hang (one to four slots of sixteen loaded)
+ * skipping the idle ones cuts this purely MMIO-bound sweep by an order
+ * of magnitude.  Requires capture_shaders to have run first */
+static size_t mgpu_coredump_capture_instrmem(struct mgpu_coredump_state *state,
+                                             void *buffer)
+{
+    unsigned long active = state->shaders.active_slots;
+    size_t slot_bytes = sizeof(struct mgpu_instrmem_slot_dump) +
+                        MGPU_INSTR_SLOT_DWORDS * 4;
+    void *out = buffer;
+    unsigned int i;
     
-    return MGPU_REG_INSTR_MEM_SIZE;
+    for_each_set_bit(i, &active, 16) {
+        struct mgpu_instrmem_slot_dump *hdr = out;
+        
+        hdr->slot = i;
+        hdr->base = i * MGPU_INSTR_SLOT_DWORDS;
+        hdr->size = MGPU_INSTR_SLOT_DWORDS * 4;
+        mgpu_coredump_read_instrmem(state, out + sizeof(*hdr),
+                                    hdr->base, MGPU_INSTR_SLOT_DWORDS);
+        out += slot_bytes;
+    }
+    
+    return out - buffer;
 }
 
-/* Capture error information */
+/* Capture error information, entirely from the values already sampled
+ * into the state — no MMIO here */
 static void mgpu_coredump_capture_error(struct mgpu_coredump_state *state)
 {
-    struct mgpu_device *mdev = state->mdev;
     struct mgpu_error_dump *error = &state->error;
-    u32 status = mgpu_read(mdev, MGPU_REG_STATUS);
+    u32 status = state->status;
+    size_t pos = 0;
     
     error->error_code = 0;
     error->error_address = 0;
     error->error_data = 0;
-    error->timestamp = ktime_get_real_ns();
+    error->timestamp = state->now;
     
-    /* Check error status */
+    /* Build the description with a position cursor: each append is
+     * O(append) instead of the O(strlen) rescan strncat costs, and the
+     * result is always NUL-terminated */
     if (status & MGPU_STATUS_ERROR) {
         /* Extract error code (would need extended registers in real hardware) */
         error->error_code = MGPU_ERROR_INVALID_CMD;  /* Example */
-        snprintf(error->description, sizeof(error->description),
-                 "GPU error detected: status=0x%08x", status);
+        pos += scnprintf(error->description + pos,
+                         sizeof(error->description) - pos,
+                         "GPU error detected: status=0x%08x", status);
     }
     
     if (status & MGPU_STATUS_HALTED) {
         error->hang_detected = 1;
-        error->last_fence = mgpu_read(mdev, MGPU_REG_FENCE_VALUE);
-        error->last_cmd_head = mgpu_read(mdev, MGPU_REG_CMD_HEAD);
-        strncat(error->description, " GPU halted/hung.", 
-                sizeof(error->description) - strlen(error->description) - 1);
+        error->last_fence = state->fence_value;
+        error->last_cmd_head = state->cmd_head;
+        pos += scnprintf(error->description + pos,
+                         sizeof(error->description) - pos,
+                         " GPU halted/hung.");
     }
     
     if (status & MGPU_STATUS_CMD_FULL) {
-        strncat(error->description, " Command queue full.", 
-                sizeof(error->description) - strlen(error->description) - 1);
+        pos += scnprintf(error->description + pos,
+                         sizeof(error->description) - pos,
+                         " Command queue full.");
+    }
+}
+
+/* Capture runs after a hang, possibly with the system already under
+ * reclaim: stay out of the I/O path (GFP_NOIO), never warn, and avoid
+ * high-order allocator pressure — small buffers take the kmalloc fast
+ * path, anything larger goes straight to vmalloc.  Free with kvfree() */
+static void *mgpu_coredump_alloc(size_t n)
+{
+    void *p = NULL;
+    
+    if (n <= 2 * PAGE_SIZE)
+        p = kmalloc(n, GFP_NOIO | __GFP_NOWARN);
+    if (!p)
+        p = __vmalloc(n, GFP_NOIO | __GFP_NOWARN);
+    return p;
+}
+
+/* Section emitters for the linear path: each writes its payload at
+ * @buf and returns the byte count.  The descriptor table below drives
+ * both the directory entry and the payload, so adding a section is one
+ * emitter plus one table line instead of another copy-pasted block */
+static size_t mgpu_dump_emit_regs(struct mgpu_coredump_state *state, void *buf)
+{
+    size_t len = state->num_regs * sizeof(struct mgpu_reg_pair);
+    
+    memcpy(buf, state->regs, len);
+    return len;
+}
+
+static size_t mgpu_dump_emit_cmdring(struct mgpu_coredump_state *state,
+                                     void *buf)
+{
+    return mgpu_coredump_capture_cmdring(state, buf, 0);
+}
+
+static size_t mgpu_dump_emit_shaders(struct mgpu_coredump_state *state,
+                                     void *buf)
+{
+    memcpy(buf, &state->shaders, sizeof(state->shaders));
+    return sizeof(state->shaders);
+}
+
+static size_t mgpu_dump_emit_instrmem(struct mgpu_coredump_state *state,
+                                      void *buf)
+{
+    return mgpu_coredump_capture_instrmem(state, buf);
+}
+
+static size_t mgpu_dump_emit_error(struct mgpu_coredump_state *state,
+                                   void *buf)
+{
+    memcpy(buf, &state->error, sizeof(state->error));
+    return sizeof(state->error);
+}
+
+static const struct {
+    u32 type;
+    const char *name;
+    size_t (*emit)(struct mgpu_coredump_state *state, void *buf);
+} mgpu_dump_desc[] = {
+    { MGPU_DUMP_REGISTERS,    "registers",          mgpu_dump_emit_regs },
+    { MGPU_DUMP_COMMAND_RING, "command_ring",       mgpu_dump_emit_cmdring },
+    { MGPU_DUMP_SHADER_STATE, "shaders",            mgpu_dump_emit_shaders },
+    { MGPU_DUMP_INSTR_MEM,    "instruction_memory", mgpu_dump_emit_instrmem },
+    { MGPU_DUMP_ERROR_INFO,   "error_info",         mgpu_dump_emit_error },
+};
+
+/* Paged assembly for dev_coredumpsg(): devcoredump releases each sg
+ * entry with __free_page, so the dump is built from individually
+ * allocated pages and this cursor handles writes that straddle page
+ * boundaries */
+struct mgpu_sg_cursor {
+    struct scatterlist *sg;
+    void *vaddr;
+    size_t page_off;
+};
+
+static void mgpu_sg_emit(struct mgpu_sg_cursor *cur, const void *data,
+                         size_t len)
+{
+    while (len) {
+        size_t chunk;
+        
+        if (cur->page_off == PAGE_SIZE) {
+            cur->sg = sg_next(cur->sg);
+            cur->vaddr = page_address(sg_page(cur->sg));
+            cur->page_off = 0;
+        }
+        
+        chunk = min(len, PAGE_SIZE - cur->page_off);
+        memcpy(cur->vaddr + cur->page_off, data, chunk);
+        cur->page_off += chunk;
+        data += chunk;
+        len -= chunk;
+    }
+}
+
+/* Like mgpu_sg_emit() but sourced from ring memory, so the mapping
+ * type is honored on every page-sized chunk */
+static void mgpu_sg_emit_ring(struct mgpu_sg_cursor *cur,
+                              struct mgpu_ring *ring, u32 start_dw,
+                              u32 dwords)
+{
+    while (dwords) {
+        u32 chunk;
+        
+        if (cur->page_off == PAGE_SIZE) {
+            cur->sg = sg_next(cur->sg);
+            cur->vaddr = page_address(sg_page(cur->sg));
+            cur->page_off = 0;
+        }
+        
+        chunk = min_t(u32, dwords, (PAGE_SIZE - cur->page_off) / 4);
+        mgpu_coredump_copy_ring(ring, cur->vaddr + cur->page_off,
+                                start_dw, chunk);
+        cur->page_off += chunk * 4;
+        start_dw += chunk;
+        dwords -= chunk;
+    }
+}
+
+static void mgpu_coredump_free_sgt(struct sg_table *sgt)
+{
+    struct scatterlist *sg;
+    int i;
+    
+    for_each_sg(sgt->sgl, sg, sgt->nents, i) {
+        if (sg_page(sg))
+            __free_page(sg_page(sg));
     }
+    sg_free_table(sgt);
+    kfree(sgt);
+}
+
+/* Fill one type-indexed directory slot and advance the payload
+ * offset; sections that are never set stay zero-sized */
+static void mgpu_sg_dir_set(struct mgpu_coredump_section_header *sections,
+                            u32 type, const char *name, size_t size,
+                            size_t *offset)
+{
+    sections[type].type = type;
+    sections[type].offset = *offset;
+    sections[type].size = size;
+    strscpy(sections[type].name, name, sizeof(sections[type].name));
+    *offset += size;
 }
 
-/* Create coredump */
-static void *mgpu_coredump_create(struct mgpu_device *mdev, size_t *dump_size)
+/* Assemble the dump straight into order-0 pages for dev_coredumpsg().
+ * Compared to the linear path this avoids the kvmalloc(total_size)
+ * large allocation and the bounce copy of the ring and instruction
+ * memory payloads, which matters on the low-memory hung-GPU path */
+static struct sg_table *mgpu_coredump_create_sg(struct mgpu_device *mdev,
+                                                size_t *dump_size)
+{
+    struct mgpu_coredump_state state = {0};
+    struct mgpu_coredump_section_header sections[MGPU_DUMP_END] = {0};
+    struct mgpu_cmdring_dump ring_hdr = {0};
+    struct mgpu_sg_cursor cur = {0};
+    struct mgpu_ring *ring = mdev->rings[0];
+    struct sg_table *sgt;
+    struct scatterlist *sg;
+    size_t total_size, offset, ring_bytes = 0, instr_bytes;
+    int npages, i;
+    
+    state.mdev = mdev;
+    mgpu_coredump_capture_registers(&state);    
+    /* One sweep, one clock read; everything below consumes these */
+    state.now = ktime_get_real_ns();
+    state.status = mgpu_reg_pair_val(state.regs, state.num_regs,
+                                     MGPU_REG_STATUS);
+    state.fence_value = mgpu_reg_pair_val(state.regs, state.num_regs,
+                                          MGPU_REG_FENCE_VALUE);
+    state.cmd_head = mgpu_reg_pair_val(state.regs, state.num_regs,
+                                       MGPU_REG_CMD_HEAD);
+    mgpu_coredump_capture_shaders(&state);
+    
+    /* Land instruction memory via the copy engine if the GPU can still
+     * do that; the per-window reads then come out of the scratch */
+    if (state.shaders.active_slots)
+        state.instr_from_dma = mgpu_coredump_dma_instrmem(mdev) == 0;
+    
+    mgpu_coredump_capture_error(&state);
+    
+    if (ring) {
+        u32 *cmds = ring->vaddr;
+        u32 count = 0, pos = 0;
+        
+        ring_bytes = min(ring->size, 4096U);
+        ring_hdr.queue_id = 0;
+        ring_hdr.size = ring->size;
+        ring_hdr.head = mgpu_read(mdev, MGPU_REG_CMD_HEAD);
+        ring_hdr.tail = mgpu_read(mdev, MGPU_REG_CMD_TAIL);
+        
+        while (pos < ring_bytes / 4) {
+            struct mgpu_cmd_header *hdr = (struct mgpu_cmd_header *)&cmds[pos];
+            if (mgpu_cmd_hdr_terminates(cmds[pos]))
+                break;
+            count++;
+            pos += hdr->size;
+        }
+        ring_hdr.num_commands = count;
+    }
+    
+    total_size = sizeof(state.header);
+    total_size += sizeof(sections);
+    total_size += state.num_regs * sizeof(struct mgpu_reg_pair);
+    if (ring)
+        total_size += sizeof(ring_hdr) + ring_bytes;
+    total_size += sizeof(state.shaders);
+    instr_bytes = mgpu_coredump_size_instrmem(&state);
+    total_size += instr_bytes;
+    total_size += sizeof(state.error);
+    
+    sgt = kzalloc(sizeof(*sgt), GFP_NOIO | __GFP_NOWARN);
+    if (!sgt)
+        return NULL;
+    
+    npages = DIV_ROUND_UP(total_size, PAGE_SIZE);
+    if (sg_alloc_table(sgt, npages, GFP_NOIO | __GFP_NOWARN)) {
+        kfree(sgt);
+        return NULL;
+    }
+    
+    for_each_sg(sgt->sgl, sg, sgt->nents, i) {
+        struct page *page = alloc_page(GFP_NOIO | __GFP_NOWARN |
+                                       __GFP_ZERO);
+        
+        if (!page)
+            goto err_free;
+        sg_set_page(sg, page, PAGE_SIZE, 0);
+    }
+    
+    /* Section directory is laid out before emission; all sizes are
+     * already known.  Indexed by section type like the linear path -
+     * when the ring section is absent its slot just stays zero-sized
+     * - so the type-indexed parser works on both producers */
+    offset = sizeof(state.header) + sizeof(sections);
+
+    mgpu_sg_dir_set(sections, MGPU_DUMP_REGISTERS, "registers",
+                    state.num_regs * sizeof(struct mgpu_reg_pair), &offset);
+    if (ring)
+        mgpu_sg_dir_set(sections, MGPU_DUMP_COMMAND_RING, "command_ring",
+                        sizeof(ring_hdr) + ring_bytes, &offset);
+    mgpu_sg_dir_set(sections, MGPU_DUMP_SHADER_STATE, "shaders",
+                    sizeof(state.shaders), &offset);
+    mgpu_sg_dir_set(sections, MGPU_DUMP_INSTR_MEM, "instruction_memory",
+                    instr_bytes, &offset);
+    mgpu_sg_dir_set(sections, MGPU_DUMP_ERROR_INFO, "error_info",
+                    sizeof(state.error), &offset);
+
+    state.header.magic = MGPU_COREDUMP_MAGIC;
+    state.header.version = MGPU_COREDUMP_VERSION;
+    state.header.timestamp = state.now;
+    state.header.gpu_version = mgpu_reg_pair_val(state.regs, state.num_regs,
+                                                 MGPU_REG_VERSION);
+    state.header.gpu_caps = mgpu_reg_pair_val(state.regs, state.num_regs,
+                                              MGPU_REG_CAPS);
+    state.header.error_status = state.status;
+    state.header.error_code = state.error.error_code;
+    state.header.reset_count = atomic_read(&mdev->reset_count);
+    state.header.num_sections = MGPU_DUMP_END;
+    state.header.total_size = total_size;
+    strscpy(state.header.kernel_version, utsname()->release,
+            sizeof(state.header.kernel_version));
+    snprintf(state.header.driver_version, sizeof(state.header.driver_version),
+             "%d.%d", DRIVER_MAJOR, DRIVER_MINOR);
+    
+    cur.sg = sgt->sgl;
+    cur.vaddr = page_address(sg_page(cur.sg));
+    
+    mgpu_sg_emit(&cur, &state.header, sizeof(state.header));
+    mgpu_sg_emit(&cur, sections, sizeof(sections));
+    mgpu_sg_emit(&cur, state.regs,
+                 state.num_regs * sizeof(struct mgpu_reg_pair));
+    if (ring) {
+        /* Same wrap-aware window as the linear path: up to two
+         * segments ending at head */
+        u32 ring_dw = ring->size / 4;
+        u32 snap_dw = ring_bytes / 4;
+        u32 start = (ring_hdr.head + ring_dw - snap_dw) & (ring_dw - 1);
+        
+        mgpu_sg_emit(&cur, &ring_hdr, sizeof(ring_hdr));
+        if (start + snap_dw <= ring_dw) {
+            mgpu_sg_emit_ring(&cur, ring, start, snap_dw);
+        } else {
+            u32 first = ring_dw - start;
+            
+            mgpu_sg_emit_ring(&cur, ring, start, first);
+            mgpu_sg_emit_ring(&cur, ring, 0, snap_dw - first);
+        }
+    }
+    mgpu_sg_emit(&cur, &state.shaders, sizeof(state.shaders));
+    
+    /* Instruction memory: one window per loaded slot, staged through a
+     * stack-sized bounce so a window can straddle a page boundary */
+    {
+        unsigned long active = state.shaders.active_slots;
+        u32 win[MGPU_INSTR_SLOT_DWORDS];
+        struct mgpu_instrmem_slot_dump shdr;
+        unsigned int slot;
+        
+        for_each_set_bit(slot, &active, 16) {
+            shdr.slot = slot;
+            shdr.base = slot * MGPU_INSTR_SLOT_DWORDS;
+            shdr.size = sizeof(win);
+            mgpu_coredump_read_instrmem(&state, win, shdr.base,
+                                        MGPU_INSTR_SLOT_DWORDS);
+            mgpu_sg_emit(&cur, &shdr, sizeof(shdr));
+            mgpu_sg_emit(&cur, win, sizeof(win));
+        }
+    }
+    
+    mgpu_sg_emit(&cur, &state.error, sizeof(state.error));
+    
+    *dump_size = total_size;
+    return sgt;
+    
+err_free:
+    mgpu_coredump_free_sgt(sgt);
+    return NULL;
+}
+
+/* Create coredump.  When the probe-time persistent buffer is free and
+ * large enough the dump is assembled in place there and *persistent is
+ * set — no allocator involvement at all on the hang path */
+static void *mgpu_coredump_create(struct mgpu_device *mdev, size_t *dump_size,
+                                  bool *persistent)
 {
     struct mgpu_coredump_state state = {0};
     struct mgpu_coredump_section_header *sections;
     void *dump_data;
     size_t total_size;
-    int num_sections = 0;
+    int i;
     
     state.mdev = mdev;
     
     /* Capture state */
-    mgpu_coredump_capture_registers(&state);
+    mgpu_coredump_capture_registers(&state);    
+    /* One sweep, one clock read; everything below consumes these */
+    state.now = ktime_get_real_ns();
+    state.status = mgpu_reg_pair_val(state.regs, state.num_regs,
+                                     MGPU_REG_STATUS);
+    state.fence_value = mgpu_reg_pair_val(state.regs, state.num_regs,
+                                          MGPU_REG_FENCE_VALUE);
+    state.cmd_head = mgpu_reg_pair_val(state.regs, state.num_regs,
+                                       MGPU_REG_CMD_HEAD);
     mgpu_coredump_capture_shaders(&state);
+    
+    /* Land instruction memory via the copy engine if the GPU can still
+     * do that; the per-window reads then come out of the scratch */
+    if (state.shaders.active_slots)
+        state.instr_from_dma = mgpu_coredump_dma_instrmem(mdev) == 0;
+    
     mgpu_coredump_capture_error(&state);
     
     /* Calculate total size needed */
     total_size = sizeof(struct mgpu_coredump_header);
     total_size += sizeof(struct mgpu_coredump_section_header) * MGPU_DUMP_END;
-    total_size += sizeof(struct mgpu_register_dump);
-    total_size += mgpu_coredump_capture_cmdring(&state, NULL, 0);
+    total_size += state.num_regs * sizeof(struct mgpu_reg_pair);
+    total_size += mgpu_coredump_size_cmdring(mdev->rings[0]);
     total_size += sizeof(struct mgpu_shader_dump);
-    total_size += mgpu_coredump_capture_instrmem(&state, NULL);
+    total_size += mgpu_coredump_size_instrmem(&state);
     total_size += sizeof(struct mgpu_error_dump);
     
-    /* Allocate dump buffer */
-    dump_data = kvmalloc(total_size, GFP_KERNEL);
-    if (!dump_data)
-        return NULL;
+    /* Prefer the persistent buffer; claim it with an atomic flag since
+     * devcoredump releases it from its own context later */
+    *persistent = false;
+    if (mdev->coredump_buf && total_size <= mdev->coredump_buf_size &&
+        atomic_cmpxchg(&mdev->coredump_buf_busy, 0, 1) == 0) {
+        dump_data = mdev->coredump_buf;
+        *persistent = true;
+    } else {
+        dump_data = mgpu_coredump_alloc(total_size);
+        if (!dump_data)
+            return NULL;
+    }
     
     state.data = dump_data;
     state.size = total_size;
@@ -368,15 +893,17 @@ static void *mgpu_coredump_create(struct mgpu_device *mdev, size_t *dump_size)
     /* Fill header */
     state.header.magic = MGPU_COREDUMP_MAGIC;
     state.header.version = MGPU_COREDUMP_VERSION;
-    state.header.timestamp = ktime_get_real_ns();
-    state.header.gpu_version = state.regs.base.version;
-    state.header.gpu_caps = state.regs.base.caps;
-    state.header.error_status = state.regs.base.status;
+    state.header.timestamp = state.now;
+    state.header.gpu_version = mgpu_reg_pair_val(state.regs, state.num_regs,
+                                                 MGPU_REG_VERSION);
+    state.header.gpu_caps = mgpu_reg_pair_val(state.regs, state.num_regs,
+                                              MGPU_REG_CAPS);
+    state.header.error_status = state.status;
     state.header.error_code = state.error.error_code;
     state.header.reset_count = atomic_read(&mdev->reset_count);
     state.header.total_size = total_size;
-    strncpy(state.header.kernel_version, utsname()->release,
-            sizeof(state.header.kernel_version) - 1);
+    strscpy(state.header.kernel_version, utsname()->release,
+            sizeof(state.header.kernel_version));
     snprintf(state.header.driver_version, sizeof(state.header.driver_version),
              "%d.%d", DRIVER_MAJOR, DRIVER_MINOR);
     
@@ -387,95 +914,210 @@ static void *mgpu_coredump_create(struct mgpu_device *mdev, size_t *dump_size)
     sections = (struct mgpu_coredump_section_header *)(state.data + state.offset);
     state.offset += sizeof(struct mgpu_coredump_section_header) * MGPU_DUMP_END;
     
-    /* Write sections */
-    
-    /* Register dump */
-    sections[num_sections].type = MGPU_DUMP_REGISTERS;
-    sections[num_sections].offset = state.offset;
-    sections[num_sections].size = sizeof(struct mgpu_register_dump);
-    strncpy(sections[num_sections].name, "registers", 31);
-    mgpu_coredump_append(&state, &state.regs, sizeof(state.regs));
-    num_sections++;
-    
-    /* Command ring dump */
-    sections[num_sections].type = MGPU_DUMP_COMMAND_RING;
-    sections[num_sections].offset = state.offset;
-    sections[num_sections].size = mgpu_coredump_capture_cmdring(&state, 
-                                                                 state.data + state.offset, 0);
-    strncpy(sections[num_sections].name, "command_ring", 31);
-    state.offset += sections[num_sections].size;
-    num_sections++;
-    
-    /* Shader state */
-    sections[num_sections].type = MGPU_DUMP_SHADER_STATE;
-    sections[num_sections].offset = state.offset;
-    sections[num_sections].size = sizeof(struct mgpu_shader_dump);
-    strncpy(sections[num_sections].name, "shaders", 31);
-    mgpu_coredump_append(&state, &state.shaders, sizeof(state.shaders));
-    num_sections++;
-    
-    /* Instruction memory */
-    sections[num_sections].type = MGPU_DUMP_INSTR_MEM;
-    sections[num_sections].offset = state.offset;
-    sections[num_sections].size = mgpu_coredump_capture_instrmem(&state,
-                                                                  state.data + state.offset);
-    strncpy(sections[num_sections].name, "instruction_memory", 31);
-    state.offset += sections[num_sections].size;
-    num_sections++;
-    
-    /* Error info */
-    sections[num_sections].type = MGPU_DUMP_ERROR_INFO;
-    sections[num_sections].offset = state.offset;
-    sections[num_sections].size = sizeof(struct mgpu_error_dump);
-    strncpy(sections[num_sections].name, "error_info", 31);
-    mgpu_coredump_append(&state, &state.error, sizeof(state.error));
-    num_sections++;
+    /* Write sections from the descriptor table.  The directory is
+     * indexed by section type — an absent section's slot just stays
+     * zero-sized — so the parser can index directly instead of
+     * scanning */
+    for (i = 0; i < ARRAY_SIZE(mgpu_dump_desc); i++) {
+        u32 t = mgpu_dump_desc[i].type;
+        
+        sections[t].type = t;
+        sections[t].offset = state.offset;
+        sections[t].size = mgpu_dump_desc[i].emit(&state,
+                                                  state.data + state.offset);
+        strscpy(sections[t].name, mgpu_dump_desc[i].name,
+                sizeof(sections[t].name));
+        state.offset += sections[t].size;
+    }
     
     /* Update header with section count */
-    ((struct mgpu_coredump_header *)dump_data)->num_sections = num_sections;
+    ((struct mgpu_coredump_header *)dump_data)->num_sections = MGPU_DUMP_END;
     
     *dump_size = state.offset;
     
     return dump_data;
 }
 
-/* Trigger coredump capture */
-void mgpu_coredump_capture(struct mgpu_device *mdev, const char *reason)
+/* Compress everything after the header in place of the raw blob.
+ * Returns the buffer to hand to devcoredump (caller-owned) and updates
+ * *dump_size; on any failure the raw dump is returned untouched */
+static void *mgpu_coredump_compress(struct mgpu_device *mdev, void *raw,
+                                    size_t *dump_size, bool *persistent)
+{
+    const size_t hdr_len = sizeof(struct mgpu_coredump_header);
+    struct mgpu_coredump_header *header;
+    size_t payload = *dump_size - hdr_len;
+    void *out = NULL;
+    void *wrkmem = NULL;
+    int clen;
+    
+    if (strcmp(compress, "lz4") != 0 || *dump_size <= hdr_len)
+        return raw;
+    
+    out = mgpu_coredump_alloc(hdr_len + LZ4_compressBound(payload));
+    wrkmem = mgpu_coredump_alloc(LZ4_MEM_COMPRESS);
+    if (!out || !wrkmem)
+        goto out_raw;
+    
+    clen = LZ4_compress_default(raw + hdr_len, out + hdr_len, payload,
+                                LZ4_compressBound(payload), wrkmem);
+    if (clen <= 0 || clen >= payload)
+        goto out_raw;  /* Incompressible; keep the raw blob */
+    
+    memcpy(out, raw, hdr_len);
+    header = out;
+    header->flags |= MGPU_COREDUMP_FLAG_LZ4;
+    header->compressed_size = clen;
+    
+    kvfree(wrkmem);
+    if (*persistent) {
+        /* Everything was copied out; release the buffer for reuse */
+        atomic_set(&mdev->coredump_buf_busy, 0);
+        *persistent = false;
+    } else {
+        kvfree(raw);
+    }
+    *dump_size = hdr_len + clen;
+    return out;
+    
+out_raw:
+    kvfree(out);
+    kvfree(wrkmem);
+    return raw;
+}
+
+/* devcoredump callbacks for the persistent buffer: reads come straight
+ * out of it, and release only clears the busy flag (a mutex would not
+ * do here — devcoredump releases from its own context, and a mutex
+ * must be unlocked by its locker) */
+static ssize_t mgpu_coredump_read_cb(char *buffer, loff_t offset,
+                                     size_t count, void *data,
+                                     size_t datalen)
+{
+    struct mgpu_device *mdev = data;
+    
+    if (offset >= datalen)
+        return 0;
+    
+    count = min_t(size_t, count, datalen - offset);
+    memcpy(buffer, mdev->coredump_buf + offset, count);
+    return count;
+}
+
+static void mgpu_coredump_release_cb(void *data)
+{
+    struct mgpu_device *mdev = data;
+    
+    atomic_set(&mdev->coredump_buf_busy, 0);
+}
+
+/* Deferred capture worker.  The hang paths that trigger a dump (IRQ
+ * tasklet, reset) must not absorb the cost of the MMIO sweep plus
+ * compression, so the real work runs here on system_unbound_wq */
+static void mgpu_coredump_work_fn(struct work_struct *work)
 {
+    struct mgpu_device *mdev = container_of(work, struct mgpu_device,
+                                            coredump_work);
     void *dump_data;
     size_t dump_size;
+    bool persistent;
     
-    dev_warn(mdev->dev, "Capturing GPU coredump: %s\n", reason ?: "unknown");
+    dev_warn(mdev->dev, "Capturing GPU coredump: %s\n",
+             mdev->coredump_reason);
+    
+    /* Uncompressed dumps go out as a page list; compression needs a
+     * contiguous buffer anyway, so that path stays linear */
+    if (strcmp(compress, "lz4") != 0) {
+        struct sg_table *sgt = mgpu_coredump_create_sg(mdev, &dump_size);
+        
+        if (sgt) {
+            dev_coredumpsg(mdev->dev, sgt, dump_size, GFP_NOIO);
+            dev_info(mdev->dev, "GPU coredump saved (%zu bytes)\n",
+                     dump_size);
+            return;
+        }
+        /* Fall back to the linear buffer path */
+    }
     
     /* Create coredump */
-    dump_data = mgpu_coredump_create(mdev, &dump_size);
+    dump_data = mgpu_coredump_create(mdev, &dump_size, &persistent);
     if (!dump_data) {
         dev_err(mdev->dev, "Failed to create coredump\n");
         return;
     }
     
-    /* Submit to devcoredump subsystem */
-    dev_coredumpv(mdev->dev, dump_data, dump_size, GFP_KERNEL);
+    dump_data = mgpu_coredump_compress(mdev, dump_data, &dump_size,
+                                       &persistent);
     
-    /* Note: devcoredump will free dump_data */
+    /* Submit to devcoredump.  The persistent buffer must not be freed
+     * by devcoredump — hand it over via callbacks that just clear the
+     * busy flag on release; transient buffers go the usual
+     * dev_coredumpv route and are freed by devcoredump */
+    if (persistent)
+        dev_coredumpm(mdev->dev, THIS_MODULE, mdev, dump_size, GFP_NOIO,
+                      mgpu_coredump_read_cb, mgpu_coredump_release_cb);
+    else
+        dev_coredumpv(mdev->dev, dump_data, dump_size, GFP_NOIO);
     
     dev_info(mdev->dev, "GPU coredump saved (%zu bytes)\n", dump_size);
 }
 
+/* Trigger coredump capture.  Costs the caller a strscpy and a
+ * queue_work; if a capture is already pending, concurrent hang reports
+ * coalesce into it (their reasons differ by at most the string) */
+void mgpu_coredump_capture(struct mgpu_device *mdev, const char *reason)
+{
+    strscpy(mdev->coredump_reason, reason ?: "unknown",
+            sizeof(mdev->coredump_reason));
+    queue_work(system_unbound_wq, &mdev->coredump_work);
+}
+
 /* Parse and print coredump (for debugging) */
 void mgpu_coredump_print(struct mgpu_device *mdev, const void *data, size_t size)
 {
     const struct mgpu_coredump_header *header = data;
     const struct mgpu_coredump_section_header *sections;
-    const struct mgpu_register_dump *regs;
+    const struct mgpu_coredump_section_header *sec;
+    const struct mgpu_reg_pair *regs;
     const struct mgpu_error_dump *error;
-    int i;
+    void *inflated = NULL;
     
     if (size < sizeof(*header) || header->magic != MGPU_COREDUMP_MAGIC) {
         dev_err(mdev->dev, "Invalid coredump data\n");
         return;
     }
     
+    /* The v2 re-layout moved fields; refuse to misparse older dumps */
+    if (header->version != MGPU_COREDUMP_VERSION) {
+        dev_err(mdev->dev, "Unsupported coredump version %u\n",
+                header->version);
+        return;
+    }
+    
+    /* Inflate a compressed dump so the section parsing below can keep
+     * using uncompressed offsets */
+    if (header->flags & MGPU_COREDUMP_FLAG_LZ4) {
+        const size_t hdr_len = sizeof(*header);
+        int dlen;
+        
+        inflated = kvmalloc(header->total_size, GFP_KERNEL);
+        if (!inflated)
+            return;
+        
+        memcpy(inflated, data, hdr_len);
+        dlen = LZ4_decompress_safe(data + hdr_len, inflated + hdr_len,
+                                   header->compressed_size,
+                                   header->total_size - hdr_len);
+        if (dlen < 0) {
+            dev_err(mdev->dev, "Corrupt compressed coredump\n");
+            kvfree(inflated);
+            return;
+        }
+        
+        data = inflated;
+        header = data;
+    }
+    
     dev_info(mdev->dev, "=== GPU Coredump ===\n");
     dev_info(mdev->dev, "Version: %u\n", header->version);
     dev_info(mdev->dev, "Timestamp: %llu\n", header->timestamp);
@@ -488,35 +1130,72 @@ void mgpu_coredump_print(struct mgpu_device *mdev, const void *data, size_t size
     
     sections = (const struct mgpu_coredump_section_header *)(data + sizeof(*header));
     
-    /* Find and print register dump */
-    for (i = 0; i < header->num_sections; i++) {
-        if (sections[i].type == MGPU_DUMP_REGISTERS) {
-            regs = data + sections[i].offset;
-            dev_info(mdev->dev, "\n=== Registers ===\n");
-            dev_info(mdev->dev, "Control: 0x%08x\n", regs->base.control);
-            dev_info(mdev->dev, "Status: 0x%08x\n", regs->base.status);
-            dev_info(mdev->dev, "IRQ Status: 0x%08x\n", regs->interrupt.irq_status);
-            dev_info(mdev->dev, "CMD Head: 0x%08x\n", regs->command_queue[0].cmd_head);
-            dev_info(mdev->dev, "CMD Tail: 0x%08x\n", regs->command_queue[0].cmd_tail);
-            dev_info(mdev->dev, "Fence Value: 0x%08x\n", regs->fence.fence_value);
-        }
+    /* The directory is indexed by type since v2: no scan, just bounds
+     * checks against what the producer wrote */
+    sec = &sections[MGPU_DUMP_REGISTERS];
+    if (MGPU_DUMP_REGISTERS < header->num_sections && sec->size) {
+        u32 nregs = sec->size / sizeof(*regs);
         
-        if (sections[i].type == MGPU_DUMP_ERROR_INFO) {
-            error = data + sections[i].offset;
-            dev_info(mdev->dev, "\n=== Error Info ===\n");
-            dev_info(mdev->dev, "Error Code: 0x%08x\n", error->error_code);
-            dev_info(mdev->dev, "Hang Detected: %s\n", error->hang_detected ? "Yes" : "No");
-            dev_info(mdev->dev, "Description: %s\n", error->description);
-        }
+        regs = data + sec->offset;
+        dev_info(mdev->dev, "\n=== Registers ===\n");
+        dev_info(mdev->dev, "Control: 0x%08x\n",
+                 mgpu_reg_pair_val(regs, nregs, MGPU_REG_CONTROL));
+        dev_info(mdev->dev, "Status: 0x%08x\n",
+                 mgpu_reg_pair_val(regs, nregs, MGPU_REG_STATUS));
+        dev_info(mdev->dev, "IRQ Status: 0x%08x\n",
+                 mgpu_reg_pair_val(regs, nregs, MGPU_REG_IRQ_STATUS));
+        dev_info(mdev->dev, "CMD Head: 0x%08x\n",
+                 mgpu_reg_pair_val(regs, nregs, MGPU_REG_CMD_HEAD));
+        dev_info(mdev->dev, "CMD Tail: 0x%08x\n",
+                 mgpu_reg_pair_val(regs, nregs, MGPU_REG_CMD_TAIL));
+        dev_info(mdev->dev, "Fence Value: 0x%08x\n",
+                 mgpu_reg_pair_val(regs, nregs, MGPU_REG_FENCE_VALUE));
+    }
+    
+    sec = &sections[MGPU_DUMP_ERROR_INFO];
+    if (MGPU_DUMP_ERROR_INFO < header->num_sections && sec->size) {
+        error = data + sec->offset;
+        dev_info(mdev->dev, "\n=== Error Info ===\n");
+        dev_info(mdev->dev, "Error Code: 0x%08x\n", error->error_code);
+        dev_info(mdev->dev, "Hang Detected: %s\n",
+                 error->hang_detected ? "Yes" : "No");
+        dev_info(mdev->dev, "Description: %s\n", error->description);
     }
     
     dev_info(mdev->dev, "====================\n");
+    
+    kvfree(inflated);
 }
 
 /* Initialize coredump subsystem */
 int mgpu_coredump_init(struct mgpu_device *mdev)
 {
     /* Register with devcoredump is automatic */
+    INIT_WORK(&mdev->coredump_work, mgpu_coredump_work_fn);
+    
+    /* Landing buffer for copy-engine instruction-memory capture.
+     * Optional: without it every capture takes the MMIO port path */
+    mdev->coredump_scratch = dma_alloc_coherent(mdev->dev,
+                                                MGPU_REG_INSTR_MEM_SIZE,
+                                                &mdev->coredump_scratch_dma,
+                                                GFP_KERNEL);
+    
+    /* Persistent worst-case assembly buffer so a hang never depends on
+     * the allocator.  Also optional: captures fall back to on-demand
+     * allocation without it */
+    mdev->coredump_buf_size = sizeof(struct mgpu_coredump_header) +
+        MGPU_DUMP_END * sizeof(struct mgpu_coredump_section_header) +
+        MGPU_DUMP_MAX_REGS * sizeof(struct mgpu_reg_pair) +
+        sizeof(struct mgpu_cmdring_dump) + 4096 +
+        sizeof(struct mgpu_shader_dump) +
+        16 * (sizeof(struct mgpu_instrmem_slot_dump) +
+              MGPU_INSTR_SLOT_DWORDS * 4) +
+        sizeof(struct mgpu_error_dump);
+    mdev->coredump_buf = vmalloc(mdev->coredump_buf_size);
+    if (!mdev->coredump_buf)
+        mdev->coredump_buf_size = 0;
+    atomic_set(&mdev->coredump_buf_busy, 0);
+    
     dev_dbg(mdev->dev, "Coredump support initialized\n");
     return 0;
 }
@@ -524,7 +1203,24 @@ int mgpu_coredump_init(struct mgpu_device *mdev)
 /* Cleanup coredump subsystem */
 void mgpu_coredump_fini(struct mgpu_device *mdev)
 {
-    /* Nothing to clean up */
+    cancel_work_sync(&mdev->coredump_work);
+    
+    /* devcoredump may still be exposing the persistent buffer; leak it
+     * rather than free memory userspace is reading */
+    if (mdev->coredump_buf && atomic_read(&mdev->coredump_buf_busy) == 0) {
+        vfree(mdev->coredump_buf);
+        mdev->coredump_buf = NULL;
+    } else if (mdev->coredump_buf) {
+        dev_warn(mdev->dev,
+                 "coredump buffer still in use, leaking it\n");
+    }
+    
+    if (mdev->coredump_scratch) {
+        dma_free_coherent(mdev->dev, MGPU_REG_INSTR_MEM_SIZE,
+                          mdev->coredump_scratch,
+                          mdev->coredump_scratch_dma);
+        mdev->coredump_scratch = NULL;
+    }
 }
 
 MODULE_DESCRIPTION("MGPU Coredump Support");
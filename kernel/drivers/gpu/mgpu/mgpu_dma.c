@@ -1,212 +1,335 @@
-diff --git a/kernel/drivers/gpu/mgpu/mgpu_dma.c b/kernel/drivers/gpu/mgpu/mgpu_dma.c
-index 2ef3c7cd75f187c16ecd2a03cec1b94df8baccea..c706f96e9b9c584c71bf7e6be7815dcb88b95c0a 100644
---- a/kernel/drivers/gpu/mgpu/mgpu_dma.c
-+++ b/kernel/drivers/gpu/mgpu/mgpu_dma.c
-@@ -1,6 +1,203 @@
--/* mgpu_dma.c - GEN1 skeleton */
-+/* mgpu_dma.c - DMA helper implementation */
- #include <linux/module.h>
--#include <linux/kernel.h>
--#include "mgpu_mmio.h"
-+#include <linux/slab.h>
-+#include <linux/dma-mapping.h>
-+#include <linux/delay.h>
- 
--/* TODO: implement mgpu_dma */
-+#include "mgpu_drm.h"
-+#include "mgpu_regs.h"
-+#include "mgpu_internal.h"
-+
-+/* Local copy of the command ring structure (see mgpu_cmdq.c) */
-+struct mgpu_ring {
-+    struct mgpu_device *mdev;
-+
-+    void *vaddr;
-+    dma_addr_t dma_addr;
-+    size_t size;
-+
-+    u32 head;          /* GPU read pointer */
-+    u32 tail;          /* CPU write pointer */
-+
-+    u32 queue_id;
-+
-+    u64 submitted_cmds;
-+    u64 completed_cmds;
-+};
-+
-+/* ------- Ring helpers (duplicated from mgpu_cmdq.c) ------- */
-+
-+/* Get available space in ring in dwords */
-+static u32 mgpu_ring_space(struct mgpu_ring *ring)
-+{
-+    u32 head, tail, space;
-+
-+    head = mgpu_read(ring->mdev, MGPU_REG_CMD_HEAD + (ring->queue_id * 0x10));
-+    tail = ring->tail;
-+
-+    if (head <= tail)
-+        space = ring->size - (tail - head) - 1;
-+    else
-+        space = head - tail - 1;
-+
-+    return space;
-+}
-+
-+/* Wait for space in ring */
-+static int mgpu_ring_wait_space(struct mgpu_ring *ring, u32 needed)
-+{
-+    int timeout = 1000; /* ms */
-+
-+    while (mgpu_ring_space(ring) < needed) {
-+        if (timeout-- <= 0) {
-+            dev_err(ring->mdev->dev,
-+                    "Ring %u timeout waiting for space\n",
-+                    ring->queue_id);
-+            return -ETIMEDOUT;
-+        }
-+        msleep(1);
-+    }
-+
-+    return 0;
-+}
-+
-+/* Write data to ring */
-+static void mgpu_ring_write(struct mgpu_ring *ring, const u32 *data,
-+                            u32 dwords)
-+{
-+    u32 *ring_ptr = ring->vaddr;
-+    u32 tail = ring->tail;
-+    u32 ring_size_dw = ring->size / 4;
-+    u32 i;
-+
-+    for (i = 0; i < dwords; i++) {
-+        ring_ptr[tail] = data[i];
-+        tail = (tail + 1) & (ring_size_dw - 1);
-+    }
-+
-+    /* Ensure data visible before updating tail */
-+    wmb();
-+
-+    ring->tail = tail;
-+}
-+
-+/* Kick ring (doorbell) */
-+static void mgpu_ring_kick(struct mgpu_ring *ring)
-+{
-+    struct mgpu_device *mdev = ring->mdev;
-+
-+    mgpu_write(mdev, MGPU_REG_CMD_TAIL + (ring->queue_id * 0x10), ring->tail);
-+    mgpu_write(mdev, MGPU_REG_DOORBELL(ring->queue_id), 1);
-+    ring->submitted_cmds++;
-+}
-+
-+/* ----------------- DMA subsystem ----------------- */
-+
-+int mgpu_dma_init(struct mgpu_device *mdev)
-+{
-+    int ret;
-+
-+    /* Prefer 64-bit DMA, fall back to 32-bit */
-+    ret = dma_set_mask_and_coherent(mdev->dev, DMA_BIT_MASK(64));
-+    if (ret) {
-+        ret = dma_set_mask_and_coherent(mdev->dev, DMA_BIT_MASK(32));
-+        if (ret) {
-+            dev_err(mdev->dev, "No suitable DMA configuration\n");
-+            return ret;
-+        }
-+        dev_info(mdev->dev, "Using 32-bit DMA addressing\n");
-+    } else {
-+        dev_info(mdev->dev, "Using 64-bit DMA addressing\n");
-+    }
-+
-+    return 0;
-+}
-+EXPORT_SYMBOL_GPL(mgpu_dma_init);
-+
-+void mgpu_dma_fini(struct mgpu_device *mdev)
-+{
-+    /* Nothing to do for now */
-+}
-+EXPORT_SYMBOL_GPL(mgpu_dma_fini);
-+
-+void *mgpu_dma_alloc(struct mgpu_device *mdev, size_t size,
-+                     dma_addr_t *dma_addr, gfp_t gfp, unsigned long attrs)
-+{
-+    void *vaddr;
-+
-+    vaddr = dma_alloc_attrs(mdev->dev, size, dma_addr, gfp, attrs);
-+    if (!vaddr)
-+        dev_err(mdev->dev, "Failed to allocate %zu bytes of DMA memory\n",
-+                size);
-+
-+    return vaddr;
-+}
-+EXPORT_SYMBOL_GPL(mgpu_dma_alloc);
-+
-+void mgpu_dma_free(struct mgpu_device *mdev, size_t size,
-+                   void *vaddr, dma_addr_t dma_addr, unsigned long attrs)
-+{
-+    if (vaddr)
-+        dma_free_attrs(mdev->dev, size, vaddr, dma_addr, attrs);
-+}
-+EXPORT_SYMBOL_GPL(mgpu_dma_free);
-+
-+void mgpu_dma_sync_for_cpu(struct mgpu_device *mdev, dma_addr_t dma_addr,
-+                           size_t size, enum dma_data_direction dir)
-+{
-+    dma_sync_single_for_cpu(mdev->dev, dma_addr, size, dir);
-+}
-+EXPORT_SYMBOL_GPL(mgpu_dma_sync_for_cpu);
-+
-+void mgpu_dma_sync_for_device(struct mgpu_device *mdev, dma_addr_t dma_addr,
-+                              size_t size, enum dma_data_direction dir)
-+{
-+    dma_sync_single_for_device(mdev->dev, dma_addr, size, dir);
-+}
-+EXPORT_SYMBOL_GPL(mgpu_dma_sync_for_device);
-+
-+/* Submit a DMA copy command to the GPU. If wait is true, wait for completion. */
-+int mgpu_dma_copy(struct mgpu_device *mdev, dma_addr_t src, dma_addr_t dst,
-+                  u32 size, bool wait)
-+{
-+    struct mgpu_ring *ring = mdev->cmd_ring;
-+    struct mgpu_cmd_dma cmd = {
-+        .header = {
-+            .opcode = MGPU_CMD_DMA,
-+            .size = sizeof(struct mgpu_cmd_dma) / 4,
-+            .flags = 0,
-+        },
-+        .src_addr = lower_32_bits(src),
-+        .dst_addr = lower_32_bits(dst),
-+        .size = size,
-+        .flags = 0,
-+    };
-+    unsigned long flags;
-+    int ret;
-+
-+    if (!ring)
-+        return -ENODEV;
-+
-+    spin_lock_irqsave(&mdev->cmd_lock, flags);
-+
-+    ret = mgpu_ring_wait_space(ring, sizeof(cmd) / 4);
-+    if (!ret) {
-+        mgpu_ring_write(ring, (u32 *)&cmd, sizeof(cmd) / 4);
-+        mgpu_ring_kick(ring);
-+    }
-+
-+    spin_unlock_irqrestore(&mdev->cmd_lock, flags);
-+
-+    if (ret)
-+        return ret;
-+
-+    if (wait)
-+        ret = mgpu_core_wait_idle(mdev, 1000); /* wait up to 1s */
-+
-+    return ret;
-+}
-+EXPORT_SYMBOL_GPL(mgpu_dma_copy);
-+
-+MODULE_DESCRIPTION("mGPU DMA helpers");
-+MODULE_AUTHOR("Rafeed Khan");
-+MODULE_LICENSE("GPL");
+/* mgpu_dma.c - DMA helper implementation */
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/dma-mapping.h>
+
+#include "mgpu_drm.h"
+#include "mgpu_regs.h"
+#include "mgpu_internal.h"
+
+/* ----------------- DMA subsystem ----------------- */
+
+int mgpu_dma_init(struct mgpu_device *mdev)
+{
+    int ret;
+
+    /* Prefer 64-bit DMA, fall back to 32-bit */
+    ret = dma_set_mask_and_coherent(mdev->dev, DMA_BIT_MASK(64));
+    if (ret) {
+        ret = dma_set_mask_and_coherent(mdev->dev, DMA_BIT_MASK(32));
+        if (ret) {
+            dev_err(mdev->dev, "No suitable DMA configuration\n");
+            return ret;
+        }
+        dev_info(mdev->dev, "Using 32-bit DMA addressing\n");
+    } else {
+        mdev->dma64 = true;
+        dev_info(mdev->dev, "Using 64-bit DMA addressing\n");
+    }
+
+    return 0;
+}
+EXPORT_SYMBOL_GPL(mgpu_dma_init);
+
+void mgpu_dma_fini(struct mgpu_device *mdev)
+{
+    /* Nothing to do for now */
+}
+EXPORT_SYMBOL_GPL(mgpu_dma_fini);
+
+void *mgpu_dma_alloc(struct mgpu_device *mdev, size_t size,
+                     dma_addr_t *dma_addr, gfp_t gfp, unsigned long attrs)
+{
+    void *vaddr;
+
+    vaddr = dma_alloc_attrs(mdev->dev, size, dma_addr, gfp, attrs);
+    if (!vaddr)
+        dev_err(mdev->dev, "Failed to allocate %zu bytes of DMA memory\n",
+                size);
+
+    return vaddr;
+}
+EXPORT_SYMBOL_GPL(mgpu_dma_alloc);
+
+void mgpu_dma_free(struct mgpu_device *mdev, size_t size,
+                   void *vaddr, dma_addr_t dma_addr, unsigned long attrs)
+{
+    if (vaddr)
+        dma_free_attrs(mdev->dev, size, vaddr, dma_addr, attrs);
+}
+EXPORT_SYMBOL_GPL(mgpu_dma_free);
+
+/* Write-combining variant for producer-only buffers (command rings,
+ * push buffers, upload staging): the CPU only ever writes them and the
+ * GPU only reads, so a WC mapping lets adjacent stores merge into
+ * burst transactions and spares the interconnect the coherency snoops
+ * a cacheable mapping would cost on every line.  Consumers must
+ * publish with a store fence (wmb) before ringing the doorbell; WC
+ * buffers self-flush on the fence.  On architectures without WC
+ * mappings the DMA API quietly degrades this to a coherent
+ * allocation, so no capability check is needed here */
+void *mgpu_dma_alloc_wc(struct mgpu_device *mdev, size_t size,
+                        dma_addr_t *dma_addr, gfp_t gfp)
+{
+    void *vaddr;
+
+    vaddr = dma_alloc_wc(mdev->dev, size, dma_addr, gfp);
+    if (!vaddr)
+        dev_err(mdev->dev,
+                "Failed to allocate %zu bytes of WC DMA memory\n", size);
+
+    return vaddr;
+}
+EXPORT_SYMBOL_GPL(mgpu_dma_alloc_wc);
+
+void mgpu_dma_free_wc(struct mgpu_device *mdev, size_t size,
+                      void *vaddr, dma_addr_t dma_addr)
+{
+    if (vaddr)
+        dma_free_wc(mdev->dev, size, vaddr, dma_addr);
+}
+EXPORT_SYMBOL_GPL(mgpu_dma_free_wc);
+
+void mgpu_dma_sync_for_cpu(struct mgpu_device *mdev, dma_addr_t dma_addr,
+                           size_t size, enum dma_data_direction dir)
+{
+    dma_sync_single_for_cpu(mdev->dev, dma_addr, size, dir);
+}
+EXPORT_SYMBOL_GPL(mgpu_dma_sync_for_cpu);
+
+void mgpu_dma_sync_for_device(struct mgpu_device *mdev, dma_addr_t dma_addr,
+                              size_t size, enum dma_data_direction dir)
+{
+    dma_sync_single_for_device(mdev->dev, dma_addr, size, dir);
+}
+EXPORT_SYMBOL_GPL(mgpu_dma_sync_for_device);
+
+/* Map a peer device's BAR (or other MMIO-backed region) so the copy
+ * engine can move data directly between devices instead of bouncing
+ * through host DRAM.  dma_map_resource() handles the IOMMU case; on a
+ * direct-mapped system it degrades to the bus address.  Returns
+ * DMA_MAPPING_ERROR on failure — the caller falls back to the
+ * CPU-mediated path */
+dma_addr_t mgpu_dma_map_peer(struct mgpu_device *mdev, phys_addr_t phys,
+                             size_t size, enum dma_data_direction dir)
+{
+    dma_addr_t addr;
+
+    addr = dma_map_resource(mdev->dev, phys, size, dir, 0);
+    if (dma_mapping_error(mdev->dev, addr))
+        dev_warn(mdev->dev,
+                 "Failed to map peer resource %pap (%zu bytes)\n",
+                 &phys, size);
+
+    return addr;
+}
+EXPORT_SYMBOL_GPL(mgpu_dma_map_peer);
+
+void mgpu_dma_unmap_peer(struct mgpu_device *mdev, dma_addr_t addr,
+                         size_t size, enum dma_data_direction dir)
+{
+    dma_unmap_resource(mdev->dev, addr, size, dir, 0);
+}
+EXPORT_SYMBOL_GPL(mgpu_dma_unmap_peer);
+
+/* Multi-page sync: when the mapping is described by an sg_table, let
+ * the DMA layer batch the arch-level cache maintenance across the
+ * whole list instead of paying the API fast-path entry once per page.
+ * Callers with a plain single mapping fall back to the range sync.
+ * The single-address wrappers above remain for small control buffers */
+void mgpu_dma_sync_sgt_for_cpu(struct mgpu_device *mdev,
+                               struct sg_table *sgt, dma_addr_t dma_addr,
+                               size_t size, enum dma_data_direction dir)
+{
+    if (sgt)
+        dma_sync_sgtable_for_cpu(mdev->dev, sgt, dir);
+    else
+        dma_sync_single_for_cpu(mdev->dev, dma_addr, size, dir);
+}
+EXPORT_SYMBOL_GPL(mgpu_dma_sync_sgt_for_cpu);
+
+void mgpu_dma_sync_sgt_for_device(struct mgpu_device *mdev,
+                                  struct sg_table *sgt, dma_addr_t dma_addr,
+                                  size_t size, enum dma_data_direction dir)
+{
+    if (sgt)
+        dma_sync_sgtable_for_device(mdev->dev, sgt, dir);
+    else
+        dma_sync_single_for_device(mdev->dev, dma_addr, size, dir);
+}
+EXPORT_SYMBOL_GPL(mgpu_dma_sync_sgt_for_device);
+
+/* Build a DMA command for the device's negotiated addressing; returns
+ * the dword count to submit.  With 64-bit DMA negotiated and
+ * MGPU_CAP_DMA64 firmware, the full 7-dword layout carries the upper
+ * address halves; otherwise the legacy 5-dword prefix is emitted, which
+ * older firmware parses unchanged */
+u32 mgpu_dma_fill_cmd(struct mgpu_device *mdev, struct mgpu_cmd_dma *cmd,
+                      dma_addr_t src, dma_addr_t dst, u32 size)
+{
+    u32 dwords = sizeof(struct mgpu_cmd_dma) / 4;
+
+    if (!mdev->dma64 || !(mdev->caps & MGPU_CAP_DMA64)) {
+        dwords = 5;
+        if (upper_32_bits(src) || upper_32_bits(dst))
+            dev_warn_once(mdev->dev,
+                          "Truncating >32-bit DMA address on 32-bit device\n");
+    }
+
+    *cmd = (struct mgpu_cmd_dma) {
+        .header = {
+            .opcode = MGPU_CMD_DMA,
+            .size = dwords,
+            .flags = 0,
+        },
+        .src_addr = lower_32_bits(src),
+        .dst_addr = lower_32_bits(dst),
+        .size = size,
+        .flags = 0,
+        .src_addr_hi = upper_32_bits(src),
+        .dst_addr_hi = upper_32_bits(dst),
+    };
+
+    return dwords;
+}
+
+/* Queue a DMA copy without ringing the doorbell.  Callers issuing a
+ * run of copies queue each one here and publish the whole batch with a
+ * single mgpu_dma_flush(), paying one tail/doorbell MMIO pair instead
+ * of one per copy */
+int mgpu_dma_copy_queue(struct mgpu_device *mdev, dma_addr_t src,
+                        dma_addr_t dst, u32 size)
+{
+    struct mgpu_ring *ring = mdev->rings[0];
+    struct mgpu_cmd_dma cmd;
+    u32 dwords;
+
+    if (!ring)
+        return -ENODEV;
+
+    dwords = mgpu_dma_fill_cmd(mdev, &cmd, src, dst, size);
+
+    return mgpu_ring_submit_internal_nokick(ring, (const u32 *)&cmd,
+                                            dwords);
+}
+EXPORT_SYMBOL_GPL(mgpu_dma_copy_queue);
+
+/* Ring the doorbell for everything queued on the DMA ring.  Harmless
+ * (no MMIO at all) if nothing is pending */
+int mgpu_dma_flush(struct mgpu_device *mdev)
+{
+    struct mgpu_ring *ring = mdev->rings[0];
+
+    if (!ring)
+        return -ENODEV;
+
+    mgpu_ring_flush(ring);
+
+    return 0;
+}
+EXPORT_SYMBOL_GPL(mgpu_dma_flush);
+
+/* Submit a batch of copies.  On MGPU_CAP_DMA_SG hardware the batch is
+ * packed into scatter-gather commands the copy engine chains
+ * internally — one command header and one doorbell for up to 16
+ * copies.  Older parts fall back to per-copy commands, still sharing a
+ * single doorbell via the deferred-kick path */
+int mgpu_dma_copy_sg(struct mgpu_device *mdev,
+                     const struct mgpu_dma_sg_entry *entries, u32 n,
+                     bool wait)
+{
+    struct mgpu_ring *ring = mdev->rings[0];
+    int ret = 0;
+    u32 i;
+
+    if (!ring)
+        return -ENODEV;
+
+    if (!n)
+        return 0;
+
+    if (mdev->caps & MGPU_CAP_DMA_SG) {
+        u32 buf[2 + MGPU_DMA_SG_MAX_ENTRIES * 3];
+        struct mgpu_cmd_dma_sg *cmd = (struct mgpu_cmd_dma_sg *)buf;
+
+        while (n) {
+            u32 chunk = min_t(u32, n, MGPU_DMA_SG_MAX_ENTRIES);
+            u32 dwords = 2 + chunk * 3;
+
+            cmd->header.opcode = MGPU_CMD_DMA_SG;
+            cmd->header.size = dwords;
+            cmd->header.flags = 0;
+            cmd->count = chunk;
+
+            for (i = 0; i < chunk; i++) {
+                cmd->entries[i].src_addr = lower_32_bits(entries[i].src);
+                cmd->entries[i].dst_addr = lower_32_bits(entries[i].dst);
+                cmd->entries[i].size = entries[i].size;
+            }
+
+            ret = mgpu_ring_submit_internal_nokick(ring, buf, dwords);
+            if (ret)
+                return ret;
+
+            entries += chunk;
+            n -= chunk;
+        }
+    } else {
+        for (i = 0; i < n; i++) {
+            ret = mgpu_dma_copy_queue(mdev, entries[i].src,
+                                      entries[i].dst, entries[i].size);
+            if (ret)
+                return ret;
+        }
+    }
+
+    mgpu_ring_flush(ring);
+
+    if (wait)
+        ret = mgpu_core_wait_idle(mdev, 1000); /* wait up to 1s */
+
+    return ret;
+}
+EXPORT_SYMBOL_GPL(mgpu_dma_copy_sg);
+
+/* Submit a DMA copy command to the GPU. If wait is true, wait for completion.
+ * MGPU_DMA_NO_KICK in flags defers the doorbell to a later mgpu_dma_flush() */
+int mgpu_dma_copy(struct mgpu_device *mdev, dma_addr_t src, dma_addr_t dst,
+                  u32 size, u32 flags, bool wait)
+{
+    struct mgpu_ring *ring = mdev->rings[0];
+    struct mgpu_cmd_dma cmd;
+    u32 dwords;
+    int ret;
+
+    if (!ring)
+        return -ENODEV;
+
+    /* Peer addresses must reach the device unmodified: truncating a
+     * high BAR address would silently DMA somewhere else entirely */
+    if ((flags & MGPU_DMA_P2P) &&
+        (upper_32_bits(src) || upper_32_bits(dst)) &&
+        (!mdev->dma64 || !(mdev->caps & MGPU_CAP_DMA64)))
+        return -ERANGE;
+
+    dwords = mgpu_dma_fill_cmd(mdev, &cmd, src, dst, size);
+
+    if (flags & MGPU_DMA_NO_KICK)
+        ret = mgpu_ring_submit_internal_nokick(ring, (const u32 *)&cmd,
+                                               dwords);
+    else
+        ret = mgpu_ring_submit_internal(ring, (const u32 *)&cmd,
+                                        dwords);
+    if (ret)
+        return ret;
+
+    if (wait)
+        ret = mgpu_core_wait_idle(mdev, 1000); /* wait up to 1s */
+
+    return ret;
+}
+EXPORT_SYMBOL_GPL(mgpu_dma_copy);
+
+MODULE_DESCRIPTION("mGPU DMA helpers");
+MODULE_AUTHOR("Rafeed Khan");
+MODULE_LICENSE("GPL");
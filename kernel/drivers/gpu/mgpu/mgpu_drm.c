@@ -35,10 +35,13 @@
 #define DRIVER_MAJOR   1
 #define DRIVER_MINOR   0
 
-/* Fixed framebuffer size from hardware (framebuffer.sv) */
-#define MGPU_FB_WIDTH  640
-#define MGPU_FB_HEIGHT 480
-#define MGPU_FB_BPP    32
+/* Supported pixel formats */
+static const uint32_t mgpu_formats[] = {
+    DRM_FORMAT_XRGB8888,
+    DRM_FORMAT_ARGB8888,
+    DRM_FORMAT_RGB888,
+    DRM_FORMAT_RGB565,
+};
 
 /* DRM device structure */
 struct mgpu_drm_device {
@@ -51,8 +54,10 @@ struct mgpu_drm_device {
     struct drm_panel *panel;
     struct drm_bridge *bridge;
     
-    /* Framebuffer */
-    void __iomem *fb_base;
+    /* Framebuffer.  Write-combining mapping: CPU stores are buffered
+     * into full-burst writes instead of uncached single beats, so the
+     * dirty-rect copy runs at memory speed */
+    void *fb_base;
     dma_addr_t fb_dma_addr;
     size_t fb_size;
     
@@ -69,10 +74,18 @@ struct mgpu_drm_device {
         u32 vertex_stride;
         u32 shader_pc;
     } render_state;
+    
+    /* Round-robin cursor for assigning clients to hardware queues */
+    atomic_t next_queue;
 };
 
 #define drm_to_mgpu(x) container_of(x, struct mgpu_drm_device, drm)
 
+/* Per-open-file state */
+struct mgpu_file_priv {
+    u32 queue_id;   /* Hardware queue this client submits to */
+};
+
 /* Get device from DRM file */
 static struct mgpu_device *mgpu_get_device(struct drm_file *file)
 {
@@ -86,17 +99,36 @@ static void mgpu_fb_dirty(struct drm_framebuffer *fb, struct drm_rect *rect)
 {
     struct drm_gem_cma_object *cma_obj = drm_fb_cma_get_gem_obj(fb, 0);
     struct mgpu_drm_device *mgpu = drm_to_mgpu(fb->dev);
-    struct mgpu_device *mdev = mgpu->mdev;
     void *src = cma_obj->vaddr;
     u32 cpp = fb->format->cpp[0];
+    u32 hw_pitch = MGPU_FB_WIDTH * cpp;
     size_t len = drm_rect_width(rect) * cpp;
+    const void *line_src;
     unsigned int y;
+    void *dst;
+    
+    /* Full-width damage with matching pitches is one contiguous span:
+     * copy it in a single pass so memcpy runs its widest store loop
+     * and the WC buffers fill back to back, instead of restarting a
+     * short line copy 480 times */
+    if (len == hw_pitch && fb->pitches[0] == hw_pitch) {
+        memcpy(mgpu->fb_base + rect->y1 * hw_pitch,
+               src + rect->y1 * hw_pitch,
+               (size_t)drm_rect_height(rect) * hw_pitch);
+        return;
+    }
+    
+    /* Partial-width damage: hoist the base addresses and bump by the
+     * pitches, so each iteration is just the copy and two adds rather
+     * than two multiplies re-derived from fb fields the compiler
+     * cannot prove invariant across the copy */
+    dst = mgpu->fb_base + rect->y1 * hw_pitch + rect->x1 * cpp;
+    line_src = src + rect->y1 * fb->pitches[0] + rect->x1 * cpp;
     
-    /* Copy damaged region to hardware framebuffer */
     for (y = rect->y1; y < rect->y2; y++) {
-        void *dst = mgpu->fb_base + (y * MGPU_FB_WIDTH + rect->x1) * cpp;
-        void *line_src = src + (y * fb->pitches[0] + rect->x1 * cpp);
-        memcpy_toio(dst, line_src, len);
+        memcpy(dst, line_src, len);
+        dst += hw_pitch;
+        line_src += fb->pitches[0];
     }
 }
 
@@ -113,6 +145,12 @@ static void mgpu_pipe_enable(struct drm_simple_display_pipe *pipe,
     if (!fb)
         return;
     
+    /* Atomic modeset can run enable during a flip with the pipe
+     * already up; rewriting CONTROL would restart the hardware state
+     * machine for nothing */
+    if (mgpu->crtc_enabled)
+        return;
+    
     dev_info(mdev->dev, "Enabling display pipe\n");
     
     /* Configure framebuffer base in hardware */
@@ -130,6 +168,9 @@ static void mgpu_pipe_disable(struct drm_simple_display_pipe *pipe)
     struct mgpu_drm_device *mgpu = drm_to_mgpu(pipe->crtc.dev);
     struct mgpu_device *mdev = mgpu->mdev;
     
+    if (!mgpu->crtc_enabled)
+        return;
+    
     dev_info(mdev->dev, "Disabling display pipe\n");
     
     /* Stop GPU rendering */
@@ -211,13 +252,171 @@ static const struct drm_connector_funcs mgpu_connector_funcs = {
 
 /* --- GEM/Command Submission IOCTLs --- */
 
+/* Sizes of the packets the draw paths emit, in dwords */
+#define MGPU_REG_WRITE_DWORDS  3
+#define MGPU_DRAW_DWORDS       (sizeof(struct mgpu_cmd_draw) / 4)
+#define MGPU_FENCE_DWORDS      (sizeof(struct mgpu_cmd_fence) / 4)
+/* Three vertex-state register writes plus the draw itself */
+#define MGPU_DRAW_PACKET_DWORDS (3 * MGPU_REG_WRITE_DWORDS + MGPU_DRAW_DWORDS)
+
+/* Emit a REG_WRITE packet: the register is programmed by the command
+ * processor in stream order instead of an MMIO store from the CPU, so
+ * it pipelines behind the preceding draw and costs only a ring write */
+static u32 *mgpu_emit_reg_write(u32 *p, u32 offset, u32 value)
+{
+    struct mgpu_cmd_header *hdr = (struct mgpu_cmd_header *)p;
+    
+    hdr->opcode = MGPU_CMD_REG_WRITE;
+    hdr->size = MGPU_REG_WRITE_DWORDS;
+    hdr->flags = 0;
+    p[1] = offset;
+    p[2] = value;
+    
+    return p + MGPU_REG_WRITE_DWORDS;
+}
+
+/* Emit vertex state and a draw for one batch element */
+static u32 *mgpu_emit_draw(u32 *p, dma_addr_t vertex_dma, u32 vertex_count,
+                           u32 vertex_stride)
+{
+    struct mgpu_cmd_draw *draw;
+    
+    p = mgpu_emit_reg_write(p, MGPU_REG_VERTEX_BASE, vertex_dma);
+    p = mgpu_emit_reg_write(p, MGPU_REG_VERTEX_COUNT, vertex_count);
+    p = mgpu_emit_reg_write(p, MGPU_REG_VERTEX_STRIDE,
+                            vertex_stride ?: 44); /* Default 11 attrs * 4 bytes */
+    
+    draw = (struct mgpu_cmd_draw *)p;
+    draw->header.opcode = MGPU_CMD_DRAW;
+    draw->header.size = MGPU_DRAW_DWORDS;
+    draw->header.flags = 0;
+    draw->vertex_count = vertex_count;
+    draw->instance_count = 1;
+    draw->first_vertex = 0;
+    draw->first_instance = 0;
+    
+    return p + MGPU_DRAW_DWORDS;
+}
+
+static u32 *mgpu_emit_fence(u32 *p, dma_addr_t addr, u32 value)
+{
+    struct mgpu_cmd_fence *fence = (struct mgpu_cmd_fence *)p;
+    
+    fence->header.opcode = MGPU_CMD_FENCE;
+    fence->header.size = MGPU_FENCE_DWORDS;
+    fence->header.flags = 0;
+    fence->addr = addr;
+    fence->value = value;
+    
+    return p + MGPU_FENCE_DWORDS;
+}
+
+/* Ring for this client: each hardware queue has its own ring and
+ * ring lock, so clients spread across queues submit in parallel
+ * instead of serializing on queue 0 */
+static struct mgpu_ring *mgpu_file_ring(struct mgpu_device *mdev,
+                                        struct drm_file *file)
+{
+    struct mgpu_file_priv *priv = file->driver_priv;
+    
+    if (priv && mdev->rings[priv->queue_id])
+        return mdev->rings[priv->queue_id];
+    
+    return mdev->rings[0];
+}
+
+/* Batched 3D submission: N draws become one command-buffer build, one
+ * ring reservation and one doorbell.  Per-draw cost collapses to the
+ * handle query and 14 dwords of ring traffic */
+static int mgpu_ioctl_submit_3d_batch(struct drm_device *dev, void *data,
+                                      struct drm_file *file)
+{
+    struct mgpu_device *mdev = mgpu_get_device(file);
+    struct drm_mgpu_submit_3d_batch *args = data;
+    struct drm_mgpu_draw_3d *draws;
+    u32 *cmds, *p;
+    size_t max_dwords;
+    u32 i;
+    int ret;
+    
+    if (!args->count || args->count > MGPU_MAX_BATCH_DRAWS || args->flags)
+        return -EINVAL;
+    
+    draws = kmalloc_array(args->count, sizeof(*draws), GFP_KERNEL);
+    if (!draws)
+        return -ENOMEM;
+    
+    if (copy_from_user(draws, u64_to_user_ptr(args->draws),
+                       args->count * sizeof(*draws))) {
+        ret = -EFAULT;
+        goto out_draws;
+    }
+    
+    max_dwords = (size_t)args->count * MGPU_DRAW_PACKET_DWORDS +
+                 MGPU_FENCE_DWORDS;
+    cmds = kmalloc_array(max_dwords, sizeof(u32), GFP_KERNEL);
+    if (!cmds) {
+        ret = -ENOMEM;
+        goto out_draws;
+    }
+    
+    p = cmds;
+    for (i = 0; i < args->count; i++) {
+        const struct drm_mgpu_draw_3d *draw = &draws[i];
+        dma_addr_t vertex_dma;
+        
+        if (!draw->vertex_bo || !draw->vertex_count || draw->flags) {
+            ret = -EINVAL;
+            goto out_cmds;
+        }
+        
+        if (mgpu_bo_query(mdev, draw->vertex_bo, &vertex_dma, NULL, NULL)) {
+            ret = -EINVAL;
+            goto out_cmds;
+        }
+        
+        /* Shader binds stay CPU-side: the slot-to-PC translation
+         * lives in the shader manager, not the command processor */
+        if (draw->vertex_shader_slot < 16)
+            mgpu_shader_bind(mdev, draw->vertex_shader_slot,
+                             MGPU_SHADER_VERTEX);
+        if (draw->fragment_shader_slot < 16)
+            mgpu_shader_bind(mdev, draw->fragment_shader_slot,
+                             MGPU_SHADER_FRAGMENT);
+        
+        p = mgpu_emit_draw(p, vertex_dma, draw->vertex_count,
+                           draw->vertex_stride);
+    }
+    
+    if (args->fence_bo) {
+        dma_addr_t fence_dma;
+        
+        if (mgpu_bo_query(mdev, args->fence_bo, &fence_dma, NULL, NULL)) {
+            ret = -EINVAL;
+            goto out_cmds;
+        }
+        p = mgpu_emit_fence(p, fence_dma + args->fence_offset,
+                            args->fence_value);
+    }
+    
+    /* One reservation, one write, one doorbell for the whole batch */
+    ret = mgpu_ring_submit_internal(mgpu_file_ring(mdev, file),
+                                    cmds, p - cmds);
+    
+out_cmds:
+    kfree(cmds);
+out_draws:
+    kfree(draws);
+    return ret;
+}
+
 static int mgpu_ioctl_submit_3d(struct drm_device *dev, void *data,
                                 struct drm_file *file)
 {
     struct mgpu_device *mdev = mgpu_get_device(file);
     struct drm_mgpu_submit_3d *args = data;
-    struct mgpu_submit submit = {0};
-    int ret;
+    u32 cmds[MGPU_DRAW_PACKET_DWORDS + MGPU_FENCE_DWORDS];
+    u32 *p = cmds;
     
     /* Validate arguments */
     if (!args->vertex_bo || !args->vertex_count) {
@@ -232,11 +431,6 @@ static int mgpu_ioctl_submit_3d(struct drm_device *dev, void *data,
         return -EINVAL;
     }
     
-    /* Program vertex state registers */
-    mgpu_write(mdev, MGPU_REG_VERTEX_BASE, vbo->dma_addr);
-    mgpu_write(mdev, MGPU_REG_VERTEX_COUNT, args->vertex_count);
-    mgpu_write(mdev, MGPU_REG_VERTEX_STRIDE, args->vertex_stride ?: 44); /* Default 11 attrs * 4 bytes */
-    
     /* Bind shaders if specified */
     if (args->vertex_shader_slot < 16) {
         mgpu_shader_bind(mdev, args->vertex_shader_slot, MGPU_SHADER_VERTEX);
@@ -245,39 +439,29 @@ static int mgpu_ioctl_submit_3d(struct drm_device *dev, void *data,
         mgpu_shader_bind(mdev, args->fragment_shader_slot, MGPU_SHADER_FRAGMENT);
     }
     
-    /* Build DRAW command */
-    struct mgpu_cmd_draw draw_cmd = {
-        .header = {
-            .opcode = MGPU_CMD_DRAW,
-            .size = sizeof(draw_cmd) / 4,
-            .flags = 0,
-        },
-        .vertex_count = args->vertex_count,
-        .instance_count = 1,
-        .first_vertex = 0,
-        .first_instance = 0,
-    };
-    
-    /* Submit command through command queue */
-    submit.commands = (uintptr_t)&draw_cmd;
-    submit.cmd_size = sizeof(draw_cmd);
-    submit.queue_id = 0;  /* Use queue 0 for 3D */
-    submit.flags = args->flags;
-    
-    /* Add fence if requested */
+    /* Vertex state goes into the command stream as REG_WRITE packets
+     * rather than CPU MMIO stores: the writes pipeline behind whatever
+     * the GPU is already running and cannot clobber the state of an
+     * in-flight draw from another submitter */
+    p = mgpu_emit_draw(p, vbo->dma_addr, args->vertex_count,
+                       args->vertex_stride);
+    
+    /* Add fence if requested.  Only the GPU address is needed, so a
+     * refcount-free query replaces the lookup/put pair */
     if (args->fence_bo) {
-        struct mgpu_bo *fence_bo = mgpu_bo_lookup(mdev, args->fence_bo);
-        if (!fence_bo) {
+        dma_addr_t fence_dma;
+        
+        if (mgpu_bo_query(mdev, args->fence_bo, &fence_dma, NULL, NULL)) {
             mgpu_bo_put(vbo);
             return -EINVAL;
         }
-        submit.fence_addr = fence_bo->dma_addr + args->fence_offset;
-        submit.fence_value = args->fence_value;
-        submit.flags |= MGPU_SUBMIT_FLAGS_FENCE;
-        mgpu_bo_put(fence_bo);
+        p = mgpu_emit_fence(p, fence_dma + args->fence_offset,
+                            args->fence_value);
     }
     
-    ret = mgpu_submit_commands(mdev, &submit);
+    /* Submit on this client's queue */
+    int ret = mgpu_ring_submit_internal(mgpu_file_ring(mdev, file),
+                                        cmds, p - cmds);
     
     mgpu_bo_put(vbo);
     
@@ -290,24 +474,22 @@ static int mgpu_ioctl_wait_bo(struct drm_device *dev, void *data,
     struct mgpu_device *mdev = mgpu_get_device(file);
     struct drm_mgpu_wait_bo *args = data;
     struct mgpu_wait_fence wait = {0};
-    struct mgpu_bo *bo;
-    int ret;
+    dma_addr_t dma_addr;
+    size_t size;
+    
+    if (mgpu_bo_query(mdev, args->handle, &dma_addr, &size, NULL))
+        return -EINVAL;
     
-    /* Look up buffer object */
-    bo = mgpu_bo_lookup(mdev, args->handle);
-    if (!bo)
+    /* The fence dword must lie inside the BO */
+    if (args->offset > size - sizeof(u32) || (args->offset & 3))
         return -EINVAL;
     
     /* Set up fence wait */
-    wait.fence_addr = bo->dma_addr + args->offset;
+    wait.fence_addr = dma_addr + args->offset;
     wait.fence_value = args->value;
     wait.timeout_ms = args->timeout_ms;
     
-    ret = mgpu_wait_fence(mdev, &wait);
-    
-    mgpu_bo_put(bo);
-    
-    return ret;
+    return mgpu_wait_fence(mdev, &wait);
 }
 
 static int mgpu_ioctl_gem_info(struct drm_device *dev, void *data,
@@ -315,17 +497,16 @@ static int mgpu_ioctl_gem_info(struct drm_device *dev, void *data,
 {
     struct mgpu_device *mdev = mgpu_get_device(file);
     struct drm_mgpu_gem_info *args = data;
-    struct mgpu_bo *bo;
+    dma_addr_t dma_addr;
+    size_t size;
+    u32 flags;
     
-    bo = mgpu_bo_lookup(mdev, args->handle);
-    if (!bo)
+    if (mgpu_bo_query(mdev, args->handle, &dma_addr, &size, &flags))
         return -EINVAL;
     
-    args->size = bo->size;
-    args->gpu_addr = bo->dma_addr;
-    args->flags = bo->flags;
-    
-    mgpu_bo_put(bo);
+    args->size = size;
+    args->gpu_addr = dma_addr;
+    args->flags = flags;
     
     return 0;
 }
@@ -335,6 +516,8 @@ static const struct drm_ioctl_desc mgpu_drm_ioctls[] = {
     DRM_IOCTL_DEF_DRV(MGPU_SUBMIT_3D, mgpu_ioctl_submit_3d, DRM_RENDER_ALLOW),
     DRM_IOCTL_DEF_DRV(MGPU_WAIT_BO, mgpu_ioctl_wait_bo, DRM_RENDER_ALLOW),
     DRM_IOCTL_DEF_DRV(MGPU_GEM_INFO, mgpu_ioctl_gem_info, DRM_RENDER_ALLOW),
+    DRM_IOCTL_DEF_DRV(MGPU_SUBMIT_3D_BATCH, mgpu_ioctl_submit_3d_batch,
+                      DRM_RENDER_ALLOW),
 };
 
 /* --- File Operations --- */
@@ -343,11 +526,19 @@ static int mgpu_drm_open(struct drm_device *dev, struct drm_file *file)
 {
     struct mgpu_drm_device *mgpu = drm_to_mgpu(dev);
     struct mgpu_device *mdev = mgpu->mdev;
+    struct mgpu_file_priv *priv;
     
-    /* Initialize per-file state if needed */
-    file->driver_priv = NULL;  /* Could store per-context data */
+    priv = kzalloc(sizeof(*priv), GFP_KERNEL);
+    if (!priv)
+        return -ENOMEM;
+    
+    /* Spread clients round-robin across the hardware queues so
+     * parallel submitters land on different rings */
+    priv->queue_id = (u32)atomic_fetch_inc(&mgpu->next_queue) %
+                     max_t(u32, mdev->num_queues, 1);
+    file->driver_priv = priv;
     
-    dev_dbg(mdev->dev, "DRM file opened\n");
+    dev_dbg(mdev->dev, "DRM file opened, queue %u\n", priv->queue_id);
     
     return 0;
 }
@@ -357,7 +548,8 @@ static void mgpu_drm_postclose(struct drm_device *dev, struct drm_file *file)
     struct mgpu_drm_device *mgpu = drm_to_mgpu(dev);
     struct mgpu_device *mdev = mgpu->mdev;
     
-    /* Clean up any per-file resources */
+    kfree(file->driver_priv);
+    file->driver_priv = NULL;
     
     dev_dbg(mdev->dev, "DRM file closed\n");
 }
@@ -433,10 +625,12 @@ static int mgpu_drm_bind(struct device *dev, struct device *master, void *data)
     mgpu->mode.clock = 25175;  /* 25.175 MHz pixel clock */
     mgpu->mode.vrefresh = drm_mode_vrefresh(&mgpu->mode);
     
-    /* Allocate framebuffer memory */
+    /* Allocate framebuffer memory.  Write-combining rather than
+     * coherent: the CPU only ever streams pixels out to it, and WC
+     * lets those stores merge into full bursts on the interconnect */
     mgpu->fb_size = MGPU_FB_WIDTH * MGPU_FB_HEIGHT * (MGPU_FB_BPP / 8);
-    mgpu->fb_base = dma_alloc_coherent(dev, mgpu->fb_size,
-                                       &mgpu->fb_dma_addr, GFP_KERNEL);
+    mgpu->fb_base = dma_alloc_wc(dev, mgpu->fb_size,
+                                 &mgpu->fb_dma_addr, GFP_KERNEL);
     if (!mgpu->fb_base) {
         dev_err(dev, "Failed to allocate framebuffer\n");
         return -ENOMEM;
@@ -456,7 +650,11 @@ static int mgpu_drm_bind(struct device *dev, struct device *master, void *data)
     drm->mode_config.min_height = MGPU_FB_HEIGHT;
     drm->mode_config.max_height = MGPU_FB_HEIGHT;
     drm->mode_config.funcs = &drm_atomic_helper_mode_config_funcs;
-    drm->mode_config.prefer_shadow_fbdev = true;
+    /* No shadow buffer for fbdev: the generic emulation can serve
+     * fbdev straight from the GEM BO, and the dirty callback already
+     * handles damage upload.  A shadow would mean every fbcon update
+     * is copied twice (shadow -> BO -> hardware framebuffer) */
+    drm->mode_config.prefer_shadow_fbdev = false;
     
     /* Initialize connector */
     ret = drm_connector_init(drm, &mgpu->connector,
@@ -505,7 +703,7 @@ static int mgpu_drm_bind(struct device *dev, struct device *master, void *data)
 err_mode:
     drm_mode_config_cleanup(drm);
 err_fb:
-    dma_free_coherent(dev, mgpu->fb_size, mgpu->fb_base, mgpu->fb_dma_addr);
+    dma_free_wc(dev, mgpu->fb_size, mgpu->fb_base, mgpu->fb_dma_addr);
     
     return ret;
 }
@@ -524,8 +722,8 @@ static void mgpu_drm_unbind(struct device *dev, struct device *master,
     drm_mode_config_cleanup(drm);
     
     if (mgpu->fb_base)
-        dma_free_coherent(dev, mgpu->fb_size, mgpu->fb_base,
-                         mgpu->fb_dma_addr);
+        dma_free_wc(dev, mgpu->fb_size, mgpu->fb_base,
+                    mgpu->fb_dma_addr);
 }
 
 static const struct component_ops mgpu_drm_ops = {
@@ -545,14 +743,6 @@ void mgpu_drm_fini(struct platform_device *pdev)
     component_del(&pdev->dev, &mgpu_drm_ops);
 }
 
-/* Supported pixel formats */
-static const uint32_t mgpu_formats[] = {
-    DRM_FORMAT_XRGB8888,
-    DRM_FORMAT_ARGB8888,
-    DRM_FORMAT_RGB888,
-    DRM_FORMAT_RGB565,
-};
-
 MODULE_DESCRIPTION("MGPU DRM Interface");
 MODULE_AUTHOR("Rafeed Khan");
 MODULE_LICENSE("GPL v2");
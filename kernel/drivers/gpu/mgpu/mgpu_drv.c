@@ -14,6 +14,7 @@
 #include <linux/uaccess.h>
 #include <linux/debugfs.h>
 #include <linux/delay.h>
+#include <linux/iopoll.h>
 
 #include "mgpu_drm.h"
 #include "mgpu_regs.h"
@@ -56,22 +57,59 @@ struct mgpu_device {
     u32 caps;
     u32 num_engines;
     u32 num_queues;
+    bool dma64;            /* 64-bit DMA mask negotiated */
     
     /* Memory management */
     struct list_head bo_list;
-    struct mutex bo_lock;
-    
-    /* Command submission */
-    struct mgpu_ring *cmd_ring;
-    spinlock_t cmd_lock;
-    
-    /* Interrupt handling */
-    struct tasklet_struct irq_tasklet;
-    u32 irq_status;
-    
+    spinlock_t bo_list_lock;
+    
+    /* Aggregate BO stats, maintained on create/destroy so summary
+     * queries never walk the list */
+    atomic_t bo_count;
+    atomic64_t bo_total_bytes;
+    
+    /* Command submission: one ring per hardware queue */
+    struct mgpu_ring *rings[MGPU_MAX_QUEUES];
+    
+    /* Head write-back page: hardware mirrors each queue's CMD_HEAD
+     * into status_page[queue_id] (MGPU_CAP_HEAD_WRITEBACK), turning
+     * ring-space checks into cached loads */
+    u32 *status_page;
+    dma_addr_t status_page_dma;
+    
+    /* Interrupt handling: bits the hard handler has accumulated but
+     * the IRQ thread has not yet consumed, plus a running count of
+     * serviced batches that the health monitor uses as a free
+     * liveness witness */
+    atomic_t irq_pending;
+    atomic_t irq_count;
+
+    /* Shadow of MGPU_REG_IRQ_ENABLE: re-enables with an unchanged
+     * mask skip the MMIO write.  irq_mask_lock serializes the shadow
+     * and the enabled intent; irqs_enabled gates the IRQ thread's
+     * tail unmask so it cannot undo a concurrent suspend/teardown
+     * disable */
+    spinlock_t irq_mask_lock;
+    u32 last_irq_mask;
+    bool irqs_enabled;
+
+    /* Hang detection: fence value observed by the previous
+     * mgpu_reset_needed() call.  Per-device so health checks on one
+     * GPU cannot mask a hang on another */
+    u32 last_seen_fence;
+
     /* Debug */
     struct dentry *debugfs_root;
     
+    /* Deferred coredump capture (mgpu_coredump.c) */
+    struct work_struct coredump_work;
+    char coredump_reason[64];
+    void *coredump_scratch;        /* Instr-mem DMA landing buffer */
+    dma_addr_t coredump_scratch_dma;
+    void *coredump_buf;            /* Persistent dump assembly buffer */
+    size_t coredump_buf_size;
+    atomic_t coredump_buf_busy;
+    
     /* Character device */
     struct cdev cdev;
     dev_t devno;
@@ -103,23 +141,25 @@ static irqreturn_t mgpu_irq_handler(int irq, void *arg)
     if (!status)
         return IRQ_NONE;
     
-    /* Clear interrupts */
-    mgpu_write(mdev, MGPU_REG_IRQ_ACK, status);
+    /* Clear interrupts; autoclear hardware dropped them on the
+     * STATUS read, halving the MMIO per interrupt */
+    if (!(mdev->caps & MGPU_CAP_IRQ_AUTOCLEAR))
+        mgpu_write(mdev, MGPU_REG_IRQ_ACK, status);
     
-    /* Save status and schedule tasklet */
-    mdev->irq_status = status;
-    tasklet_schedule(&mdev->irq_tasklet);
+    /* Accumulate for the thread.  A plain store here lost bits when a
+     * second interrupt fired before the bottom half ran */
+    atomic_or(status, &mdev->irq_pending);
     
-    return IRQ_HANDLED;
+    return IRQ_WAKE_THREAD;
 }
 
-/* IRQ Tasklet - bottom half */
-static void mgpu_irq_tasklet_func(unsigned long data)
+/* IRQ threaded handler - bottom half */
+static irqreturn_t mgpu_irq_thread(int irq, void *arg)
 {
-    struct mgpu_device *mdev = (struct mgpu_device *)data;
-    u32 status = mdev->irq_status;
+    struct mgpu_device *mdev = arg;
+    u32 status = atomic_xchg(&mdev->irq_pending, 0);
     
-    dev_dbg(mdev->dev, "IRQ tasklet: status=0x%08x\n", status);
+    dev_dbg(mdev->dev, "IRQ thread: status=0x%08x\n", status);
     
     if (status & MGPU_IRQ_CMD_COMPLETE) {
         /* Handle command completion */
@@ -133,19 +173,32 @@ static void mgpu_irq_tasklet_func(unsigned long data)
         dev_err(mdev->dev, "GPU error detected\n");
         /* TODO: Capture error state, trigger reset */
     }
+    
+    return IRQ_HANDLED;
 }
 
 /* Device initialization */
 static int mgpu_hw_init(struct mgpu_device *mdev)
 {
     u32 val;
-    
-    /* Reset the device */
+
+    /* Reset the device: hold the reset bit briefly, then poll for the
+     * core to report idle instead of sleeping a fixed 10ms on each
+     * side.  The FPGA comes out of reset in microseconds, so the old
+     * msleep() pair cost ~20ms of probe time for nothing */
     mgpu_write(mdev, MGPU_REG_CONTROL, MGPU_CTRL_RESET);
-    msleep(10);
+    usleep_range(10, 20);
     mgpu_write(mdev, MGPU_REG_CONTROL, 0);
-    msleep(10);
-    
+
+    ret = readl_poll_timeout(mdev->mmio_base + MGPU_REG_STATUS, val,
+                             val & MGPU_STATUS_IDLE, 10,
+                             10 * USEC_PER_MSEC);
+    if (ret) {
+        dev_err(mdev->dev, "Device did not go idle after reset (status=0x%08x)\n",
+                val);
+        return -ETIMEDOUT;
+    }
+
     /* Read version and capabilities */
     mdev->version = mgpu_read(mdev, MGPU_REG_VERSION);
     mdev->caps = mgpu_read(mdev, MGPU_REG_CAPS);
@@ -185,11 +238,13 @@ static int mgpu_hw_init(struct mgpu_device *mdev)
         return ret;
     }
     
-    /* Enable interrupts */
-    mgpu_write(mdev, MGPU_REG_IRQ_ENABLE, MGPU_IRQ_CMD_COMPLETE | MGPU_IRQ_ERROR);
-    
-    /* Start the device */
-    mgpu_write(mdev, MGPU_REG_CONTROL, MGPU_CTRL_ENABLE);
+    /* Enable interrupts and start the device.  Relaxed writes: the
+     * bus keeps same-device ordering, so one barrier after the group
+     * replaces the per-write DSB that iowrite32 would issue */
+    writel_relaxed(MGPU_IRQ_CMD_COMPLETE | MGPU_IRQ_ERROR,
+                   mdev->mmio_base + MGPU_REG_IRQ_ENABLE);
+    writel_relaxed(MGPU_CTRL_ENABLE, mdev->mmio_base + MGPU_REG_CONTROL);
+    wmb();
     
     return 0;
 }
@@ -197,11 +252,11 @@ static int mgpu_hw_init(struct mgpu_device *mdev)
 /* Device teardown */
 static void mgpu_hw_fini(struct mgpu_device *mdev)
 {
-    /* Disable interrupts */
-    mgpu_write(mdev, MGPU_REG_IRQ_ENABLE, 0);
-    
-    /* Stop the device */
-    mgpu_write(mdev, MGPU_REG_CONTROL, 0);
+    /* Disable interrupts and stop the device; one barrier covers the
+     * pair, as in mgpu_hw_init */
+    writel_relaxed(0, mdev->mmio_base + MGPU_REG_IRQ_ENABLE);
+    writel_relaxed(0, mdev->mmio_base + MGPU_REG_CONTROL);
+    wmb();
     
     /* Clean up subsystems */
     mgpu_shader_fini(mdev);
@@ -216,9 +271,9 @@ static void mgpu_hw_fini(struct mgpu_device *mdev)
 /* Character device operations */
 static int mgpu_open(struct inode *inode, struct file *filp)
 {
-    struct mgpu_device *mdev = container_of(inode->i_cdev, 
-                                           struct mgpu_device, cdev);
-    filp->private_data = mdev;
+    /* Single-instance driver: the global pointer is hot, the inode's
+     * cdev line is not.  Revisit when multi-instance support lands */
+    filp->private_data = mgpu_dev;
     return 0;
 }
 
@@ -227,152 +282,224 @@ static int mgpu_release(struct inode *inode, struct file *filp)
     return 0;
 }
 
+static long mgpu_ioctl_get_info(struct mgpu_device *mdev, struct file *filp,
+                                void __user *uarg)
+{
+    struct mgpu_info info = {
+        .version_major = MGPU_VERSION_MAJOR(mdev->version),
+        .version_minor = MGPU_VERSION_MINOR(mdev->version),
+        .version_patch = MGPU_VERSION_PATCH(mdev->version),
+        .capabilities = mdev->caps,
+        .num_engines = mdev->num_engines,
+        .num_queues = mdev->num_queues,
+        .max_width = 1920,
+        .max_height = 1080,
+        .max_threads = 256,
+        .memory_size = 64 * 1024 * 1024,  /* 64MB */
+        .shader_mem_size = 64 * 1024,     /* 64KB */
+    };
+
+    if (copy_to_user(uarg, &info, sizeof(info)))
+        return -EFAULT;
+
+    return 0;
+}
+
+static long mgpu_ioctl_bo_create(struct mgpu_device *mdev, struct file *filp,
+                                 void __user *arg)
+{
+    struct mgpu_bo_create __user *uarg = arg;
+    struct mgpu_bo_create args;
+    int ret;
+
+    /* Only size and flags are inputs, handle and gpu_addr are
+     * outputs.  Grouping each direction under one
+     * user_access_begin() window costs a single uaccess toggle per
+     * direction, where copy_from_user plus two put_user calls would
+     * pay three */
+    if (!user_access_begin(uarg, sizeof(*uarg)))
+        return -EFAULT;
+    unsafe_get_user(args.size, &uarg->size, efault);
+    unsafe_get_user(args.flags, &uarg->flags, efault);
+    user_access_end();
+
+    ret = mgpu_bo_create(mdev, &args);
+    if (ret)
+        return ret;
+
+    if (!user_access_begin(uarg, sizeof(*uarg)))
+        return -EFAULT;
+    unsafe_put_user(args.handle, &uarg->handle, efault);
+    unsafe_put_user(args.gpu_addr, &uarg->gpu_addr, efault);
+    user_access_end();
+
+    return 0;
+
+efault:
+    user_access_end();
+    return -EFAULT;
+}
+
+static long mgpu_ioctl_bo_destroy(struct mgpu_device *mdev, struct file *filp,
+                                  void __user *uarg)
+{
+    struct mgpu_bo_destroy args;
+
+    /* handle is the only meaningful field */
+    if (get_user(args.handle, &((struct mgpu_bo_destroy __user *)uarg)->handle))
+        return -EFAULT;
+
+    return mgpu_bo_destroy(mdev, &args);
+}
+
+static long mgpu_ioctl_bo_mmap(struct mgpu_device *mdev, struct file *filp,
+                               void __user *arg)
+{
+    struct mgpu_bo_mmap __user *uarg = arg;
+    struct mgpu_bo_mmap args;
+    int ret;
+
+    /* handle is the only input field */
+    if (get_user(args.handle, &uarg->handle))
+        return -EFAULT;
+
+    ret = mgpu_bo_mmap(mdev, &args, filp);
+    if (ret)
+        return ret;
+
+    /* offset is the only output field */
+    if (put_user(args.offset, &uarg->offset))
+        return -EFAULT;
+
+    return 0;
+}
+
+static long mgpu_ioctl_submit(struct mgpu_device *mdev, struct file *filp,
+                              void __user *uarg)
+{
+    struct mgpu_submit args;
+
+    if (copy_from_user(&args, uarg, sizeof(args)))
+        return -EFAULT;
+
+    return mgpu_submit_commands(mdev, &args);
+}
+
+static long mgpu_ioctl_submit_wait(struct mgpu_device *mdev, struct file *filp,
+                                   void __user *uarg)
+{
+    struct mgpu_submit_wait args;
+    struct mgpu_wait_fence wait;
+    int ret;
+
+    if (copy_from_user(&args, uarg, sizeof(args)))
+        return -EFAULT;
+
+    /* The wait keys off the submit's own fence write */
+    if (!(args.submit.flags & MGPU_SUBMIT_FLAGS_FENCE))
+        return -EINVAL;
+
+    ret = mgpu_submit_commands(mdev, &args.submit);
+    if (ret)
+        return ret;
+
+    wait = (struct mgpu_wait_fence){
+        .fence_addr = args.submit.fence_addr,
+        .fence_value = args.submit.fence_value,
+        .timeout_ms = args.timeout_ms,
+    };
+
+    return mgpu_wait_fence(mdev, &wait);
+}
+
+static long mgpu_ioctl_wait_fence(struct mgpu_device *mdev, struct file *filp,
+                                  void __user *uarg)
+{
+    struct mgpu_wait_fence args;
+
+    if (copy_from_user(&args, uarg, sizeof(args)))
+        return -EFAULT;
+
+    return mgpu_wait_fence(mdev, &args);
+}
+
+static long mgpu_ioctl_load_shader(struct mgpu_device *mdev, struct file *filp,
+                                   void __user *uarg)
+{
+    struct mgpu_load_shader args;
+
+    if (copy_from_user(&args, uarg, sizeof(args)))
+        return -EFAULT;
+
+    return mgpu_load_shader(mdev, &args);
+}
+
+static long mgpu_ioctl_read_reg(struct mgpu_device *mdev, struct file *filp,
+                                void __user *uarg)
+{
+    struct mgpu_reg_access args;
+
+    if (copy_from_user(&args, uarg, sizeof(args)))
+        return -EFAULT;
+
+    if (args.offset >= resource_size(mdev->mmio_res))
+        return -EINVAL;
+
+    args.value = mgpu_read(mdev, args.offset);
+
+    /* value is the only output field */
+    if (put_user(args.value,
+                 &((struct mgpu_reg_access __user *)uarg)->value))
+        return -EFAULT;
+
+    return 0;
+}
+
+static long mgpu_ioctl_write_reg(struct mgpu_device *mdev, struct file *filp,
+                                 void __user *uarg)
+{
+    struct mgpu_reg_access args;
+
+    if (copy_from_user(&args, uarg, sizeof(args)))
+        return -EFAULT;
+
+    if (args.offset >= resource_size(mdev->mmio_res))
+        return -EINVAL;
+
+    mgpu_write(mdev, args.offset, args.value);
+
+    return 0;
+}
+
+/* Command numbers are dense (0x00..0x08), so a _IOC_NR-indexed table
+ * dispatches in constant time: one bounds check instead of the
+ * compare/branch cascade a sparse switch compiles to */
+static long (*const mgpu_ioctls[])(struct mgpu_device *, struct file *,
+                                   void __user *) = {
+    [_IOC_NR(MGPU_GET_INFO)]    = mgpu_ioctl_get_info,
+    [_IOC_NR(MGPU_BO_CREATE)]   = mgpu_ioctl_bo_create,
+    [_IOC_NR(MGPU_BO_MMAP)]     = mgpu_ioctl_bo_mmap,
+    [_IOC_NR(MGPU_BO_DESTROY)]  = mgpu_ioctl_bo_destroy,
+    [_IOC_NR(MGPU_SUBMIT)]      = mgpu_ioctl_submit,
+    [_IOC_NR(MGPU_WAIT_FENCE)]  = mgpu_ioctl_wait_fence,
+    [_IOC_NR(MGPU_LOAD_SHADER)] = mgpu_ioctl_load_shader,
+    [_IOC_NR(MGPU_READ_REG)]    = mgpu_ioctl_read_reg,
+    [_IOC_NR(MGPU_WRITE_REG)]   = mgpu_ioctl_write_reg,
+    [_IOC_NR(MGPU_SUBMIT_AND_WAIT)] = mgpu_ioctl_submit_wait,
+};
+
 static long mgpu_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 {
     struct mgpu_device *mdev = filp->private_data;
-    
-    switch (cmd) {
-    case MGPU_GET_INFO:
-        /* Return device info */
-        {
-            struct mgpu_info info = {
-                .version_major = MGPU_VERSION_MAJOR(mdev->version),
-                .version_minor = MGPU_VERSION_MINOR(mdev->version),
-                .version_patch = MGPU_VERSION_PATCH(mdev->version),
-                .capabilities = mdev->caps,
-                .num_engines = mdev->num_engines,
-                .num_queues = mdev->num_queues,
-                .max_width = 1920,
-                .max_height = 1080,
-                .max_threads = 256,
-                .memory_size = 64 * 1024 * 1024,  /* 64MB */
-                .shader_mem_size = 64 * 1024,     /* 64KB */
-            };
-            
-            if (copy_to_user((void __user *)arg, &info, sizeof(info)))
-                return -EFAULT;
-        }
-        break;
-        
-    case MGPU_BO_CREATE:
-        /* Create buffer object */
-        {
-            struct mgpu_bo_create args;
-            
-            if (copy_from_user(&args, (void __user *)arg, sizeof(args)))
-                return -EFAULT;
-            
-            ret = mgpu_bo_create(mdev, &args);
-            if (ret)
-                return ret;
-            
-            if (copy_to_user((void __user *)arg, &args, sizeof(args)))
-                return -EFAULT;
-        }
-        break;
-        
-    case MGPU_BO_DESTROY:
-        /* Destroy buffer object */
-        {
-            struct mgpu_bo_destroy args;
-            
-            if (copy_from_user(&args, (void __user *)arg, sizeof(args)))
-                return -EFAULT;
-            
-            return mgpu_bo_destroy(mdev, &args);
-        }
-        break;
-        
-    case MGPU_BO_MMAP:
-        /* Get mmap offset for buffer object */
-        {
-            struct mgpu_bo_mmap args;
-            
-            if (copy_from_user(&args, (void __user *)arg, sizeof(args)))
-                return -EFAULT;
-            
-            ret = mgpu_bo_mmap(mdev, &args, filp);
-            if (ret)
-                return ret;
-            
-            if (copy_to_user((void __user *)arg, &args, sizeof(args)))
-                return -EFAULT;
-        }
-        break;
-        
-    case MGPU_SUBMIT:
-        /* Submit commands */
-        {
-            struct mgpu_submit args;
-            
-            if (copy_from_user(&args, (void __user *)arg, sizeof(args)))
-                return -EFAULT;
-            
-            return mgpu_submit_commands(mdev, &args);
-        }
-        break;
-        
-    case MGPU_WAIT_FENCE:
-        /* Wait for fence */
-        {
-            struct mgpu_wait_fence args;
-            
-            if (copy_from_user(&args, (void __user *)arg, sizeof(args)))
-                return -EFAULT;
-            
-            return mgpu_wait_fence(mdev, &args);
-        }
-        break;
-        
-    case MGPU_LOAD_SHADER:
-        /* Load shader program */
-        {
-            struct mgpu_load_shader args;
-            
-            if (copy_from_user(&args, (void __user *)arg, sizeof(args)))
-                return -EFAULT;
-            
-            return mgpu_load_shader(mdev, &args);
-        }
-        break;
-        
-    case MGPU_READ_REG:
-        /* Read register (debug) */
-        {
-            struct mgpu_reg_access args;
-            
-            if (copy_from_user(&args, (void __user *)arg, sizeof(args)))
-                return -EFAULT;
-            
-            if (args.offset >= resource_size(mdev->mmio_res))
-                return -EINVAL;
-            
-            args.value = mgpu_read(mdev, args.offset);
-            
-            if (copy_to_user((void __user *)arg, &args, sizeof(args)))
-                return -EFAULT;
-        }
-        break;
-        
-    case MGPU_WRITE_REG:
-        /* Write register (debug) */
-        {
-            struct mgpu_reg_access args;
-            
-            if (copy_from_user(&args, (void __user *)arg, sizeof(args)))
-                return -EFAULT;
-            
-            if (args.offset >= resource_size(mdev->mmio_res))
-                return -EINVAL;
-            
-            mgpu_write(mdev, args.offset, args.value);
-        }
-        break;
-    default:
+    unsigned int nr = _IOC_NR(cmd);
+
+    if (_IOC_TYPE(cmd) != MGPU_IOCTL_BASE)
         return -EINVAL;
-    }
-    
-    return 0;
+
+    if (nr >= ARRAY_SIZE(mgpu_ioctls) || !mgpu_ioctls[nr])
+        return -EINVAL;
+
+    return mgpu_ioctls[nr](mdev, filp, (void __user *)arg);
 }
 
 static const struct file_operations mgpu_fops = {
@@ -380,7 +507,7 @@ static const struct file_operations mgpu_fops = {
     .open = mgpu_open,
     .release = mgpu_release,
     .unlocked_ioctl = mgpu_ioctl,
-    .compat_ioctl = mgpu_ioctl,
+    .compat_ioctl = compat_ptr_ioctl,
     .mmap = mgpu_mmap,
 };
 
@@ -403,8 +530,7 @@ static int mgpu_probe(struct platform_device *pdev)
     mgpu_dev = mdev;
     
     /* Initialize locks */
-    mutex_init(&mdev->bo_lock);
-    spin_lock_init(&mdev->cmd_lock);
+    spin_lock_init(&mdev->bo_list_lock);
     INIT_LIST_HEAD(&mdev->bo_list);
     
     /* Map MMIO registers */
@@ -426,23 +552,20 @@ static int mgpu_probe(struct platform_device *pdev)
         return mdev->irq;
     }
     
-    /* Request IRQ */
-    ret = devm_request_irq(&pdev->dev, mdev->irq, mgpu_irq_handler,
-                          IRQF_SHARED, DRIVER_NAME, mdev);
+    /* Request threaded IRQ */
+    ret = devm_request_threaded_irq(&pdev->dev, mdev->irq,
+                                    mgpu_irq_handler, mgpu_irq_thread,
+                                    IRQF_SHARED, DRIVER_NAME, mdev);
     if (ret) {
         dev_err(&pdev->dev, "Failed to request IRQ\n");
         return ret;
     }
     
-    /* Initialize tasklet */
-    tasklet_init(&mdev->irq_tasklet, mgpu_irq_tasklet_func,
-                (unsigned long)mdev);
-    
     /* Initialize hardware */
     ret = mgpu_hw_init(mdev);
     if (ret) {
         dev_err(&pdev->dev, "Failed to initialize hardware\n");
-        goto err_tasklet;
+        return ret;
     }
     
     /* Create character device */
@@ -494,8 +617,6 @@ err_chrdev:
     unregister_chrdev_region(mdev->devno, 1);
 err_hw:
     mgpu_hw_fini(mdev);
-err_tasklet:
-    tasklet_kill(&mdev->irq_tasklet);
     return ret;
 }
 
@@ -517,12 +638,10 @@ static int mgpu_remove(struct platform_device *pdev)
     cdev_del(&mdev->cdev);
     unregister_chrdev_region(mdev->devno, 1);
     
-    /* Shutdown hardware */
+    /* Shutdown hardware; the devm-managed IRQ (and its thread) is
+     * released after remove returns */
     mgpu_hw_fini(mdev);
     
-    /* Kill tasklet */
-    tasklet_kill(&mdev->irq_tasklet);
-    
     mgpu_dev = NULL;
     
     return 0;
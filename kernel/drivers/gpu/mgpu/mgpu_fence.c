@@ -4,10 +4,14 @@
 #include <linux/sched.h>
 #include <linux/jiffies.h>
 #include <linux/dma-mapping.h>
+#include <linux/mm.h>
 
 #include "mgpu_drm.h"
 #include "mgpu_regs.h"
 
+/* Wait-queue shards; power of two */
+#define MGPU_FENCE_WQ_SHARDS 16
+
 /* Fence context structure */
 struct mgpu_fence_context {
     struct mgpu_device *mdev;
@@ -16,28 +20,35 @@ struct mgpu_fence_context {
     u32 *cpu_addr;
     dma_addr_t dma_addr;
     
-    /* Current fence value */
-    atomic_t seqno;
-    
-    /* Wait queue for fence waits */
-    wait_queue_head_t wait_queue;
-    
-    /* List of pending waits */
-    struct list_head wait_list;
-    spinlock_t wait_lock;
+    /* Current fence value.  Cacheline-isolated: the submit path
+     * bumps this constantly, and without the separation every bump
+     * would bounce the line holding the wait-queue lock between the
+     * producer core and whichever cores are waking waiters */
+    atomic_t seqno ____cacheline_aligned_in_smp;
+    
+    /* Wait queues for fence waits, sharded so enqueues and wakeups
+     * for unrelated fences do not fight over one spinlock.  There is
+     * deliberately no wait list: each waiter's wake predicate reads
+     * its fence word directly, so the IRQ side just broadcasts to
+     * the shards and never walks anything */
+    wait_queue_head_t wait_queues[MGPU_FENCE_WQ_SHARDS]
+        ____cacheline_aligned_in_smp;
 };
 
-/* Fence wait entry */
-struct mgpu_fence_wait {
-    struct list_head list;
-    u32 value;
-    bool signaled;
-};
+/* Shard for a wait: slot waits hash on the slot, address waits on
+ * the dword address, so repeated waiters for one fence always meet
+ * the same queue */
+static wait_queue_head_t *mgpu_fence_waitq(struct mgpu_fence_context *ctx,
+                                           u64 key)
+{
+    return &ctx->wait_queues[key & (MGPU_FENCE_WQ_SHARDS - 1)];
+}
 
 /* Initialize fence subsystem */
 int mgpu_fence_init(struct mgpu_device *mdev)
 {
     struct mgpu_fence_context *ctx;
+    int i;
     
     ctx = kzalloc(sizeof(*ctx), GFP_KERNEL);
     if (!ctx)
@@ -45,13 +56,15 @@ int mgpu_fence_init(struct mgpu_device *mdev)
     
     ctx->mdev = mdev;
     atomic_set(&ctx->seqno, 0);
-    init_waitqueue_head(&ctx->wait_queue);
-    INIT_LIST_HEAD(&ctx->wait_list);
-    spin_lock_init(&ctx->wait_lock);
-    
-    /* Allocate fence memory (single page for fence values) */
-    ctx->cpu_addr = dma_alloc_coherent(mdev->dev, PAGE_SIZE,
-                                       &ctx->dma_addr, GFP_KERNEL);
+    for (i = 0; i < MGPU_FENCE_WQ_SHARDS; i++)
+        init_waitqueue_head(&ctx->wait_queues[i]);
+    
+    /* Allocate fence memory (single page for fence values).
+     * Write-combining: the GPU's seqno writes coalesce on the bus
+     * instead of going out as serialized single beats, and the CPU
+     * side only ever reads it */
+    ctx->cpu_addr = dma_alloc_wc(mdev->dev, PAGE_SIZE,
+                                 &ctx->dma_addr, GFP_KERNEL);
     if (!ctx->cpu_addr) {
         kfree(ctx);
         return -ENOMEM;
@@ -74,7 +87,7 @@ int mgpu_fence_init(struct mgpu_device *mdev)
 void mgpu_fence_fini(struct mgpu_device *mdev)
 {
     struct mgpu_fence_context *ctx = mdev->fence_ctx;
-    struct mgpu_fence_wait *wait, *tmp;
+    int i;
     
     if (!ctx)
         return;
@@ -83,26 +96,50 @@ void mgpu_fence_fini(struct mgpu_device *mdev)
     mgpu_write(mdev, MGPU_REG_FENCE_ADDR, 0);
     
     /* Wake up any waiters */
-    wake_up_all(&ctx->wait_queue);
-    
-    /* Clean up wait list */
-    spin_lock(&ctx->wait_lock);
-    list_for_each_entry_safe(wait, tmp, &ctx->wait_list, list) {
-        list_del(&wait->list);
-        kfree(wait);
-    }
-    spin_unlock(&ctx->wait_lock);
+    for (i = 0; i < MGPU_FENCE_WQ_SHARDS; i++)
+        wake_up_all(&ctx->wait_queues[i]);
     
     /* Free fence memory */
     if (ctx->cpu_addr)
-        dma_free_coherent(mdev->dev, PAGE_SIZE,
-                         ctx->cpu_addr, ctx->dma_addr);
+        dma_free_wc(mdev->dev, PAGE_SIZE,
+                    ctx->cpu_addr, ctx->dma_addr);
     
     kfree(ctx);
     mdev->fence_ctx = NULL;
 }
 
-/* Get next fence value */
+/* Map the fence page read-only into userspace so fence words can be
+ * polled with a plain load instead of an MGPU_WAIT_FENCE ioctl; the
+ * ioctl is then only needed when the caller actually wants to sleep */
+int mgpu_fence_mmap(struct mgpu_device *mdev, struct vm_area_struct *vma)
+{
+    struct mgpu_fence_context *ctx = mdev->fence_ctx;
+    unsigned long size = vma->vm_end - vma->vm_start;
+
+    if (!ctx)
+        return -ENODEV;
+
+    if (size > PAGE_SIZE)
+        return -EINVAL;
+
+    /* The GPU is the only writer of this page */
+    if (vma->vm_flags & VM_WRITE)
+        return -EPERM;
+
+    vma->vm_flags |= VM_IO | VM_DONTEXPAND | VM_DONTDUMP;
+    /* Keep mprotect() from later making it writable */
+    vma->vm_flags &= ~VM_MAYWRITE;
+
+    /* dma_mmap_wc translates the coherent allocation to the right
+     * CPU pages; the raw dma_addr is a bus address and shifting it
+     * into a pfn is wrong behind an IOMMU or dma-ranges offset */
+    return dma_mmap_wc(mdev->dev, vma, ctx->cpu_addr, ctx->dma_addr, size);
+}
+
+/* Get next fence value.  Allocation only needs monotonicity, not
+ * ordering against other memory — the submit path issues its own
+ * barrier before the doorbell — so the relaxed variant skips a full
+ * DMB per submission */
 u32 mgpu_fence_next(struct mgpu_device *mdev)
 {
     struct mgpu_fence_context *ctx = mdev->fence_ctx;
@@ -110,7 +147,22 @@ u32 mgpu_fence_next(struct mgpu_device *mdev)
     if (!ctx)
         return 0;
     
-    return atomic_inc_return(&ctx->seqno);
+    return atomic_inc_return_relaxed(&ctx->seqno);
+}
+
+/* Last fence value the GPU retired, read from the coherent fence
+ * page as a plain cached load; falls back to the FENCE_VALUE MMIO
+ * register before the fence context exists.  For samplers (health
+ * monitor, diagnostics) that want the value without a bus round
+ * trip */
+u32 mgpu_fence_current(struct mgpu_device *mdev)
+{
+    struct mgpu_fence_context *ctx = mdev->fence_ctx;
+
+    if (!ctx)
+        return mgpu_read_relaxed(mdev, MGPU_REG_FENCE_VALUE);
+
+    return READ_ONCE(ctx->cpu_addr[0]);
 }
 
 /* Check if fence is signaled */
@@ -130,84 +182,90 @@ bool mgpu_fence_signaled(struct mgpu_device *mdev, u64 fence_addr, u32 fence_val
     
     fence_ptr = ctx->cpu_addr + ((fence_addr - ctx->dma_addr) / sizeof(u32));
     
-    /* Read current fence value */
+    /* Order the fence read against the device write that signalled
+     * it (and any WC buffering in between) */
+    dma_rmb();
     current_value = READ_ONCE(*fence_ptr);
+
+    return mgpu_fence_value_passed(current_value, fence_value);
+}
+
+/* Slot-indexed signal check: one bounds test and one word read, no
+ * address arithmetic in the wait predicate */
+bool mgpu_fence_slot_signaled(struct mgpu_device *mdev, u32 slot,
+                              u32 fence_value)
+{
+    struct mgpu_fence_context *ctx = mdev->fence_ctx;
     
-    /* Fence is signaled if current value >= expected value */
-    return current_value >= fence_value;
+    if (!ctx || slot >= PAGE_SIZE / sizeof(u32))
+        return true;
+    
+    dma_rmb();
+    return mgpu_fence_value_passed(READ_ONCE(ctx->cpu_addr[slot]),
+                                   fence_value);
 }
 
-/* Process fence interrupts */
+/* Process fence interrupts.  Broadcast and return: every waiter
+ * re-evaluates its own fence word from coherent memory, so there is
+ * no shared waiter state for the IRQ side to lock, scan or keep in
+ * sync — and no contended cacheline between unrelated waiters */
 void mgpu_fence_process(struct mgpu_device *mdev)
 {
     struct mgpu_fence_context *ctx = mdev->fence_ctx;
-    struct mgpu_fence_wait *wait, *tmp;
-    bool wake = false;
+    int i;
     
     if (!ctx)
         return;
     
-    /* Check all pending waits */
-    spin_lock(&ctx->wait_lock);
-    list_for_each_entry_safe(wait, tmp, &ctx->wait_list, list) {
-        /* Check if this fence is now signaled */
-        if (!wait->signaled) {
-            /* Read hardware fence value */
-            u32 hw_value = mgpu_read(mdev, MGPU_REG_FENCE_VALUE);
-            if (hw_value >= wait->value) {
-                wait->signaled = true;
-                wake = true;
-            }
-        }
-    }
-    spin_unlock(&ctx->wait_lock);
-    
-    /* Wake up waiters if any fence was signaled */
-    if (wake)
-        wake_up_all(&ctx->wait_queue);
+    /* Pair with prepare_to_wait in the waiters before the lockless
+     * emptiness test; shards with no waiters cost no lock at all */
+    smp_mb();
+    for (i = 0; i < MGPU_FENCE_WQ_SHARDS; i++)
+        if (waitqueue_active(&ctx->wait_queues[i]))
+            wake_up_all(&ctx->wait_queues[i]);
 }
 
 /* Wait for fence */
 int mgpu_wait_fence(struct mgpu_device *mdev, struct mgpu_wait_fence *args)
 {
     struct mgpu_fence_context *ctx = mdev->fence_ctx;
-    struct mgpu_fence_wait wait_entry;
     unsigned long timeout;
     long ret;
     
     if (!ctx)
         return -ENODEV;
     
+    if (args->flags & MGPU_WAIT_FENCE_SLOT) {
+        /* Validate once here so the wait predicate is a pure read */
+        if (args->fence_slot >= PAGE_SIZE / sizeof(u32))
+            return -EINVAL;
+    }
+    
     /* Check if already signaled */
-    if (mgpu_fence_signaled(mdev, args->fence_addr, args->fence_value))
+    if (args->flags & MGPU_WAIT_FENCE_SLOT ?
+        mgpu_fence_slot_signaled(mdev, args->fence_slot, args->fence_value) :
+        mgpu_fence_signaled(mdev, args->fence_addr, args->fence_value))
         return 0;
     
-    /* Set up wait entry */
-    wait_entry.value = args->fence_value;
-    wait_entry.signaled = false;
-    INIT_LIST_HEAD(&wait_entry.list);
-    
-    /* Add to wait list */
-    spin_lock(&ctx->wait_lock);
-    list_add_tail(&wait_entry.list, &ctx->wait_list);
-    spin_unlock(&ctx->wait_lock);
-    
     /* Calculate timeout */
     if (args->timeout_ms == 0)
         timeout = MAX_SCHEDULE_TIMEOUT;
     else
         timeout = msecs_to_jiffies(args->timeout_ms);
     
-    /* Wait for fence */
-    ret = wait_event_interruptible_timeout(ctx->wait_queue,
-                                          mgpu_fence_signaled(mdev, args->fence_addr, 
-                                                            args->fence_value),
-                                          timeout);
-    
-    /* Remove from wait list */
-    spin_lock(&ctx->wait_lock);
-    list_del(&wait_entry.list);
-    spin_unlock(&ctx->wait_lock);
+    /* Wait for fence; the predicate reads the fence word itself, no
+     * per-waiter bookkeeping needed */
+    if (args->flags & MGPU_WAIT_FENCE_SLOT)
+        ret = wait_event_interruptible_timeout(*mgpu_fence_waitq(ctx, args->fence_slot),
+                                              mgpu_fence_slot_signaled(mdev,
+                                                                args->fence_slot,
+                                                                args->fence_value),
+                                              timeout);
+    else
+        ret = wait_event_interruptible_timeout(*mgpu_fence_waitq(ctx, args->fence_addr >> 2),
+                                              mgpu_fence_signaled(mdev, args->fence_addr, 
+                                                                args->fence_value),
+                                              timeout);
     
     if (ret == 0)
         return -ETIMEDOUT;
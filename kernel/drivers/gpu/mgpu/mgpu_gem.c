@@ -1,10 +1,16 @@
 #include <linux/module.h>
 #include <linux/dma-mapping.h>
 #include <linux/slab.h>
+#include <linux/rculist.h>
 #include <linux/mm.h>
 #include <linux/sched/mm.h>
 #include <linux/file.h>
 #include <linux/anon_inodes.h>
+#include <linux/xarray.h>
+#include <linux/maple_tree.h>
+#include <linux/dmapool.h>
+#include <linux/huge_mm.h>
+#include <linux/pfn_t.h>
 
 #include "mgpu_drm.h"
 #include "mgpu_gem.h"
@@ -14,125 +20,161 @@ static void mgpu_bo_vm_open(struct vm_area_struct *vma);
 static void mgpu_bo_vm_close(struct vm_area_struct *vma);
 static const struct vm_operations_struct mgpu_bo_vm_ops;
 
-/* Buffer object structure */
+/* Buffer object structure.  Laid out by temperature: the fields the
+ * lockless lookup/query and submit paths read sit together on the
+ * first cache line, the kref gets its own line so its RMW traffic
+ * does not bounce the read-mostly data, and teardown-only metadata
+ * trails at the end */
 struct mgpu_bo {
+    /* Hot, read-mostly: everything lookup/query/submit touch */
     struct mgpu_device *mdev;
-    struct list_head list;
-    
-    /* Memory info */
     void *vaddr;           /* CPU virtual address */
     dma_addr_t dma_addr;   /* DMA/GPU address */
     size_t size;           /* Size in bytes */
     u32 flags;             /* Creation flags */
-    
-    /* Reference counting */
-    struct kref refcount;
-    
-    /* Mapping info */
+    u32 handle;            /* Handle for userspace */
+
+    /* Reference counting, isolated from the read-mostly line */
+    struct kref refcount ____cacheline_aligned_in_smp;
+
+    /* Cold: creation/teardown and mmap bookkeeping */
+    struct dma_pool *pool; /* Set when backed by the page pool */
+    struct list_head list;
     struct page **pages;
     int nr_pages;
     struct sg_table *sgt;
-    
-    /* Handle for userspace */
-    u32 handle;
-    
+
     /* mmap offset management */
     struct drm_vma_offset_node vma_node;
-    struct rb_node node;       /* For mmap offset tree */
     u64 mmap_offset;          /* Unique offset for mmap */
-    
+
     /* File association */
     struct file *filp;         /* File that created this BO */
-    
+
     /* Sync */
     bool cached;
     bool dirty;
+
+    /* Deferred free so RCU walkers of the device list never see a
+     * freed structure */
+    struct rcu_head rcu;
 };
 
-/* Global IDR for handle management */
-static DEFINE_IDR(mgpu_bo_idr);
-static DEFINE_SPINLOCK(mgpu_bo_idr_lock);
+/* Global handle space.  An xarray instead of idr+spinlock: lookups
+ * are plain RCU loads, and allocation takes the xarray's internal
+ * lock only on create/destroy.  Cyclic allocation keeps handles from
+ * being reused immediately, which catches use-after-destroy bugs in
+ * userspace */
+static DEFINE_XARRAY_ALLOC(mgpu_bo_xa);
+static u32 mgpu_bo_next_handle;
+
+/* Pool of page-sized coherent blocks for the common single-page BO
+ * (command buffers, uniforms): creates skip the DMA allocator and
+ * IOMMU setup on every call.  Blocks are page-aligned, so each BO
+ * still owns its page outright and mmap page granularity holds.
+ * Created lazily on the first single-page BO */
+static struct dma_pool *mgpu_bo_page_pool;
+/* Own mutex: dma_pool_create sleeps, and the list lock is a spinlock */
+static DEFINE_MUTEX(mgpu_bo_pool_lock);
+
+/* Dedicated slab for struct mgpu_bo: exact object size instead of
+ * the next kmalloc bucket, cacheline aligned.  Created alongside the
+ * page pool on first use.  Not SLAB_TYPESAFE_BY_RCU — the lockless
+ * query path copies fields without taking a reference and relies on
+ * objects staying intact for a full grace period, so frees go
+ * through call_rcu instead */
+static struct kmem_cache *mgpu_bo_cache;
+
+static struct dma_pool *mgpu_bo_get_page_pool(struct mgpu_device *mdev)
+{
+    struct dma_pool *pool = READ_ONCE(mgpu_bo_page_pool);
+
+    if (pool)
+        return pool;
+
+    mutex_lock(&mgpu_bo_pool_lock);
+    if (!mgpu_bo_page_pool)
+        mgpu_bo_page_pool = dma_pool_create("mgpu-bo-page", mdev->dev,
+                                            PAGE_SIZE, PAGE_SIZE, 0);
+    pool = mgpu_bo_page_pool;
+    mutex_unlock(&mgpu_bo_pool_lock);
 
-/* Global mmap offset manager */
-static DEFINE_MUTEX(mgpu_mmap_lock);
-static struct rb_root mgpu_mmap_root = RB_ROOT;
-static u64 mgpu_mmap_offset_counter = 0x10000;  /* Start at 64KB offset */
+    return pool;
+}
+
+static struct kmem_cache *mgpu_bo_get_cache(void)
+{
+    struct kmem_cache *cache = READ_ONCE(mgpu_bo_cache);
+
+    if (cache)
+        return cache;
+
+    mutex_lock(&mgpu_bo_pool_lock);
+    if (!mgpu_bo_cache)
+        mgpu_bo_cache = kmem_cache_create("mgpu_bo",
+                                          sizeof(struct mgpu_bo), 0,
+                                          SLAB_HWCACHE_ALIGN, NULL);
+    cache = mgpu_bo_cache;
+    mutex_unlock(&mgpu_bo_pool_lock);
+
+    return cache;
+}
+
+static void mgpu_bo_free_rcu(struct rcu_head *rcu)
+{
+    kmem_cache_free(mgpu_bo_cache,
+                    container_of(rcu, struct mgpu_bo, rcu));
+}
+
+/* Global mmap offset manager.  A maple tree stores each BO against
+ * its [offset, offset + size) range: allocation and insert are one
+ * mtree_alloc_range call, and containment lookups are RCU loads, so
+ * concurrent mmap() calls on distinct BOs no longer serialize on a
+ * mutex around a hand-rolled rbtree.  Offsets start at 64KB to keep
+ * clear of the magic fence-page offset */
+#define MGPU_MMAP_OFFSET_MIN 0x10000
+
+static struct maple_tree mgpu_mmap_mt =
+    MTREE_INIT(mgpu_mmap_mt, MT_FLAGS_ALLOC_RANGE);
 
 /* Allocate a unique mmap offset for the BO */
 static int mgpu_bo_alloc_mmap_offset(struct mgpu_bo *bo)
 {
-    struct rb_node **new, *parent = NULL;
-    u64 offset;
-    
-    mutex_lock(&mgpu_mmap_lock);
-    
-    /* Allocate a unique offset */
-    offset = mgpu_mmap_offset_counter;
-    mgpu_mmap_offset_counter += bo->size;
-    mgpu_mmap_offset_counter = ALIGN(mgpu_mmap_offset_counter, PAGE_SIZE);
-    
+    unsigned long offset;
+    int ret;
+
+    /* Page-aligned sizes from a page-aligned floor keep every
+     * first-fit start page-aligned */
+    ret = mtree_alloc_range(&mgpu_mmap_mt, &offset, bo,
+                            ALIGN(bo->size, PAGE_SIZE),
+                            MGPU_MMAP_OFFSET_MIN, ULONG_MAX, GFP_KERNEL);
+    if (ret)
+        return ret;
+
     bo->mmap_offset = offset;
-    
-    /* Insert into RB tree */
-    new = &mgpu_mmap_root.rb_node;
-    while (*new) {
-        struct mgpu_bo *this = rb_entry(*new, struct mgpu_bo, node);
-        
-        parent = *new;
-        if (offset < this->mmap_offset)
-            new = &((*new)->rb_left);
-        else if (offset > this->mmap_offset)
-            new = &((*new)->rb_right);
-        else {
-            mutex_unlock(&mgpu_mmap_lock);
-            return -EEXIST;  /* Should never happen */
-        }
-    }
-    
-    /* Add new node and rebalance tree */
-    rb_link_node(&bo->node, parent, new);
-    rb_insert_color(&bo->node, &mgpu_mmap_root);
-    
-    mutex_unlock(&mgpu_mmap_lock);
-    
     return 0;
 }
 
 /* Free the mmap offset */
 static void mgpu_bo_free_mmap_offset(struct mgpu_bo *bo)
 {
-    mutex_lock(&mgpu_mmap_lock);
-    if (!RB_EMPTY_NODE(&bo->node)) {
-        rb_erase(&bo->node, &mgpu_mmap_root);
-        RB_CLEAR_NODE(&bo->node);
-    }
-    mutex_unlock(&mgpu_mmap_lock);
+    if (bo->mmap_offset)
+        mtree_erase(&mgpu_mmap_mt, bo->mmap_offset);
 }
 
-/* Look up BO by mmap offset */
+/* Look up BO by mmap offset; any offset inside the BO's range hits */
 struct mgpu_bo *mgpu_bo_lookup_by_offset(u64 offset)
 {
-    struct rb_node *node;
-    struct mgpu_bo *bo = NULL;
-    
-    mutex_lock(&mgpu_mmap_lock);
-    
-    node = mgpu_mmap_root.rb_node;
-    while (node) {
-        struct mgpu_bo *this = rb_entry(node, struct mgpu_bo, node);
-        
-        if (offset < this->mmap_offset) {
-            node = node->rb_left;
-        } else if (offset >= this->mmap_offset + this->size) {
-            node = node->rb_right;
-        } else {
-            bo = this;
-            kref_get(&bo->refcount);
-            break;
-        }
-    }
-    
-    mutex_unlock(&mgpu_mmap_lock);
+    struct mgpu_bo *bo;
+
+    rcu_read_lock();
+    bo = mtree_load(&mgpu_mmap_mt, offset);
+    /* A concurrent final put may already have dropped the last
+     * reference; refuse such a BO the same way handle lookup does
+     * rather than resurrect it */
+    if (bo && !kref_get_unless_zero(&bo->refcount))
+        bo = NULL;
+    rcu_read_unlock();
     
     return bo;
 }
@@ -140,45 +182,68 @@ struct mgpu_bo *mgpu_bo_lookup_by_offset(u64 offset)
 /* Allocate a unique handle for the BO */
 static int mgpu_bo_alloc_handle(struct mgpu_bo *bo)
 {
+    u32 id;
     int ret;
-    
-    idr_preload(GFP_KERNEL);
-    spin_lock(&mgpu_bo_idr_lock);
-    ret = idr_alloc(&mgpu_bo_idr, bo, 1, 0, GFP_NOWAIT);
-    spin_unlock(&mgpu_bo_idr_lock);
-    idr_preload_end();
-    
+
+    ret = xa_alloc_cyclic(&mgpu_bo_xa, &id, bo, XA_LIMIT(1, INT_MAX),
+                          &mgpu_bo_next_handle, GFP_KERNEL);
     if (ret < 0)
         return ret;
-    
-    bo->handle = ret;
+
+    bo->handle = id;
     return 0;
 }
 
 /* Free the BO handle */
 static void mgpu_bo_free_handle(struct mgpu_bo *bo)
 {
-    spin_lock(&mgpu_bo_idr_lock);
-    idr_remove(&mgpu_bo_idr, bo->handle);
-    spin_unlock(&mgpu_bo_idr_lock);
+    xa_erase(&mgpu_bo_xa, bo->handle);
 }
 
-/* Look up BO by handle */
+/* Look up BO by handle.  Lockless: xa_load nests under
+ * rcu_read_lock, and kref_get_unless_zero refuses a BO whose last
+ * reference is already gone but whose handle has not yet been erased
+ * from the xarray, so parallel submitters never contend on lookup */
 struct mgpu_bo *mgpu_bo_lookup(struct mgpu_device *mdev, u32 handle)
 {
     struct mgpu_bo *bo;
-    
-    spin_lock(&mgpu_bo_idr_lock);
-    bo = idr_find(&mgpu_bo_idr, handle);
-    if (bo && bo->mdev == mdev)
-        kref_get(&bo->refcount);
-    else
+
+    rcu_read_lock();
+    bo = xa_load(&mgpu_bo_xa, handle);
+    if (!bo || bo->mdev != mdev || !kref_get_unless_zero(&bo->refcount))
         bo = NULL;
-    spin_unlock(&mgpu_bo_idr_lock);
-    
+    rcu_read_unlock();
+
     return bo;
 }
 
+/* Lockless query of a BO's POD fields by handle.  xa_load nests
+ * under rcu_read_lock, the handle is erased before the structure is
+ * queued for kfree_rcu, and we copy plain values rather than keep
+ * the pointer — so no reference needs to be taken or dropped.  Saves
+ * two atomics per ioctl on paths that only need the GPU address */
+int mgpu_bo_query(struct mgpu_device *mdev, u32 handle, dma_addr_t *dma_addr,
+                  size_t *size, u32 *flags)
+{
+    struct mgpu_bo *bo;
+    int ret = -EINVAL;
+
+    rcu_read_lock();
+    bo = xa_load(&mgpu_bo_xa, handle);
+    if (bo && bo->mdev == mdev) {
+        if (dma_addr)
+            *dma_addr = bo->dma_addr;
+        if (size)
+            *size = bo->size;
+        if (flags)
+            *flags = bo->flags;
+        ret = 0;
+    }
+    rcu_read_unlock();
+    
+    return ret;
+}
+
 /* Free the actual BO memory and structure */
 static void mgpu_bo_free(struct kref *ref)
 {
@@ -187,17 +252,28 @@ static void mgpu_bo_free(struct kref *ref)
     
     dev_dbg(mdev->dev, "Freeing BO handle %u, size %zu\n", bo->handle, bo->size);
     
-    /* Remove from device list */
-    mutex_lock(&mdev->bo_lock);
-    list_del(&bo->list);
-    mutex_unlock(&mdev->bo_lock);
+    /* Remove from device list; RCU walkers may still hold the
+     * pointer, so the structure itself is freed a grace period
+     * later.  mgpu_gem_cleanup unlinks BOs itself before putting
+     * them (it cannot hold the list lock across the put without
+     * self-deadlocking here), hence the list_empty guard */
+    spin_lock(&mdev->bo_list_lock);
+    if (!list_empty(&bo->list))
+        list_del_rcu(&bo->list);
+    spin_unlock(&mdev->bo_list_lock);
+    
+    atomic_dec(&mdev->bo_count);
+    atomic64_sub(bo->size, &mdev->bo_total_bytes);
     
     /* Free mmap offset */
     mgpu_bo_free_mmap_offset(bo);
     
     /* Free the memory based on allocation type */
     if (bo->vaddr) {
-        if (bo->flags & MGPU_BO_FLAGS_COHERENT) {
+        if (bo->pool) {
+            dma_pool_free(bo->pool, bo->vaddr, bo->dma_addr);
+        } else if (bo->flags &
+                   (MGPU_BO_FLAGS_COHERENT | MGPU_BO_FLAGS_FENCE)) {
             dma_free_coherent(mdev->dev, bo->size, bo->vaddr, bo->dma_addr);
         } else {
             dma_free_attrs(mdev->dev, bo->size, bo->vaddr, bo->dma_addr,
@@ -205,20 +281,22 @@ static void mgpu_bo_free(struct kref *ref)
         }
     }
     
-    /* Free scatter-gather table if exists */
-    if (bo->sgt) {
+    /* Free scatter-gather table if it exists; no current allocation
+     * path sets one, so tell the compiler this branch is cold */
+    if (unlikely(bo->sgt)) {
         sg_free_table(bo->sgt);
         kfree(bo->sgt);
     }
-    
+
     /* Free pages array */
-    kfree(bo->pages);
+    if (unlikely(bo->pages))
+        kfree(bo->pages);
     
     /* Free handle */
     mgpu_bo_free_handle(bo);
     
-    /* Free the BO structure */
-    kfree(bo);
+    /* Free the BO structure once readers are done with it */
+    call_rcu(&bo->rcu, mgpu_bo_free_rcu);
 }
 
 /* Release BO reference */
@@ -229,60 +307,88 @@ void mgpu_bo_put(struct mgpu_bo *bo)
 }
 
 /* Create a new buffer object */
+/* Hard cap on a single BO; also keeps PAGE_ALIGN below well away
+ * from u32 wraparound */
+#define MGPU_BO_MAX_SIZE    (256 * 1024 * 1024)
+
 int mgpu_bo_create(struct mgpu_device *mdev, struct mgpu_bo_create *args)
 {
+    struct kmem_cache *cache;
     struct mgpu_bo *bo;
+    size_t aligned;
     int ret;
-    
-    /* Validate size */
-    if (!args->size || args->size > (256 * 1024 * 1024)) {
+
+    /* Validate size before aligning: PAGE_ALIGN of a u32 in the last
+     * page of its range would wrap to zero */
+    if (!args->size || args->size > MGPU_BO_MAX_SIZE) {
         dev_err(mdev->dev, "Invalid BO size: %u\n", args->size);
         return -EINVAL;
     }
-    
-    /* Align size to page boundary */
-    args->size = PAGE_ALIGN(args->size);
-    
-    /* Allocate BO structure */
-    bo = kzalloc(sizeof(*bo), GFP_KERNEL);
+
+    /* Align in size_t space and leave the caller's size untouched.
+     * Large BOs round up to a 2MB multiple: CMA then hands back a
+     * PMD-alignable block and the huge-fault path can map it with
+     * 2MB entries instead of thousands of PTEs */
+    aligned = PAGE_ALIGN((size_t)args->size);
+    if (aligned >= PMD_SIZE)
+        aligned = ALIGN(aligned, PMD_SIZE);
+
+    /* Allocate BO structure from the dedicated slab */
+    cache = mgpu_bo_get_cache();
+    if (!cache)
+        return -ENOMEM;
+
+    bo = kmem_cache_zalloc(cache, GFP_KERNEL);
     if (!bo)
         return -ENOMEM;
-    
+
     bo->mdev = mdev;
-    bo->size = args->size;
+    bo->size = aligned;
     bo->flags = args->flags;
     kref_init(&bo->refcount);
     INIT_LIST_HEAD(&bo->list);
-    RB_CLEAR_NODE(&bo->node);
-    
-    /* Allocate memory based on flags */
-    if (args->flags & MGPU_BO_FLAGS_COHERENT) {
-        /* Coherent DMA memory */
-        bo->vaddr = dma_alloc_coherent(mdev->dev, bo->size,
-                                       &bo->dma_addr, GFP_KERNEL);
-        bo->cached = false;
-    } else if (args->flags & MGPU_BO_FLAGS_WRITE_COMBINE) {
+
+    /* Allocate memory based on flags.  Fence buffers must be
+     * coherent: userspace polls them while the GPU writes, so there
+     * can be no CPU cache between the two */
+    if (args->flags & MGPU_BO_FLAGS_WRITE_COMBINE) {
         /* Write-combined memory */
         bo->vaddr = dma_alloc_attrs(mdev->dev, bo->size,
                                    &bo->dma_addr, GFP_KERNEL,
                                    DMA_ATTR_WRITE_COMBINE);
         bo->cached = false;
     } else {
-        /* Default cached memory */
-        bo->vaddr = dma_alloc_coherent(mdev->dev, bo->size,
-                                       &bo->dma_addr, GFP_KERNEL);
-        bo->cached = true;
+        /* Coherent DMA memory; single-page BOs come pre-zeroed from
+         * the page pool instead of a full allocator round trip */
+        if (bo->size == PAGE_SIZE) {
+            struct dma_pool *pool = mgpu_bo_get_page_pool(mdev);
+
+            if (pool) {
+                bo->vaddr = dma_pool_zalloc(pool, GFP_KERNEL,
+                                            &bo->dma_addr);
+                bo->pool = pool;
+            }
+        }
+        if (!bo->vaddr) {
+            bo->pool = NULL;
+            bo->vaddr = dma_alloc_coherent(mdev->dev, bo->size,
+                                           &bo->dma_addr, GFP_KERNEL);
+        }
+        bo->cached = !(args->flags &
+                       (MGPU_BO_FLAGS_COHERENT | MGPU_BO_FLAGS_FENCE));
     }
-    
+
     if (!bo->vaddr) {
         dev_err(mdev->dev, "Failed to allocate %zu bytes\n", bo->size);
         ret = -ENOMEM;
         goto err_free_bo;
     }
-    
-    /* Clear the memory */
-    memset(bo->vaddr, 0, bo->size);
-    
+
+    /* No memset: dma_alloc_coherent/dma_alloc_attrs return zeroed
+     * memory, and pool blocks come from dma_pool_zalloc.  Zeroing
+     * here again would stream size-proportional uncached/WC writes
+     * on every create for nothing */
+
     /* Allocate handle */
     ret = mgpu_bo_alloc_handle(bo);
     if (ret) {
@@ -298,15 +404,21 @@ int mgpu_bo_create(struct mgpu_device *mdev, struct mgpu_bo_create *args)
     }
     
     /* Add to device list */
-    mutex_lock(&mdev->bo_lock);
-    list_add(&bo->list, &mdev->bo_list);
-    mutex_unlock(&mdev->bo_lock);
+    spin_lock(&mdev->bo_list_lock);
+    list_add_rcu(&bo->list, &mdev->bo_list);
+    spin_unlock(&mdev->bo_list_lock);
+    
+    atomic_inc(&mdev->bo_count);
+    atomic64_add(bo->size, &mdev->bo_total_bytes);
     
     /* Return info to userspace */
     args->handle = bo->handle;
-    args->gpu_addr = (u32)bo->dma_addr;  /* Truncate for 32-bit GPU */
-    
-    dev_dbg(mdev->dev, "Created BO handle %u, size %zu, gpu_addr 0x%08x, mmap_offset 0x%llx\n",
+    /* Full-width address: on 32-bit-only devices the DMA mask
+     * negotiated at probe already keeps this under 4GB, so nothing
+     * is silently truncated on IOMMU/highmem systems */
+    args->gpu_addr = bo->dma_addr;
+
+    dev_dbg(mdev->dev, "Created BO handle %u, size %zu, gpu_addr 0x%llx, mmap_offset 0x%llx\n",
             bo->handle, bo->size, args->gpu_addr, bo->mmap_offset);
     
     return 0;
@@ -314,14 +426,16 @@ int mgpu_bo_create(struct mgpu_device *mdev, struct mgpu_bo_create *args)
 err_free_handle:
     mgpu_bo_free_handle(bo);
 err_free_mem:
-    if (bo->flags & MGPU_BO_FLAGS_COHERENT) {
+    if (bo->pool) {
+        dma_pool_free(bo->pool, bo->vaddr, bo->dma_addr);
+    } else if (bo->flags & (MGPU_BO_FLAGS_COHERENT | MGPU_BO_FLAGS_FENCE)) {
         dma_free_coherent(mdev->dev, bo->size, bo->vaddr, bo->dma_addr);
     } else {
         dma_free_attrs(mdev->dev, bo->size, bo->vaddr, bo->dma_addr,
                       DMA_ATTR_WRITE_COMBINE);
     }
 err_free_bo:
-    kfree(bo);
+    kmem_cache_free(mgpu_bo_cache, bo);
     return ret;
 }
 
@@ -345,34 +459,33 @@ int mgpu_bo_destroy(struct mgpu_device *mdev, struct mgpu_bo_destroy *args)
     return 0;
 }
 
-/* mmap() implementation for BOs */
+/* Apply the BO's cacheability to a base protection.  One shared
+ * definition for both mmap paths; on arm the pgprot transforms are
+ * constant bit edits, so there is nothing worth caching per BO */
+static pgprot_t mgpu_bo_pgprot(struct mgpu_bo *bo, pgprot_t prot)
+{
+    if (bo->flags & MGPU_BO_FLAGS_CACHED)
+        return prot;
+    if (bo->flags & MGPU_BO_FLAGS_WRITE_COMBINE)
+        return pgprot_writecombine(prot);
+    return pgprot_noncached(prot);
+}
+
+/* mmap() implementation for BOs; pages fault in on demand */
 static int mgpu_bo_mmap_obj(struct mgpu_bo *bo, struct vm_area_struct *vma)
 {
-    struct mgpu_device *mdev = bo->mdev;
-    unsigned long pfn;
-    int ret;
-    
     /* Check size */
     if (vma->vm_end - vma->vm_start > bo->size)
         return -EINVAL;
-    
+
     /* Set VM flags */
     vma->vm_flags |= VM_IO | VM_PFNMAP | VM_DONTEXPAND | VM_DONTDUMP;
-    vma->vm_page_prot = pgprot_noncached(vma->vm_page_prot);
-    
-    if (bo->flags & MGPU_BO_FLAGS_WRITE_COMBINE)
-        vma->vm_page_prot = pgprot_writecombine(vma->vm_page_prot);
-    
-    /* Map the pages */
-    pfn = bo->dma_addr >> PAGE_SHIFT;
-    ret = remap_pfn_range(vma, vma->vm_start, pfn,
-                         vma->vm_end - vma->vm_start,
-                         vma->vm_page_prot);
-    
-    if (ret)
-        dev_err(mdev->dev, "Failed to map BO: %d\n", ret);
-    
-    return ret;
+    vma->vm_page_prot = mgpu_bo_pgprot(bo, vma->vm_page_prot);
+
+    vma->vm_private_data = bo;
+    vma->vm_ops = &mgpu_bo_vm_ops;
+
+    return 0;
 }
 
 /* VM operations for BO mappings */
@@ -390,9 +503,59 @@ static void mgpu_bo_vm_close(struct vm_area_struct *vma)
         mgpu_bo_put(bo);
 }
 
+/* Demand faulting: mmap() itself only sets up the vma, and each page
+ * is inserted on first touch.  Mapping eagerly with remap_pfn_range
+ * populated every PTE under mmap_lock at mmap time — a long write-lock
+ * hold for large BOs — and paid for pages the application never
+ * touches */
+static vm_fault_t mgpu_bo_vm_fault(struct vm_fault *vmf)
+{
+    struct vm_area_struct *vma = vmf->vma;
+    struct mgpu_bo *bo = vma->vm_private_data;
+    unsigned long pgoff = vmf->pgoff - vma->vm_pgoff;
+
+    if (!bo || pgoff >= bo->size >> PAGE_SHIFT)
+        return VM_FAULT_SIGBUS;
+
+    return vmf_insert_pfn(vma, vmf->address,
+                          (bo->dma_addr >> PAGE_SHIFT) + pgoff);
+}
+
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+/* PMD-sized faults for large BOs: one 2MB entry instead of 512 PTEs
+ * wherever device address, user address and BO bounds all line up;
+ * anything else falls back to the 4KB path above */
+static vm_fault_t mgpu_bo_vm_huge_fault(struct vm_fault *vmf,
+                                        enum page_entry_size pe_size)
+{
+    struct vm_area_struct *vma = vmf->vma;
+    struct mgpu_bo *bo = vma->vm_private_data;
+    unsigned long pgoff = vmf->pgoff - vma->vm_pgoff;
+    phys_addr_t phys;
+
+    if (!bo || pe_size != PE_SIZE_PMD)
+        return VM_FAULT_FALLBACK;
+
+    phys = bo->dma_addr + ((phys_addr_t)pgoff << PAGE_SHIFT);
+
+    if (!IS_ALIGNED(vmf->address, PMD_SIZE) ||
+        !IS_ALIGNED(phys, PMD_SIZE) ||
+        ((size_t)pgoff << PAGE_SHIFT) + PMD_SIZE > bo->size)
+        return VM_FAULT_FALLBACK;
+
+    return vmf_insert_pfn_pmd(vmf,
+                              __pfn_to_pfn_t(phys >> PAGE_SHIFT, PFN_DEV),
+                              vmf->flags & FAULT_FLAG_WRITE);
+}
+#endif
+
 static const struct vm_operations_struct mgpu_bo_vm_ops = {
     .open = mgpu_bo_vm_open,
     .close = mgpu_bo_vm_close,
+    .fault = mgpu_bo_vm_fault,
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+    .huge_fault = mgpu_bo_vm_huge_fault,
+#endif
 };
 
 /* Get mmap offset for a BO */
@@ -425,9 +588,11 @@ int mgpu_mmap(struct file *filp, struct vm_area_struct *vma)
     struct mgpu_bo *bo;
     unsigned long offset = vma->vm_pgoff << PAGE_SHIFT;
     unsigned long size = vma->vm_end - vma->vm_start;
-    unsigned long pfn;
-    int ret;
-    
+
+    /* Magic offsets live below the BO range */
+    if (offset == MGPU_MMAP_FENCE_PAGE)
+        return mgpu_fence_mmap(mdev, vma);
+
     /* Look up BO by mmap offset */
     bo = mgpu_bo_lookup_by_offset(offset);
     if (!bo) {
@@ -451,27 +616,14 @@ int mgpu_mmap(struct file *filp, struct vm_area_struct *vma)
     
     /* Set VM flags */
     vma->vm_flags |= VM_IO | VM_PFNMAP | VM_DONTEXPAND | VM_DONTDUMP;
-    
+
     /* Set page protection based on BO flags */
-    if (bo->flags & MGPU_BO_FLAGS_CACHED) {
-        vma->vm_page_prot = vm_get_page_prot(vma->vm_flags);
-    } else if (bo->flags & MGPU_BO_FLAGS_WRITE_COMBINE) {
-        vma->vm_page_prot = pgprot_writecombine(vm_get_page_prot(vma->vm_flags));
-    } else {
-        vma->vm_page_prot = pgprot_noncached(vm_get_page_prot(vma->vm_flags));
-    }
-    
-    /* Map the physical pages */
-    pfn = bo->dma_addr >> PAGE_SHIFT;
-    ret = remap_pfn_range(vma, vma->vm_start, pfn, size, vma->vm_page_prot);
-    
-    if (ret) {
-        dev_err(mdev->dev, "Failed to map BO: %d\n", ret);
-        mgpu_bo_put(bo);
-        return ret;
-    }
-    
-    /* Store BO reference in VMA private data for unmapping */
+    vma->vm_page_prot = mgpu_bo_pgprot(bo, vm_get_page_prot(vma->vm_flags));
+
+
+    /* No eager remap_pfn_range: the vma is set up in O(1) and pages
+     * are inserted by the fault handler on first touch.  The lookup
+     * reference transfers to the vma and is dropped in vm_close */
     vma->vm_private_data = bo;
     vma->vm_ops = &mgpu_bo_vm_ops;
     
@@ -481,26 +633,6 @@ int mgpu_mmap(struct file *filp, struct vm_area_struct *vma)
     return 0;
 }
 
-/* VM operations for BO mappings */
-static void mgpu_bo_vm_open(struct vm_area_struct *vma)
-{
-    struct mgpu_bo *bo = vma->vm_private_data;
-    if (bo)
-        kref_get(&bo->refcount);
-}
-
-static void mgpu_bo_vm_close(struct vm_area_struct *vma)
-{
-    struct mgpu_bo *bo = vma->vm_private_data;
-    if (bo)
-        mgpu_bo_put(bo);
-}
-
-static const struct vm_operations_struct mgpu_bo_vm_ops = {
-    .open = mgpu_bo_vm_open,
-    .close = mgpu_bo_vm_close,
-};
-
 /* CPU access to BO */
 void *mgpu_bo_vmap(struct mgpu_bo *bo)
 {
@@ -515,63 +647,121 @@ void mgpu_bo_vunmap(struct mgpu_bo *bo, void *vaddr)
 }
 
 /* Cache management */
-int mgpu_bo_cpu_prep(struct mgpu_bo *bo, bool write)
+/* Ranged CPU-access sync: cache maintenance is O(touched bytes), so
+ * callers that only read or wrote a slice of a large cached BO
+ * should say so instead of paying a full-buffer flush */
+int mgpu_bo_cpu_prep_range(struct mgpu_bo *bo, u64 offset, u64 length,
+                           bool write)
 {
     struct mgpu_device *mdev = bo->mdev;
-    
-    if (!bo->cached)
+
+    /* Coherent and WC BOs — the common case — need no maintenance */
+    if (likely(!bo->cached))
         return 0;
-    
-    /* Invalidate cache for reads */
+
+    if (offset >= bo->size || length > bo->size - offset)
+        return -EINVAL;
+
+    /* Invalidate cache for reads; BOs backed by an sg_table get the
+     * batched per-list sync instead of per-range calls */
     if (!write) {
-        dma_sync_single_for_cpu(mdev->dev, bo->dma_addr,
-                               bo->size, DMA_FROM_DEVICE);
+        mgpu_dma_sync_sgt_for_cpu(mdev, bo->sgt, bo->dma_addr + offset,
+                                  length, DMA_FROM_DEVICE);
     }
-    
+
     return 0;
 }
 
-int mgpu_bo_cpu_fini(struct mgpu_bo *bo, bool write)
+int mgpu_bo_cpu_fini_range(struct mgpu_bo *bo, u64 offset, u64 length,
+                           bool write)
 {
     struct mgpu_device *mdev = bo->mdev;
-    
-    if (!bo->cached)
+
+    /* Coherent and WC BOs — the common case — need no maintenance */
+    if (likely(!bo->cached))
         return 0;
-    
-    /* Flush cache for writes */
+
+    if (offset >= bo->size || length > bo->size - offset)
+        return -EINVAL;
+
+    /* Flush cache for writes; batched per-list sync where an sg_table
+     * describes the mapping */
     if (write) {
-        dma_sync_single_for_device(mdev->dev, bo->dma_addr,
-                                   bo->size, DMA_TO_DEVICE);
+        mgpu_dma_sync_sgt_for_device(mdev, bo->sgt,
+                                     bo->dma_addr + offset,
+                                     length, DMA_TO_DEVICE);
         bo->dirty = true;
     }
-    
+
     return 0;
 }
 
+int mgpu_bo_cpu_prep(struct mgpu_bo *bo, bool write)
+{
+    return mgpu_bo_cpu_prep_range(bo, 0, bo->size, write);
+}
+
+int mgpu_bo_cpu_fini(struct mgpu_bo *bo, bool write)
+{
+    return mgpu_bo_cpu_fini_range(bo, 0, bo->size, write);
+}
+
 /* Clean up all BOs on device removal */
 void mgpu_gem_cleanup(struct mgpu_device *mdev)
 {
     struct mgpu_bo *bo, *tmp;
-    struct rb_node *node;
-    
-    mutex_lock(&mdev->bo_lock);
-    list_for_each_entry_safe(bo, tmp, &mdev->bo_list, list) {
+    LIST_HEAD(reap);
+
+    /* Unlink everything up front: splice the device list, then tear
+     * down the handle and offset indices wholesale rather than
+     * erasing entry by entry through the refcount machinery.  That
+     * turns N trips through four global locks into one pass per
+     * index, after which no lookup path can reach any BO */
+    spin_lock(&mdev->bo_list_lock);
+    list_splice_init(&mdev->bo_list, &reap);
+    spin_unlock(&mdev->bo_list_lock);
+
+    xa_destroy(&mgpu_bo_xa);
+    mtree_destroy(&mgpu_mmap_mt);
+
+    /* Let RCU readers that raced the teardown (debugfs walkers,
+     * lockless lookups) drain before the backing memory goes */
+    synchronize_rcu();
+
+    /* Free directly, no per-BO locking or refcount dance */
+    list_for_each_entry_safe(bo, tmp, &reap, list) {
         list_del(&bo->list);
-        /* Force free */
-        while (kref_read(&bo->refcount) > 0)
-            mgpu_bo_put(bo);
-    }
-    mutex_unlock(&mdev->bo_lock);
-    
-    /* Clean up mmap RB tree */
-    mutex_lock(&mgpu_mmap_lock);
-    while ((node = rb_first(&mgpu_mmap_root))) {
-        bo = rb_entry(node, struct mgpu_bo, node);
-        rb_erase(node, &mgpu_mmap_root);
-        /* BO should already be freed, just clean up the tree */
+
+        if (bo->vaddr) {
+            if (bo->pool)
+                dma_pool_free(bo->pool, bo->vaddr, bo->dma_addr);
+            else if (bo->flags &
+                     (MGPU_BO_FLAGS_COHERENT | MGPU_BO_FLAGS_FENCE))
+                dma_free_coherent(mdev->dev, bo->size, bo->vaddr,
+                                  bo->dma_addr);
+            else
+                dma_free_attrs(mdev->dev, bo->size, bo->vaddr,
+                               bo->dma_addr, DMA_ATTR_WRITE_COMBINE);
+        }
+
+        if (unlikely(bo->sgt)) {
+            sg_free_table(bo->sgt);
+            kfree(bo->sgt);
+        }
+        if (unlikely(bo->pages))
+            kfree(bo->pages);
+        kmem_cache_free(mgpu_bo_cache, bo);
     }
-    mutex_unlock(&mgpu_mmap_lock);
-    
-    /* Clean up IDR */
-    idr_destroy(&mgpu_bo_idr);
+
+    atomic_set(&mdev->bo_count, 0);
+    atomic64_set(&mdev->bo_total_bytes, 0);
+
+    /* All pool blocks were returned above */
+    dma_pool_destroy(mgpu_bo_page_pool);
+    mgpu_bo_page_pool = NULL;
+
+    /* Flush any call_rcu frees still in flight, then drop the slab */
+    rcu_barrier();
+    kmem_cache_destroy(mgpu_bo_cache);
+    mgpu_bo_cache = NULL;
 }
\ No newline at end of file
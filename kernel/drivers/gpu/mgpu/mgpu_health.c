@@ -12,8 +12,7 @@
 #include <linux/kernel.h>
 #include <linux/workqueue.h>
 #include <linux/jiffies.h>
-#include <linux/kthread.h>
-#include <linux/delay.h>
+#include <linux/prefetch.h>
 
 #include "mgpu_drm.h"
 #include "mgpu_regs.h"
@@ -22,21 +21,32 @@
 /* Health check intervals */
 #define MGPU_HEALTH_CHECK_INTERVAL_MS  1000    /* 1 second */
 #define MGPU_HEARTBEAT_TIMEOUT_MS      5000    /* 5 seconds */
-#define MGPU_HANG_CHECK_INTERVAL_MS    2000    /* 2 seconds */
 #define MGPU_ERROR_THRESHOLD           10      /* Errors before reset */
 
-/* Health monitoring state */
+/* Health monitoring state, laid out by temperature: the per-tick
+ * tracking fields sit together on the first cache line so a check
+ * touches one line; the stats block (read once a minute or at fini)
+ * and config tail start on their own line to keep false sharing off
+ * the hot fields */
 struct mgpu_health_monitor {
     struct mgpu_device *mdev;
-    
-    /* Health check work */
-    struct delayed_work health_work;
-    struct delayed_work hang_check_work;
-    
-    /* Monitoring thread */
-    struct task_struct *monitor_thread;
     bool monitoring_enabled;
-    
+
+    /* Hot: error/hang/heartbeat tracking, touched every tick */
+    u32 consecutive_errors;
+    u32 last_fence_value;
+    u32 last_cmd_head;
+    u32 heartbeat_counter;
+    u32 last_irq_count;
+    u32 log_ticks_remaining;
+    unsigned long last_activity;
+    unsigned long last_heartbeat;
+
+    /* Cold from here down.  Periodic check, on the power-efficient
+     * queue so the 1s tick can land on a housekeeping CPU instead
+     * of waking an idle one */
+    struct delayed_work health_work ____cacheline_aligned_in_smp;
+
     /* Health statistics */
     struct {
         unsigned long check_count;
@@ -44,26 +54,13 @@ struct mgpu_health_monitor {
         unsigned long hang_count;
         unsigned long recovery_count;
         unsigned long heartbeat_misses;
-        ktime_t last_check;
-        ktime_t last_error;
-        ktime_t last_hang;
-        ktime_t uptime_start;
+        /* Jiffies, not ktime: second-granularity stats do not merit
+         * a clocksource read per tick */
+        unsigned long last_check;
+        unsigned long last_error;
+        unsigned long last_hang;
+        unsigned long uptime_start;
     } stats;
-    
-    /* Error tracking */
-    u32 consecutive_errors;
-    u32 last_fence_value;
-    u32 last_cmd_head;
-    unsigned long last_activity;
-    
-    /* Heartbeat */
-    u32 heartbeat_counter;
-    unsigned long last_heartbeat;
-    
-    /* Temperature monitoring (if available) */
-    int temperature;
-    int max_temperature;
-    bool thermal_throttled;
 };
 
 /* Error codes and descriptions */
@@ -74,41 +71,85 @@ struct mgpu_error_info {
     bool recoverable;
 };
 
+/* Indexed by error code: the hardware codes are a dense 0x00..0x05
+ * enum, so entry i must carry code i (mgpu_get_error_info relies on
+ * it) */
 static const struct mgpu_error_info mgpu_error_table[] = {
-    { MGPU_ERROR_NONE,         "NONE",         "No error",                false },
-    { MGPU_ERROR_INVALID_CMD,  "INVALID_CMD",  "Invalid command",         true  },
-    { MGPU_ERROR_MEM_FAULT,    "MEM_FAULT",    "Memory access fault",     true  },
-    { MGPU_ERROR_SHADER_FAULT, "SHADER_FAULT", "Shader execution fault",  true  },
-    { MGPU_ERROR_TIMEOUT,      "TIMEOUT",      "Operation timeout",       true  },
-    { MGPU_ERROR_OVERFLOW,     "OVERFLOW",     "Queue overflow",          true  },
+    [MGPU_ERROR_NONE]         = { MGPU_ERROR_NONE,         "NONE",         "No error",                false },
+    [MGPU_ERROR_INVALID_CMD]  = { MGPU_ERROR_INVALID_CMD,  "INVALID_CMD",  "Invalid command",         true  },
+    [MGPU_ERROR_MEM_FAULT]    = { MGPU_ERROR_MEM_FAULT,    "MEM_FAULT",    "Memory access fault",     true  },
+    [MGPU_ERROR_SHADER_FAULT] = { MGPU_ERROR_SHADER_FAULT, "SHADER_FAULT", "Shader execution fault",  true  },
+    [MGPU_ERROR_TIMEOUT]      = { MGPU_ERROR_TIMEOUT,      "TIMEOUT",      "Operation timeout",       true  },
+    [MGPU_ERROR_OVERFLOW]     = { MGPU_ERROR_OVERFLOW,     "OVERFLOW",     "Queue overflow",          true  },
 };
 
-/* Get error description */
+/* Get error description: direct index, one bounds check; unknown
+ * codes map to "NONE" as before */
 static const struct mgpu_error_info *mgpu_get_error_info(u32 error_code)
 {
-    int i;
-    
-    for (i = 0; i < ARRAY_SIZE(mgpu_error_table); i++) {
-        if (mgpu_error_table[i].code == error_code)
-            return &mgpu_error_table[i];
-    }
-    
-    return &mgpu_error_table[0]; /* Return "NONE" for unknown */
+    BUILD_BUG_ON(ARRAY_SIZE(mgpu_error_table) != MGPU_ERROR_OVERFLOW + 1);
+
+    if (error_code >= ARRAY_SIZE(mgpu_error_table))
+        return &mgpu_error_table[MGPU_ERROR_NONE];
+
+    return &mgpu_error_table[error_code];
+}
+
+/* One-shot register snapshot shared by the per-tick checks.  The
+ * hang and error checks each used to pull their inputs with separate
+ * serializing reads (STATUS twice among them); capturing everything
+ * once per tick and handing the checks a local copy cuts the
+ * non-posted reads per tick from four to two, and on
+ * MGPU_CAP_HEAD_WRITEBACK parts the command head comes from the
+ * coherent status page as a plain load instead of MMIO */
+struct mgpu_status_snapshot {
+    u32 status;
+    u32 cmd_head;
+    u32 fence_value;
+};
+
+static void mgpu_health_snapshot(struct mgpu_device *mdev,
+                                 struct mgpu_status_snapshot *snap)
+{
+    /* Pure sampling; nothing downstream orders against these, so
+     * skip the per-access barrier the strong accessors imply */
+    snap->status = mgpu_read_relaxed(mdev, MGPU_REG_STATUS);
+    if (mdev->status_page)
+        snap->cmd_head = READ_ONCE(mdev->status_page[0]);
+    else
+        snap->cmd_head = mgpu_read_relaxed(mdev, MGPU_REG_CMD_HEAD);
+    snap->fence_value = mgpu_fence_current(mdev);
 }
 
-/* Check GPU heartbeat */
+/* Check GPU heartbeat.  The scratch write is posted and effectively
+ * free; the readback is a serializing bus round trip and dominates
+ * the cost of the whole health tick.  Any interrupt batch serviced
+ * since the last tick already proves the device is responding, so
+ * the readback only runs when the device has been interrupt-silent
+ * for a full interval */
 static bool mgpu_health_check_heartbeat(struct mgpu_health_monitor *monitor)
 {
     struct mgpu_device *mdev = monitor->mdev;
-    u32 scratch;
+    u32 scratch, irq_count;
     bool alive = true;
-    
-    /* Write heartbeat value to scratch register */
+
+    /* Write heartbeat value to scratch register; relaxed, the
+     * scratch word orders against nothing */
     monitor->heartbeat_counter++;
-    mgpu_write(mdev, MGPU_REG_SCRATCH, monitor->heartbeat_counter);
-    
-    /* Read back and verify */
-    scratch = mgpu_read(mdev, MGPU_REG_SCRATCH);
+    mgpu_write_relaxed(mdev, MGPU_REG_SCRATCH, monitor->heartbeat_counter);
+
+    /* Interrupt activity since the last tick: alive, skip the
+     * readback */
+    irq_count = atomic_read(&mdev->irq_count);
+    if (irq_count != monitor->last_irq_count) {
+        monitor->last_irq_count = irq_count;
+        monitor->last_heartbeat = jiffies;
+        return true;
+    }
+
+    /* Read back and verify.  The MMIO bus itself keeps the readback
+     * behind the write; no CPU barrier needed */
+    scratch = mgpu_read_relaxed(mdev, MGPU_REG_SCRATCH);
     if (scratch != monitor->heartbeat_counter) {
         dev_err(mdev->dev, "Heartbeat failed: wrote 0x%08x, read 0x%08x\n",
                 monitor->heartbeat_counter, scratch);
@@ -122,98 +163,98 @@ static bool mgpu_health_check_heartbeat(struct mgpu_health_monitor *monitor)
 }
 
 /* Check for GPU hang */
-static bool mgpu_health_check_hang(struct mgpu_health_monitor *monitor)
+static bool mgpu_health_check_hang(struct mgpu_health_monitor *monitor,
+                                   const struct mgpu_status_snapshot *snap)
 {
     struct mgpu_device *mdev = monitor->mdev;
-    u32 status, cmd_head, fence_value;
     bool hung = false;
-    
-    status = mgpu_read(mdev, MGPU_REG_STATUS);
-    
+
     /* Check if GPU claims to be busy */
-    if (!(status & MGPU_STATUS_BUSY))
+    if (!(snap->status & MGPU_STATUS_BUSY))
         return false;
-    
+
     /* Check command progress */
-    cmd_head = mgpu_read(mdev, MGPU_REG_CMD_HEAD);
-    if (cmd_head == monitor->last_cmd_head) {
+    if (snap->cmd_head == monitor->last_cmd_head) {
         /* No progress in command processing */
         if (time_after(jiffies, 
                       monitor->last_activity + msecs_to_jiffies(MGPU_HEARTBEAT_TIMEOUT_MS))) {
             dev_warn(mdev->dev, "GPU hang detected: command head stuck at %u\n",
-                     cmd_head);
+                     snap->cmd_head);
             hung = true;
         }
     } else {
-        monitor->last_cmd_head = cmd_head;
+        monitor->last_cmd_head = snap->cmd_head;
         monitor->last_activity = jiffies;
     }
-    
+
     /* Check fence progress */
-    fence_value = mgpu_read(mdev, MGPU_REG_FENCE_VALUE);
-    if (fence_value == monitor->last_fence_value) {
+    if (snap->fence_value == monitor->last_fence_value) {
         /* No fence progress */
         if (time_after(jiffies,
                       monitor->last_activity + msecs_to_jiffies(MGPU_HEARTBEAT_TIMEOUT_MS))) {
             dev_warn(mdev->dev, "GPU hang detected: fence stuck at %u\n",
-                     fence_value);
+                     snap->fence_value);
             hung = true;
         }
     } else {
-        monitor->last_fence_value = fence_value;
+        monitor->last_fence_value = snap->fence_value;
         monitor->last_activity = jiffies;
     }
     
     if (hung) {
         monitor->stats.hang_count++;
-        monitor->stats.last_hang = ktime_get();
+        monitor->stats.last_hang = jiffies;
     }
     
     return hung;
 }
 
 /* Check for GPU errors */
-static int mgpu_health_check_errors(struct mgpu_health_monitor *monitor)
+static int mgpu_health_check_errors(struct mgpu_health_monitor *monitor,
+                                    const struct mgpu_status_snapshot *snap)
 {
     struct mgpu_device *mdev = monitor->mdev;
-    u32 status;
+    u32 status = snap->status;
     int error_count = 0;
-    
-    status = mgpu_read(mdev, MGPU_REG_STATUS);
-    
-    /* Check error bit */
-    if (status & MGPU_STATUS_ERROR) {
+
+    /* Check error bit; a healthy GPU takes none of the branches
+     * below, so keep the reporting code out of the straight path */
+    if (unlikely(status & MGPU_STATUS_ERROR)) {
         const struct mgpu_error_info *info;
         u32 error_code = (status >> 16) & 0xFF; /* Assuming error code in upper bits */
         
         info = mgpu_get_error_info(error_code);
-        dev_err(mdev->dev, "GPU error detected: %s - %s\n",
-                info->name, info->description);
+        /* Ratelimited: a storming recoverable error (bad command
+         * replayed by userspace) must not turn every tick into a
+         * logbuf-lock fight */
+        dev_err_ratelimited(mdev->dev, "GPU error detected: %s - %s\n",
+                            info->name, info->description);
         
         monitor->stats.error_count++;
-        monitor->stats.last_error = ktime_get();
+        monitor->stats.last_error = jiffies;
         monitor->consecutive_errors++;
         error_count++;
         
-        /* Clear error if recoverable */
-        if (info->recoverable) {
-            /* Clear error status */
-            mgpu_write(mdev, MGPU_REG_STATUS, status & ~MGPU_STATUS_ERROR);
-        }
+        /* Clear error if recoverable.  Write-1-to-clear: writing
+         * just the ERROR bit drops it without the old RMW writeback,
+         * which could stomp a HALTED/CMD_FULL bit the hardware set
+         * between our read and the write */
+        if (info->recoverable)
+            mgpu_write(mdev, MGPU_REG_STATUS, MGPU_STATUS_ERROR);
     } else {
         /* Reset consecutive error counter if no error */
         monitor->consecutive_errors = 0;
     }
     
     /* Check if halted */
-    if (status & MGPU_STATUS_HALTED) {
-        dev_err(mdev->dev, "GPU halted\n");
+    if (unlikely(status & MGPU_STATUS_HALTED)) {
+        dev_err_ratelimited(mdev->dev, "GPU halted\n");
         error_count++;
     }
     
     /* Check command queue status */
-    if (status & MGPU_STATUS_CMD_FULL) {
-        dev_warn(mdev->dev, "Command queue full\n");
+    if (unlikely(status & MGPU_STATUS_CMD_FULL)) {
+        dev_warn_ratelimited(mdev->dev, "Command queue full\n");
         /* Not necessarily an error, but worth noting */
     }
     
@@ -224,21 +265,30 @@ static int mgpu_health_check_errors(struct mgpu_health_monitor *monitor)
 static void mgpu_health_check(struct mgpu_health_monitor *monitor)
 {
     struct mgpu_device *mdev = monitor->mdev;
+    struct mgpu_status_snapshot snap;
     bool needs_reset = false;
     int error_count;
-    
+
+    /* The tick usually lands on a cold CPU; pull both monitor lines
+     * in for write while the first MMIO read is in flight */
+    prefetchw(&monitor->consecutive_errors);
+    prefetchw(&monitor->stats);
+
     monitor->stats.check_count++;
-    monitor->stats.last_check = ktime_get();
-    
+    monitor->stats.last_check = jiffies;
+
     /* Check heartbeat */
     if (!mgpu_health_check_heartbeat(monitor)) {
         dev_err(mdev->dev, "GPU heartbeat check failed\n");
         needs_reset = true;
     }
-    
+
+    /* One snapshot feeds both remaining checks */
+    mgpu_health_snapshot(mdev, &snap);
+
     /* Check for errors */
-    error_count = mgpu_health_check_errors(monitor);
-    if (error_count > 0) {
+    error_count = mgpu_health_check_errors(monitor, &snap);
+    if (unlikely(error_count > 0)) {
         dev_warn(mdev->dev, "Health check found %d errors\n", error_count);
         
         /* Too many consecutive errors? */
@@ -250,7 +300,7 @@ static void mgpu_health_check(struct mgpu_health_monitor *monitor)
     }
     
     /* Check for hang */
-    if (mgpu_health_check_hang(monitor)) {
+    if (mgpu_health_check_hang(monitor, &snap)) {
         dev_err(mdev->dev, "GPU hang detected\n");
         needs_reset = true;
     }
@@ -263,75 +313,37 @@ static void mgpu_health_check(struct mgpu_health_monitor *monitor)
     }
 }
 
-/* Health check work function */
+/* Periodic check, sole owner of the cadence.  Runs on
+ * system_power_efficient_wq: a dedicated kthread (or the default
+ * per-CPU system_wq) would wake whichever CPU its timer expired on,
+ * defeating tickless idle for housekeeping that has no latency
+ * requirement at all */
 static void mgpu_health_work_func(struct work_struct *work)
 {
     struct mgpu_health_monitor *monitor =
         container_of(work, struct mgpu_health_monitor, health_work.work);
-    
+    struct mgpu_device *mdev = monitor->mdev;
+
     if (!monitor->monitoring_enabled)
         return;
-    
+
+    /* Perform detailed health check */
     mgpu_health_check(monitor);
-    
-    /* Schedule next check */
-    schedule_delayed_work(&monitor->health_work,
-                         msecs_to_jiffies(MGPU_HEALTH_CHECK_INTERVAL_MS));
-}
 
-/* Hang check work function */
-static void mgpu_hang_check_work_func(struct work_struct *work)
-{
-    struct mgpu_health_monitor *monitor =
-        container_of(work, struct mgpu_health_monitor, hang_check_work.work);
-    
-    if (!monitor->monitoring_enabled)
-        return;
-    
-    if (mgpu_health_check_hang(monitor)) {
-        dev_err(monitor->mdev->dev, "Hang check detected GPU hang\n");
-        mgpu_reset_schedule(monitor->mdev);
+    /* Log statistics periodically: countdown instead of a modulo,
+     * which is a libgcc divmod call on 32-bit targets */
+    if (--monitor->log_ticks_remaining == 0) { /* Every minute */
+        monitor->log_ticks_remaining = 60;
+        dev_dbg(mdev->dev,
+                "Health stats: checks=%lu, errors=%lu, hangs=%lu, recoveries=%lu\n",
+                monitor->stats.check_count,
+                monitor->stats.error_count,
+                monitor->stats.hang_count,
+                monitor->stats.recovery_count);
     }
-    
-    /* Schedule next check */
-    schedule_delayed_work(&monitor->hang_check_work,
-                         msecs_to_jiffies(MGPU_HANG_CHECK_INTERVAL_MS));
-}
 
-/* Monitoring thread */
-static int mgpu_monitor_thread(void *data)
-{
-    struct mgpu_health_monitor *monitor = data;
-    struct mgpu_device *mdev = monitor->mdev;
-    
-    dev_info(mdev->dev, "Health monitor thread started\n");
-    
-    while (!kthread_should_stop()) {
-        if (monitor->monitoring_enabled) {
-            /* Perform detailed health check */
-            mgpu_health_check(monitor);
-            
-            /* Check temperature if available */
-            /* TODO: Read temperature from thermal sensor if present */
-            
-            /* Log statistics periodically */
-            if (monitor->stats.check_count % 60 == 0) { /* Every minute */
-                dev_dbg(mdev->dev,
-                        "Health stats: checks=%lu, errors=%lu, hangs=%lu, recoveries=%lu\n",
-                        monitor->stats.check_count,
-                        monitor->stats.error_count,
-                        monitor->stats.hang_count,
-                        monitor->stats.recovery_count);
-            }
-        }
-        
-        /* Sleep for check interval */
-        msleep(MGPU_HEALTH_CHECK_INTERVAL_MS);
-    }
-    
-    dev_info(mdev->dev, "Health monitor thread stopped\n");
-    
-    return 0;
+    queue_delayed_work(system_power_efficient_wq, &monitor->health_work,
+                       msecs_to_jiffies(MGPU_HEALTH_CHECK_INTERVAL_MS));
 }
 
 /* Initialize health monitoring */
@@ -344,33 +356,20 @@ int mgpu_health_init(struct mgpu_device *mdev)
         return -ENOMEM;
     
     monitor->mdev = mdev;
-    monitor->stats.uptime_start = ktime_get();
+    monitor->stats.uptime_start = jiffies;
     monitor->last_activity = jiffies;
-    
-    /* Initialize work queues */
+    monitor->log_ticks_remaining = 60;
+
     INIT_DELAYED_WORK(&monitor->health_work, mgpu_health_work_func);
-    INIT_DELAYED_WORK(&monitor->hang_check_work, mgpu_hang_check_work_func);
-    
-    /* Create monitoring thread */
-    monitor->monitor_thread = kthread_create(mgpu_monitor_thread, monitor,
-                                            "mgpu_monitor");
-    if (IS_ERR(monitor->monitor_thread)) {
-        int ret = PTR_ERR(monitor->monitor_thread);
-        kfree(monitor);
-        return ret;
-    }
-    
+
     /* Store monitor in device */
     mdev->health_monitor = monitor;
-    
+
     /* Start monitoring */
     monitor->monitoring_enabled = true;
-    wake_up_process(monitor->monitor_thread);
-    schedule_delayed_work(&monitor->health_work,
-                         msecs_to_jiffies(MGPU_HEALTH_CHECK_INTERVAL_MS));
-    schedule_delayed_work(&monitor->hang_check_work,
-                         msecs_to_jiffies(MGPU_HANG_CHECK_INTERVAL_MS));
-    
+    queue_delayed_work(system_power_efficient_wq, &monitor->health_work,
+                       msecs_to_jiffies(MGPU_HEALTH_CHECK_INTERVAL_MS));
+
     dev_info(mdev->dev, "Health monitoring initialized\n");
     
     return 0;
@@ -386,16 +385,8 @@ void mgpu_health_fini(struct mgpu_device *mdev)
     
     /* Stop monitoring */
     monitor->monitoring_enabled = false;
-    
-    /* Cancel work */
     cancel_delayed_work_sync(&monitor->health_work);
-    cancel_delayed_work_sync(&monitor->hang_check_work);
-    
-    /* Stop monitoring thread */
-    if (monitor->monitor_thread) {
-        kthread_stop(monitor->monitor_thread);
-    }
-    
+
     /* Log final statistics */
     dev_info(mdev->dev,
              "Health monitor final stats: checks=%lu, errors=%lu, hangs=%lu, recoveries=%lu\n",
@@ -430,10 +421,11 @@ int mgpu_run_selftest(struct mgpu_device *mdev)
     
     dev_info(mdev->dev, "Running GPU self-test...\n");
     
-    /* Test 1: Register read/write */
+    /* Test 1: Register read/write.  Relaxed accessors: same-device
+     * MMIO stays ordered on the bus without CPU barriers */
     for (i = 0; i < ARRAY_SIZE(test_pattern); i++) {
-        mgpu_write(mdev, MGPU_REG_SCRATCH, test_pattern[i]);
-        readback = mgpu_read(mdev, MGPU_REG_SCRATCH);
+        mgpu_write_relaxed(mdev, MGPU_REG_SCRATCH, test_pattern[i]);
+        readback = mgpu_read_relaxed(mdev, MGPU_REG_SCRATCH);
         if (readback != test_pattern[i]) {
             dev_err(mdev->dev,
                     "Self-test failed: register test pattern %d (wrote 0x%08x, read 0x%08x)\n",
@@ -443,7 +435,7 @@ int mgpu_run_selftest(struct mgpu_device *mdev)
     }
     
     /* Test 2: Verify version register */
-    readback = mgpu_read(mdev, MGPU_REG_VERSION);
+    readback = mgpu_read_relaxed(mdev, MGPU_REG_VERSION);
     if (readback == 0 || readback == 0xFFFFFFFF) {
         dev_err(mdev->dev,
                 "Self-test failed: invalid version register (0x%08x)\n",
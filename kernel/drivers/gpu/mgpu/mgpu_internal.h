@@ -8,7 +8,10 @@
 #include <linux/kref.h>
 #include <linux/dma-mapping.h>
 
+#include "mgpu_regs.h"
+
 /* Forward declarations */
+struct sg_table;
 struct mgpu_device;
 struct mgpu_bo;
 struct mgpu_ring;
@@ -28,13 +31,26 @@ struct mgpu_device {
     u32 num_engines;
     u32 num_queues;
     
-    /* Memory management */
+    /* Memory management.  The device list is only ever walked under
+     * RCU (debugfs) or spliced at teardown, so insert/remove need a
+     * spinlock, not a mutex */
     struct list_head bo_list;
-    struct mutex bo_lock;
+    spinlock_t bo_list_lock;
+    
+    /* Aggregate BO stats, maintained on create/destroy so summary
+     * queries never walk the list */
+    atomic_t bo_count;
+    atomic64_t bo_total_bytes;
     
-    /* Command submission */
-    struct mgpu_ring *cmd_ring;
-    spinlock_t cmd_lock;
+    /* Command submission: one ring per hardware queue, each with its own
+     * lock so queues do not contend. All rings are created at probe */
+    struct mgpu_ring *rings[MGPU_MAX_QUEUES];
+
+    /* Head write-back page: hardware mirrors each queue's CMD_HEAD
+     * into status_page[queue_id] (MGPU_CAP_HEAD_WRITEBACK), turning
+     * ring-space checks into cached loads */
+    u32 *status_page;
+    dma_addr_t status_page_dma;
     
     /* Fence context */
     struct mgpu_fence_context *fence_ctx;
@@ -42,13 +58,39 @@ struct mgpu_device {
     /* Shader manager */
     struct mgpu_shader_mgr *shader_mgr;
     
-    /* Interrupt handling */
-    struct tasklet_struct irq_tasklet;
-    u32 irq_status;
-    
+    /* Interrupt handling: bits the hard handler has accumulated but
+     * the IRQ thread has not yet consumed, plus a running count of
+     * serviced batches that the health monitor uses as a free
+     * liveness witness */
+    atomic_t irq_pending;
+    atomic_t irq_count;
+
+    /* Shadow of MGPU_REG_IRQ_ENABLE: re-enables with an unchanged
+     * mask skip the MMIO write.  irq_mask_lock serializes the shadow
+     * and the enabled intent; irqs_enabled gates the IRQ thread's
+     * tail unmask so it cannot undo a concurrent suspend/teardown
+     * disable */
+    spinlock_t irq_mask_lock;
+    u32 last_irq_mask;
+    bool irqs_enabled;
+
+    /* Hang detection: fence value observed by the previous
+     * mgpu_reset_needed() call.  Per-device so health checks on one
+     * GPU cannot mask a hang on another */
+    u32 last_seen_fence;
+
     /* Debug */
     struct dentry *debugfs_root;
-    
+
+    /* Deferred coredump capture (mgpu_coredump.c) */
+    struct work_struct coredump_work;
+    char coredump_reason[64];
+    void *coredump_scratch;        /* Instr-mem DMA landing buffer */
+    dma_addr_t coredump_scratch_dma;
+    void *coredump_buf;            /* Persistent dump assembly buffer */
+    size_t coredump_buf_size;
+    atomic_t coredump_buf_busy;
+
     /* Character device */
     struct cdev cdev;
     dev_t devno;
@@ -74,11 +116,19 @@ int mgpu_bo_mmap(struct mgpu_device *mdev, struct mgpu_bo_mmap *args,
 int mgpu_mmap(struct file *filp, struct vm_area_struct *vma);
 struct mgpu_bo *mgpu_bo_lookup(struct mgpu_device *mdev, u32 handle);
 struct mgpu_bo *mgpu_bo_lookup_by_offset(u64 offset);
+/* Refcount-free field read; use when the BO need not outlive the call */
+int mgpu_bo_query(struct mgpu_device *mdev, u32 handle, dma_addr_t *dma_addr,
+                  size_t *size, u32 *flags);
 void mgpu_bo_put(struct mgpu_bo *bo);
 void *mgpu_bo_vmap(struct mgpu_bo *bo);
 void mgpu_bo_vunmap(struct mgpu_bo *bo, void *vaddr);
 int mgpu_bo_cpu_prep(struct mgpu_bo *bo, bool write);
 int mgpu_bo_cpu_fini(struct mgpu_bo *bo, bool write);
+/* Ranged variants: sync only the touched slice of a cached BO */
+int mgpu_bo_cpu_prep_range(struct mgpu_bo *bo, u64 offset, u64 length,
+                           bool write);
+int mgpu_bo_cpu_fini_range(struct mgpu_bo *bo, u64 offset, u64 length,
+                           bool write);
 void mgpu_gem_cleanup(struct mgpu_device *mdev);
 
 /* DMA helpers (mgpu_dma.c) */
@@ -90,29 +140,86 @@ void *mgpu_dma_alloc(struct mgpu_device *mdev, size_t size,
 void mgpu_dma_free(struct mgpu_device *mdev, size_t size,
                    void *vaddr, dma_addr_t dma_addr,
                    unsigned long attrs);
+void *mgpu_dma_alloc_wc(struct mgpu_device *mdev, size_t size,
+                        dma_addr_t *dma_addr, gfp_t gfp);
+void mgpu_dma_free_wc(struct mgpu_device *mdev, size_t size,
+                      void *vaddr, dma_addr_t dma_addr);
+u32 mgpu_dma_fill_cmd(struct mgpu_device *mdev, struct mgpu_cmd_dma *cmd,
+                      dma_addr_t src, dma_addr_t dst, u32 size);
+dma_addr_t mgpu_dma_map_peer(struct mgpu_device *mdev, phys_addr_t phys,
+                             size_t size, enum dma_data_direction dir);
+void mgpu_dma_unmap_peer(struct mgpu_device *mdev, dma_addr_t addr,
+                         size_t size, enum dma_data_direction dir);
 void mgpu_dma_sync_for_cpu(struct mgpu_device *mdev, dma_addr_t dma_addr,
                            size_t size, enum dma_data_direction dir);
 void mgpu_dma_sync_for_device(struct mgpu_device *mdev, dma_addr_t dma_addr,
                               size_t size, enum dma_data_direction dir);
+void mgpu_dma_sync_sgt_for_cpu(struct mgpu_device *mdev,
+                               struct sg_table *sgt, dma_addr_t dma_addr,
+                               size_t size, enum dma_data_direction dir);
+void mgpu_dma_sync_sgt_for_device(struct mgpu_device *mdev,
+                                  struct sg_table *sgt, dma_addr_t dma_addr,
+                                  size_t size, enum dma_data_direction dir);
+/* Defer the doorbell; pair with mgpu_dma_flush() */
+#define MGPU_DMA_NO_KICK    (1 << 0)
+/* src/dst are peer-device addresses from mgpu_dma_map_peer(); refuse
+ * rather than truncate them on 32-bit-only configurations */
+#define MGPU_DMA_P2P        (1 << 1)
+
 int mgpu_dma_copy(struct mgpu_device *mdev, dma_addr_t src, dma_addr_t dst,
-                  u32 size, bool wait);
+                  u32 size, u32 flags, bool wait);
+int mgpu_dma_copy_queue(struct mgpu_device *mdev, dma_addr_t src,
+                        dma_addr_t dst, u32 size);
+int mgpu_dma_flush(struct mgpu_device *mdev);
+
+/* One copy in a batched submission (mgpu_dma_copy_sg) */
+struct mgpu_dma_sg_entry {
+    dma_addr_t src;
+    dma_addr_t dst;
+    u32 size;
+};
+
+int mgpu_dma_copy_sg(struct mgpu_device *mdev,
+                     const struct mgpu_dma_sg_entry *entries, u32 n,
+                     bool wait);
 
 /* Command Queue (mgpu_cmdq.c) */
 
 /* Ring buffer functions */
 struct mgpu_ring *mgpu_ring_create(struct mgpu_device *mdev, size_t size, u32 queue_id);
 void mgpu_ring_destroy(struct mgpu_ring *ring);
+u64 mgpu_ring_submitted(struct mgpu_ring *ring);
+u64 mgpu_ring_completed(struct mgpu_ring *ring);
+u32 mgpu_ring_cached_head(struct mgpu_ring *ring);
+u32 mgpu_ring_tail(struct mgpu_ring *ring);
+int mgpu_ring_submit_internal(struct mgpu_ring *ring, const u32 *cmd,
+                              u32 dwords);
+int mgpu_ring_submit_internal_nokick(struct mgpu_ring *ring, const u32 *cmd,
+                                     u32 dwords);
+void mgpu_ring_flush(struct mgpu_ring *ring);
 int mgpu_submit_commands(struct mgpu_device *mdev, struct mgpu_submit *args);
 int mgpu_cmdq_init(struct mgpu_device *mdev);
 void mgpu_cmdq_fini(struct mgpu_device *mdev);
 
 /* Fence Management (mgpu_fence.c) */
 
+/* Signal predicate on raw values, shared by the fence paths and the
+ * unit tests.  Signed difference instead of >= so the comparison
+ * stays correct across seqno wrap: a fence is signalled when the
+ * seen value is at most 2^31-1 steps past the target */
+static __always_inline bool mgpu_fence_value_passed(u32 seen, u32 target)
+{
+    return (s32)(seen - target) >= 0;
+}
+
 /* Fence functions */
 int mgpu_fence_init(struct mgpu_device *mdev);
 void mgpu_fence_fini(struct mgpu_device *mdev);
+int mgpu_fence_mmap(struct mgpu_device *mdev, struct vm_area_struct *vma);
 u32 mgpu_fence_next(struct mgpu_device *mdev);
+u32 mgpu_fence_current(struct mgpu_device *mdev);
 bool mgpu_fence_signaled(struct mgpu_device *mdev, u64 fence_addr, u32 fence_value);
+bool mgpu_fence_slot_signaled(struct mgpu_device *mdev, u32 slot, u32 fence_value);
 void mgpu_fence_process(struct mgpu_device *mdev);
 int mgpu_wait_fence(struct mgpu_device *mdev, struct mgpu_wait_fence *args);
 int mgpu_fence_emit(struct mgpu_device *mdev, u64 fence_addr, u32 fence_value);
@@ -127,6 +234,19 @@ int mgpu_shader_bind(struct mgpu_device *mdev, u32 slot, u32 type);
 int mgpu_shader_get_info(struct mgpu_device *mdev, u32 slot,
                         size_t *size, u32 *type);
 
+#define MGPU_MAX_SHADER_SLOTS 16
+
+/* Compact per-slot view handed to the coredump code so it does not
+ * need the shader manager internals */
+struct mgpu_shader_slot_snap {
+    u32 type;
+    u32 size;
+    bool loaded;
+};
+
+u32 mgpu_shader_snapshot(struct mgpu_device *mdev,
+                         struct mgpu_shader_slot_snap *snap, u32 num);
+
 /* Reset and Recovery (mgpu_reset.c) */
 
 /* Reset functions */
@@ -134,10 +254,17 @@ int mgpu_reset_hw(struct mgpu_device *mdev);
 int mgpu_reset_engine(struct mgpu_device *mdev, u32 engine);
 void mgpu_reset_on_error(struct mgpu_device *mdev);
 
+/* Pipeline Management (mgpu_pipeline.c) */
+
+/* Called from the IRQ thread on completion-class interrupts so the
+ * pipeline stage waits can sleep on a completion instead of polling
+ * STATUS */
+void mgpu_pipeline_irq_notify(struct mgpu_device *mdev);
+
 /* Health Monitoring (mgpu_health.c) */
 
 /* Health check functions */
-int mgpu_health_check(struct mgpu_device *mdev);
+int mgpu_health_check_now(struct mgpu_device *mdev);
 int mgpu_run_selftest(struct mgpu_device *mdev);
 void mgpu_dump_state(struct mgpu_device *mdev);
 
@@ -149,17 +276,46 @@ void mgpu_debugfs_fini(struct mgpu_device *mdev);
 
 /* Helper Macros */
 
-/* Register access helpers */
-static inline u32 mgpu_read(struct mgpu_device *mdev, u32 offset)
+/* Register access helpers.  __always_inline: these are one
+ * instruction plus barrier, and an out-of-line copy (possible under
+ * -Og or aggressive size tuning) would cost more than the access */
+static __always_inline u32 mgpu_read(struct mgpu_device *mdev, u32 offset)
 {
     return ioread32(mdev->mmio_base + offset);
 }
 
-static inline void mgpu_write(struct mgpu_device *mdev, u32 offset, u32 value)
+static __always_inline void mgpu_write(struct mgpu_device *mdev, u32 offset,
+                                       u32 value)
 {
     iowrite32(value, mdev->mmio_base + offset);
 }
 
+/* Relaxed variants skip the full DMB that readl/writel imply. Use them
+ * where ordering against prior memory accesses is already guaranteed
+ * (IRQ handlers, back-to-back register polls); keep the ordered
+ * versions on submission paths that must drain CPU writes first. */
+static __always_inline u32 mgpu_read_relaxed(struct mgpu_device *mdev,
+                                             u32 offset)
+{
+    return readl_relaxed(mdev->mmio_base + offset);
+}
+
+static __always_inline void mgpu_write_relaxed(struct mgpu_device *mdev,
+                                               u32 offset, u32 value)
+{
+    writel_relaxed(value, mdev->mmio_base + offset);
+}
+
+/* Burst a run of contiguous registers as relaxed back-to-back stores.
+ * No barrier: same-peripheral writes arrive in program order, and the
+ * ordered write (or explicit wmb()) that eventually consumes the
+ * values supplies the ordering against normal memory */
+static inline void mgpu_write_burst(struct mgpu_device *mdev, u32 offset,
+                                    const u32 *vals, unsigned int count)
+{
+    __iowrite32_copy(mdev->mmio_base + offset, vals, count);
+}
+
 /* Logging helpers */
 #define mgpu_err(mdev, fmt, ...) \
     dev_err((mdev)->dev, fmt, ##__VA_ARGS__)
@@ -1,12 +1,21 @@
 #include <linux/module.h>
 #include <linux/interrupt.h>
+#include <linux/prefetch.h>
 #include <linux/spinlock.h>
 
 #include "mgpu_drm.h"
 #include "mgpu_regs.h"
 #include "mgpu_internal.h"
 
-/* IRQ handler - top half */
+static void __mgpu_irq_write_mask(struct mgpu_device *mdev);
+
+/* IRQ handler - hard half.  Just read, mask and accumulate; the real
+ * work (including the ack) runs in the IRQ thread, which can sleep,
+ * be pinned and be prioritized, unlike the tasklet this replaced.
+ * atomic_or means a second interrupt arriving before the thread runs
+ * merges its bits instead of racing an unlocked read-modify-write.
+ * With the device masked, a burst of completions costs one ack from
+ * the thread rather than one per interrupt with IRQs disabled */
 static irqreturn_t mgpu_irq_handler(int irq, void *arg)
 {
     struct mgpu_device *mdev = arg;
@@ -19,31 +28,28 @@ static irqreturn_t mgpu_irq_handler(int irq, void *arg)
     if (!status)
         return IRQ_NONE;
     
-    /* Acknowledge interrupts immediately */
-    mgpu_write(mdev, MGPU_REG_IRQ_ACK, status);
+    /* Mask the device until the thread has drained it; this is the
+     * only MMIO write the hard half does.  The shadow is updated
+     * under the mask lock like every other writer; irqs_enabled is
+     * left set since the thread is expected to unmask again */
+    spin_lock(&mdev->irq_mask_lock);
+    mgpu_write(mdev, MGPU_REG_IRQ_ENABLE, 0);
+    mdev->last_irq_mask = 0;
+    spin_unlock(&mdev->irq_mask_lock);
     
-    /* Save status for bottom half */
-    mdev->irq_status |= status;
+    /* Warm the fence context for the thread while the mask write is
+     * still in flight */
+    prefetch(mdev->fence_ctx);
     
-    /* Schedule tasklet for bottom half processing */
-    tasklet_schedule(&mdev->irq_tasklet);
+    /* Accumulate for the thread */
+    atomic_or(status, &mdev->irq_pending);
     
-    return IRQ_HANDLED;
+    return IRQ_WAKE_THREAD;
 }
 
-/* IRQ tasklet - bottom half */
-static void mgpu_irq_tasklet_func(unsigned long data)
+/* Dispatch one batch of accumulated IRQ bits */
+static void mgpu_irq_process(struct mgpu_device *mdev, u32 status)
 {
-    struct mgpu_device *mdev = (struct mgpu_device *)data;
-    u32 status;
-    unsigned long flags;
-    
-    /* Get and clear saved status */
-    spin_lock_irqsave(&mdev->irq_lock, flags);
-    status = mdev->irq_status;
-    mdev->irq_status = 0;
-    spin_unlock_irqrestore(&mdev->irq_lock, flags);
-    
     /* Process each interrupt type */
     if (status & MGPU_IRQ_CMD_COMPLETE) {
         dev_dbg(mdev->dev, "Command complete IRQ\n");
@@ -75,6 +81,63 @@ static void mgpu_irq_tasklet_func(unsigned long data)
         dev_dbg(mdev->dev, "Performance counter IRQ\n");
         mgpu_pm_handle_perf_irq(mdev);
     }
+
+    /* Completion-class interrupts may end a pipeline stage wait; let
+     * the pipeline manager classify via one STATUS read */
+    if (status & (MGPU_IRQ_CMD_COMPLETE | MGPU_IRQ_QUEUE_EMPTY))
+        mgpu_pipeline_irq_notify(mdev);
+}
+
+/* IRQ handler - threaded half.  Drain, ack and re-poll until the
+ * device shows no further status, then unmask.  Completions that
+ * arrive while we are processing are picked up by the re-poll
+ * instead of raising a fresh interrupt */
+static irqreturn_t mgpu_irq_thread(int irq, void *arg)
+{
+    struct mgpu_device *mdev = arg;
+    u32 status, handled = 0;
+
+    for (;;) {
+        /* One xchg drains everything accumulated since the last
+         * pass: a burst of interrupts becomes a single batch */
+        status = atomic_xchg(&mdev->irq_pending, 0);
+        if (!status)
+            break;
+
+        /* Liveness witness for the health heartbeat: one increment
+         * per batch keeps it off the hard-IRQ path */
+        atomic_inc(&mdev->irq_count);
+
+        /* Autoclear hardware already dropped the bits when the hard
+         * half read STATUS; only legacy parts need the ack write */
+        if (!(mdev->caps & MGPU_CAP_IRQ_AUTOCLEAR))
+            mgpu_write_relaxed(mdev, MGPU_REG_IRQ_ACK, status);
+        mgpu_irq_process(mdev, status);
+        handled |= status;
+
+        /* Catch anything the device raised while masked */
+        status = mgpu_read(mdev, MGPU_REG_IRQ_STATUS);
+        if (!status)
+            break;
+        atomic_or(status, &mdev->irq_pending);
+    }
+    
+    /* Unmask now that the device reads idle - unless a suspend or
+     * teardown disabled interrupts while this batch was draining;
+     * re-checking the intent under the mask lock keeps the device
+     * masked across synchronize_irq()/free_irq() */
+    spin_lock_irq(&mdev->irq_mask_lock);
+    if (mdev->irqs_enabled)
+        __mgpu_irq_write_mask(mdev);
+    spin_unlock_irq(&mdev->irq_mask_lock);
+
+    /* Publish the batch for mgpu_irq_wait() and wake its sleepers */
+    if (handled) {
+        WRITE_ONCE(mdev->last_irq, mdev->last_irq | handled);
+        wake_up_all(&mdev->fence_wait);
+    }
+
+    return IRQ_HANDLED;
 }
 
 /* Initialize IRQ subsystem */
@@ -85,20 +148,19 @@ int mgpu_irq_init(struct mgpu_device *mdev)
     dev_info(mdev->dev, "Initializing IRQ subsystem\n");
     
     /* Initialize IRQ state */
-    spin_lock_init(&mdev->irq_lock);
-    mdev->irq_status = 0;
-    
-    /* Initialize tasklet */
-    tasklet_init(&mdev->irq_tasklet, mgpu_irq_tasklet_func,
-                (unsigned long)mdev);
+    atomic_set(&mdev->irq_pending, 0);
+    atomic_set(&mdev->irq_count, 0);
+    spin_lock_init(&mdev->irq_mask_lock);
+    mdev->last_irq_mask = 0;
+    mdev->irqs_enabled = false;
     
     /* Initialize wait queues */
     init_waitqueue_head(&mdev->queue_wait);
     init_waitqueue_head(&mdev->fence_wait);
     
-    /* Request IRQ */
-    ret = request_irq(mdev->irq, mgpu_irq_handler,
-                     IRQF_SHARED, "mgpu", mdev);
+    /* Request threaded IRQ */
+    ret = request_threaded_irq(mdev->irq, mgpu_irq_handler,
+                               mgpu_irq_thread, IRQF_SHARED, "mgpu", mdev);
     if (ret) {
         dev_err(mdev->dev, "Failed to request IRQ %d: %d\n", mdev->irq, ret);
         return ret;
@@ -120,44 +182,71 @@ void mgpu_irq_fini(struct mgpu_device *mdev)
     /* Disable all interrupts */
     mgpu_irq_disable(mdev);
     
-    /* Free IRQ */
+    /* Free IRQ; this also stops the handler thread */
     if (mdev->irq >= 0)
         free_irq(mdev->irq, mdev);
-    
-    /* Kill tasklet */
-    tasklet_kill(&mdev->irq_tasklet);
+}
+
+/* The enable mask only ever takes two values, both compile-time
+ * constants: the base set (plus shader halt on debug builds) and
+ * the same with the perf counter added while profiling */
+#ifdef CONFIG_MGPU_DEBUG
+#define MGPU_IRQ_MASK_DEBUG     MGPU_IRQ_SHADER_HALT
+#else
+#define MGPU_IRQ_MASK_DEBUG     0
+#endif
+
+#define MGPU_IRQ_MASK_NORMAL    (MGPU_IRQ_CMD_COMPLETE | \
+                                 MGPU_IRQ_ERROR | \
+                                 MGPU_IRQ_FENCE | \
+                                 MGPU_IRQ_QUEUE_EMPTY | \
+                                 MGPU_IRQ_MASK_DEBUG)
+#define MGPU_IRQ_MASK_PROFILING (MGPU_IRQ_MASK_NORMAL | MGPU_IRQ_PERF_COUNTER)
+
+/* Write the current enable mask; caller holds irq_mask_lock */
+static void __mgpu_irq_write_mask(struct mgpu_device *mdev)
+{
+    u32 mask = mdev->profiling_enabled ? MGPU_IRQ_MASK_PROFILING
+                                       : MGPU_IRQ_MASK_NORMAL;
+
+    /* Tracked register: the mask rarely changes, so skip the write
+     * when the hardware already holds it */
+    if (mask != mdev->last_irq_mask) {
+        mgpu_write(mdev, MGPU_REG_IRQ_ENABLE, mask);
+        mdev->last_irq_mask = mask;
+    }
 }
 
 /* Enable interrupts */
 void mgpu_irq_enable(struct mgpu_device *mdev)
 {
-    u32 mask = MGPU_IRQ_CMD_COMPLETE |
-               MGPU_IRQ_ERROR |
-               MGPU_IRQ_FENCE |
-               MGPU_IRQ_QUEUE_EMPTY;
-    
-    /* Enable shader halt IRQ only if debugging */
-#ifdef CONFIG_MGPU_DEBUG
-    mask |= MGPU_IRQ_SHADER_HALT;
-#endif
-    
-    /* Enable performance counter IRQ if profiling */
-    if (mdev->profiling_enabled)
-        mask |= MGPU_IRQ_PERF_COUNTER;
-    
-    mgpu_write(mdev, MGPU_REG_IRQ_ENABLE, mask);
-    
-    dev_dbg(mdev->dev, "Enabled IRQs: 0x%08x\n", mask);
+    unsigned long flags;
+
+    spin_lock_irqsave(&mdev->irq_mask_lock, flags);
+    mdev->irqs_enabled = true;
+    __mgpu_irq_write_mask(mdev);
+    spin_unlock_irqrestore(&mdev->irq_mask_lock, flags);
+
+    dev_dbg(mdev->dev, "Enabled IRQs: 0x%08x\n", mdev->last_irq_mask);
 }
 
 /* Disable interrupts */
 void mgpu_irq_disable(struct mgpu_device *mdev)
 {
-    /* Disable all interrupts */
-    mgpu_write(mdev, MGPU_REG_IRQ_ENABLE, 0);
-    
-    /* Clear any pending interrupts */
-    mgpu_write(mdev, MGPU_REG_IRQ_ACK, 0xFFFFFFFF);
+    unsigned long flags;
+
+    /* Disable all interrupts and clear anything pending as one
+     * back-to-back relaxed pair; the bus keeps them ordered, and
+     * callers that need the mask globally visible (suspend) already
+     * follow with synchronize_irq().  Clearing irqs_enabled under
+     * the lock stops an in-flight IRQ thread from unmasking again
+     * on its way out */
+    spin_lock_irqsave(&mdev->irq_mask_lock, flags);
+    mdev->irqs_enabled = false;
+    mgpu_write_relaxed(mdev, MGPU_REG_IRQ_ENABLE, 0);
+    mgpu_write_relaxed(mdev, MGPU_REG_IRQ_ACK, MGPU_IRQ_ALL);
+    mdev->last_irq_mask = 0;
+    spin_unlock_irqrestore(&mdev->irq_mask_lock, flags);
 }
 
 /* Suspend IRQ handling */
@@ -166,24 +255,19 @@ int mgpu_irq_suspend(struct mgpu_device *mdev)
     /* Disable interrupts */
     mgpu_irq_disable(mdev);
     
-    /* Synchronize IRQ */
+    /* Synchronize IRQ; waits for the threaded handler as well */
     synchronize_irq(mdev->irq);
     
-    /* Ensure tasklet is not running */
-    tasklet_disable(&mdev->irq_tasklet);
-    
     return 0;
 }
 
 /* Resume IRQ handling */
 int mgpu_irq_resume(struct mgpu_device *mdev)
 {
-    /* Clear any stale interrupts */
-    mgpu_write(mdev, MGPU_REG_IRQ_ACK, 0xFFFFFFFF);
-    mdev->irq_status = 0;
-    
-    /* Re-enable tasklet */
-    tasklet_enable(&mdev->irq_tasklet);
+    /* Clear any stale interrupts; the ordered ENABLE write in
+     * mgpu_irq_enable() below closes the sequence */
+    mgpu_write_relaxed(mdev, MGPU_REG_IRQ_ACK, MGPU_IRQ_ALL);
+    atomic_set(&mdev->irq_pending, 0);
     
     /* Re-enable interrupts */
     mgpu_irq_enable(mdev);
@@ -191,43 +275,36 @@ int mgpu_irq_resume(struct mgpu_device *mdev)
     return 0;
 }
 
-/* Force an interrupt (for testing) */
+/* Force an interrupt (for testing).  Processed synchronously in the
+ * caller's context together with anything else pending */
 void mgpu_irq_force(struct mgpu_device *mdev, u32 irq_mask)
 {
-    unsigned long flags;
-    
-    spin_lock_irqsave(&mdev->irq_lock, flags);
-    mdev->irq_status |= irq_mask;
-    spin_unlock_irqrestore(&mdev->irq_lock, flags);
+    u32 status;
     
-    tasklet_schedule(&mdev->irq_tasklet);
+    atomic_or(irq_mask, &mdev->irq_pending);
+    status = atomic_xchg(&mdev->irq_pending, 0);
+    if (status) {
+        mgpu_irq_process(mdev, status);
+        WRITE_ONCE(mdev->last_irq, mdev->last_irq | status);
+        wake_up_all(&mdev->fence_wait);
+    }
 }
 
-/* Wait for specific interrupt */
+/* Wait for specific interrupt.  A real event wait: the IRQ thread
+ * wakes us the moment the bit lands, instead of the old loop that
+ * re-polled on a 10ms schedule_timeout and added up to a full tick
+ * of latency to interrupts that had already fired */
 int mgpu_irq_wait(struct mgpu_device *mdev, u32 irq_mask, unsigned long timeout_ms)
 {
-    DEFINE_WAIT(wait);
-    unsigned long timeout = jiffies + msecs_to_jiffies(timeout_ms);
-    int ret = 0;
-    
-    while (time_before(jiffies, timeout)) {
-        prepare_to_wait(&mdev->fence_wait, &wait, TASK_INTERRUPTIBLE);
-        
-        if (mdev->last_irq & irq_mask)
-            break;
-        
-        if (signal_pending(current)) {
-            ret = -ERESTARTSYS;
-            break;
-        }
-        
-        schedule_timeout(HZ / 100);  /* 10ms */
-    }
-    
-    finish_wait(&mdev->fence_wait, &wait);
-    
-    if (ret == 0 && !(mdev->last_irq & irq_mask))
-        ret = -ETIMEDOUT;
-    
-    return ret;
+    long ret;
+
+    ret = wait_event_interruptible_timeout(mdev->fence_wait,
+                                           READ_ONCE(mdev->last_irq) & irq_mask,
+                                           msecs_to_jiffies(timeout_ms));
+    if (ret == 0)
+        return -ETIMEDOUT;
+    if (ret < 0)
+        return ret;     /* -ERESTARTSYS */
+
+    return 0;
 }
\ No newline at end of file
@@ -16,10 +16,12 @@
 #include <linux/kernel.h>
 #include <linux/slab.h>
 #include <linux/mutex.h>
-#include <linux/delay.h>
+#include <linux/spinlock.h>
 #include <linux/completion.h>
 #include <linux/workqueue.h>
 #include <linux/jiffies.h>
+#include <linux/seqlock.h>
+#include <linux/io.h>
 
 #include "mgpu_drm.h"
 #include "mgpu_regs.h"
@@ -35,45 +37,64 @@ enum mgpu_pipeline_state {
     PIPE_DONE
 };
 
-/* Pipeline stage configuration */
-struct mgpu_pipeline_stage {
+#define MGPU_PIPE_STAGES 5
+
+/* Async draw descriptor ring depth; power of two so the free-running
+ * head/tail counters mask cheaply.  A few slots suffice to keep the
+ * CPU a frame ahead of the GPU */
+#define MGPU_DRAW_RING_SLOTS 4
+
+/* Immutable per-stage metadata.  Split from the hot counters below so
+ * a counter bump touches only the counter arrays instead of dragging
+ * name pointers and control bits through the cache */
+struct mgpu_stage_desc {
     const char *name;
     u32 status_bit;
     u32 control_bit;
-    bool enabled;
-    u64 processed_items;
-    u64 stall_cycles;
-    ktime_t last_active;
 };
 
-/* Vertex fetch state (from vertex_fetch.sv) */
+static const struct mgpu_stage_desc mgpu_stage_desc[MGPU_PIPE_STAGES] = {
+    { "Vertex Fetch",    MGPU_STATUS_BUSY, MGPU_CTRL_ENABLE },
+    { "Vertex Shader",   MGPU_STATUS_BUSY, MGPU_CTRL_ENABLE },
+    { "Rasterizer",      MGPU_STATUS_BUSY, MGPU_CTRL_ENABLE },
+    { "Fragment Shader", MGPU_STATUS_BUSY, MGPU_CTRL_ENABLE },
+    { "Framebuffer",     MGPU_STATUS_BUSY, MGPU_CTRL_ENABLE },
+};
+
+/* Vertex fetch state (from vertex_fetch.sv).  Line-aligned so the
+ * fetch stage touches exactly one cache line; the fields are
+ * addresses and counts that genuinely need 32 bits */
 struct mgpu_vertex_fetch_state {
     u32 base_addr;      /* Base address of vertex buffer */
     u32 vertex_count;   /* Number of vertices to fetch */
     u32 vertex_stride;  /* Bytes per vertex (default 44 for 11 attrs * 4 bytes) */
     u32 current_vertex; /* Current vertex being fetched */
     bool fetch_active;
-};
+} ____cacheline_aligned;
 
-/* Rasterizer state (from rasterizer.sv) */
+/* Rasterizer state (from rasterizer.sv).  Repacked to fit one cache
+ * line: the per-batch counters the rasterize stage updates every
+ * pass lead the struct, and coordinates are s16 since the 640x480
+ * framebuffer bounds them well inside that range.  Single writer
+ * under state_lock, so no atomic access is needed */
 struct mgpu_rasterizer_state {
-    /* Triangle vertices */
-    s32 v0_x, v0_y;
-    s32 v1_x, v1_y;
-    s32 v2_x, v2_y;
-    
-    /* Bounding box */
-    s32 bbox_min_x, bbox_min_y;
-    s32 bbox_max_x, bbox_max_y;
-    
-    /* Current scan position */
-    s32 current_x, current_y;
-    bool raster_active;
-    
     /* Statistics */
     u32 triangles_processed;
     u32 fragments_generated;
-};
+    bool raster_active;
+
+    /* Bounding box */
+    s16 bbox_min_x, bbox_min_y;
+    s16 bbox_max_x, bbox_max_y;
+
+    /* Current scan position */
+    s16 current_x, current_y;
+
+    /* Triangle vertices */
+    s16 v0_x, v0_y;
+    s16 v1_x, v1_y;
+    s16 v2_x, v2_y;
+} ____cacheline_aligned;
 
 /* Fragment shader state (from fragment_shader.sv) */
 struct mgpu_fragment_state {
@@ -88,6 +109,7 @@ struct mgpu_shader_exec_state {
     u32 pc;             /* Program counter */
     u32 slot;           /* Active shader slot */
     u32 type;           /* Shader type (vertex/fragment/compute) */
+    bool bound;         /* Slot validated at configuration time */
     bool halted;
     u32 cycles_executed;
 };
@@ -147,79 +169,94 @@ struct mgpu_pipeline_mgr {
     /* Pipeline configuration */
     struct mgpu_pipeline_config config;
     
-    /* Stage information */
-    struct mgpu_pipeline_stage stages[5];
-    
-    /* Synchronization */
-    struct completion pipeline_complete;
+    /* Synchronization.  fetch_done/idle_done are signaled from the
+     * IRQ thread via mgpu_pipeline_irq_notify() so the stage waits
+     * sleep instead of polling STATUS */
+    struct completion fetch_done;
+    struct completion idle_done;
     wait_queue_head_t stage_wait;
     
     /* Work for async pipeline operations */
     struct work_struct pipeline_work;
     struct delayed_work monitor_work;
-    
-    /* Statistics */
+
+    /* Draw descriptor ring for the async path.  Submitters deposit
+     * descriptors and the work handler drains them one frame at a
+     * time, so the CPU prepares frame N+1 while the GPU runs frame N
+     * and a second schedule_work() while the handler runs can no
+     * longer drop a draw.  head/tail are free-running counters masked
+     * on access; full when tail - head == ring size */
+    struct mgpu_draw_call draw_ring[MGPU_DRAW_RING_SLOTS];
+    u32 draw_head;
+    u32 draw_tail;
+    spinlock_t draw_lock;
+    wait_queue_head_t draw_space;
+
+    /* Shadow of the last value written to CONTROL, so the frequent
+     * set/clear-a-bit ops pay one MMIO write instead of an uncached
+     * read-modify-write.  Seeded from the hardware at init; all
+     * pipeline-side CONTROL writes go through the shadow */
+    u32 ctrl_shadow;
+    spinlock_t ctrl_lock;
+    
+    /* Statistics.  Writers all run under state_lock; readers snapshot
+     * through stats_seq instead of taking the mutex, so debugfs/sysfs
+     * pollers never serialize against a mid-frame execute.  The block
+     * starts on its own cache line so mid-frame counter stores do not
+     * false-share with the completions and work structs above, which
+     * other CPUs touch while a frame runs */
+    seqcount_mutex_t stats_seq ____cacheline_aligned_in_smp;
     u64 frames_rendered;
     u64 total_vertices;
     u64 total_primitives;
     u64 total_fragments;
     u64 total_pixels;
-    ktime_t frame_start_time;
-    ktime_t frame_end_time;
-    
-    /* Error tracking */
+
+    /* Per-stage hot counters, structure-of-arrays (metadata lives in
+     * the const mgpu_stage_desc table) */
+    u64 stage_processed[MGPU_PIPE_STAGES];
+    u64 stage_stalls[MGPU_PIPE_STAGES];
+    bool stage_enabled[MGPU_PIPE_STAGES];
+    /* Monotonic-fast timestamps: the lock-free clock keeps frame
+     * timing off the timekeeper seqlock on the draw path */
+    u64 frame_start_ns;
+    u64 frame_end_ns;
+    
+    /* Cold tail: error bookkeeping and profiling scratch, touched
+     * only on failures or explicit queries, kept after the hot
+     * counters so frame updates never pull these lines */
     u32 pipeline_errors;
     u32 last_error_stage;
     
+    /* Raised by the execute path every 100th frame; consumed by the
+     * monitor work when it next runs */
+    bool stats_log_due;
+
     /* Performance */
     bool profiling_enabled;
     u32 perf_counters[16];
 };
 
 /* Forward declarations */
-static int mgpu_pipeline_execute_stage(struct mgpu_pipeline_mgr *mgr, 
-                                       enum mgpu_pipeline_state stage);
 static void mgpu_pipeline_work_handler(struct work_struct *work);
 static void mgpu_pipeline_monitor_work(struct work_struct *work);
-
-/* Initialize pipeline stages */
-static void mgpu_pipeline_init_stages(struct mgpu_pipeline_mgr *mgr)
+static int mgpu_pipeline_draw_configure(struct mgpu_pipeline_mgr *mgr,
+                                        const struct mgpu_draw_call *draw);
+static int mgpu_pipeline_draw_kick(struct mgpu_pipeline_mgr *mgr);
+static int mgpu_pipeline_run_draw(struct mgpu_pipeline_mgr *mgr,
+                                  const struct mgpu_draw_call *draw);
+
+/* Set and clear CONTROL bits through the shadow: one ordered MMIO
+ * write per update, no readback */
+static void mgpu_pipeline_ctrl_update(struct mgpu_pipeline_mgr *mgr,
+                                      u32 set, u32 clear)
 {
-    /* Initialize stage descriptors */
-    mgr->stages[0] = (struct mgpu_pipeline_stage){
-        .name = "Vertex Fetch",
-        .status_bit = MGPU_STATUS_BUSY,
-        .control_bit = MGPU_CTRL_ENABLE,
-        .enabled = true,
-    };
-    
-    mgr->stages[1] = (struct mgpu_pipeline_stage){
-        .name = "Vertex Shader",
-        .status_bit = MGPU_STATUS_BUSY,
-        .control_bit = MGPU_CTRL_ENABLE,
-        .enabled = true,
-    };
-    
-    mgr->stages[2] = (struct mgpu_pipeline_stage){
-        .name = "Rasterizer",
-        .status_bit = MGPU_STATUS_BUSY,
-        .control_bit = MGPU_CTRL_ENABLE,
-        .enabled = true,
-    };
-    
-    mgr->stages[3] = (struct mgpu_pipeline_stage){
-        .name = "Fragment Shader",
-        .status_bit = MGPU_STATUS_BUSY,
-        .control_bit = MGPU_CTRL_ENABLE,
-        .enabled = true,
-    };
-    
-    mgr->stages[4] = (struct mgpu_pipeline_stage){
-        .name = "Framebuffer",
-        .status_bit = MGPU_STATUS_BUSY,
-        .control_bit = MGPU_CTRL_ENABLE,
-        .enabled = true,
-    };
+    struct mgpu_device *mdev = mgr->mdev;
+
+    spin_lock(&mgr->ctrl_lock);
+    mgr->ctrl_shadow = (mgr->ctrl_shadow & ~clear) | set;
+    mgpu_write(mdev, MGPU_REG_CONTROL, mgr->ctrl_shadow);
+    spin_unlock(&mgr->ctrl_lock);
 }
 
 /* Configure vertex fetch stage */
@@ -245,11 +282,15 @@ static int mgpu_pipeline_config_vertex_fetch(struct mgpu_pipeline_mgr *mgr,
     mgr->vertex_fetch.vertex_stride = vertex_stride;
     mgr->vertex_fetch.current_vertex = 0;
     
-    /* Program hardware registers */
-    mgpu_write(mdev, MGPU_REG_VERTEX_BASE, base_addr);
-    mgpu_write(mdev, MGPU_REG_VERTEX_COUNT, vertex_count);
-    mgpu_write(mdev, MGPU_REG_VERTEX_STRIDE, vertex_stride);
-    
+    /* Program hardware registers.  BASE/COUNT/STRIDE are consecutive
+     * words, so burst them as one relaxed copy; the ordered pipeline
+     * start write that eventually consumes them supplies the barrier */
+    {
+        u32 vals[3] = { base_addr, vertex_count, vertex_stride };
+
+        mgpu_write_burst(mdev, MGPU_REG_VERTEX_BASE, vals, 3);
+    }
+
     dev_dbg(mdev->dev, "Configured vertex fetch: base=0x%08x, count=%u, stride=%u\n",
             base_addr, vertex_count, vertex_stride);
     
@@ -297,10 +338,10 @@ static int mgpu_pipeline_config_framebuffer(struct mgpu_pipeline_mgr *mgr,
 {
     struct mgpu_device *mdev = mgr->mdev;
     
-    /* Framebuffer dimensions are fixed in hardware: 640x480 */
-    mgr->config.framebuffer.width = 640;
-    mgr->config.framebuffer.height = 480;
-    mgr->config.framebuffer.format = 0x8888; /* XRGB8888 */
+    /* Framebuffer dimensions are fixed in hardware */
+    mgr->config.framebuffer.width = MGPU_FB_WIDTH;
+    mgr->config.framebuffer.height = MGPU_FB_HEIGHT;
+    mgr->config.framebuffer.format = MGPU_FB_FORMAT;
     mgr->config.framebuffer.base_addr = base_addr;
     
     /* Note: Hardware framebuffer.sv doesn't have a base addr register,
@@ -314,38 +355,87 @@ static int mgpu_pipeline_config_framebuffer(struct mgpu_pipeline_mgr *mgr,
     return 0;
 }
 
+/* IRQ-side notification.  Called from the IRQ thread when the device
+ * raised a completion-class interrupt; one STATUS read classifies it
+ * for both stage waiters.  Sleeping on a completion here replaces the
+ * udelay(10) STATUS polls the stage waits used to burn - each poll
+ * was a full MMIO round trip with the GPU mid-frame */
+void mgpu_pipeline_irq_notify(struct mgpu_device *mdev)
+{
+    struct mgpu_pipeline_mgr *mgr = mdev->pipeline_mgr;
+    u32 status;
+
+    if (!mgr)
+        return;
+
+    status = mgpu_read(mdev, MGPU_REG_STATUS);
+    if (!(status & MGPU_STATUS_BUSY))
+        complete(&mgr->fetch_done);
+    if (status & MGPU_STATUS_IDLE)
+        complete(&mgr->idle_done);
+
+    /* Error interrupts trigger an immediate monitor pass instead of
+     * waiting out the current 100 ms period */
+    if (status & (MGPU_STATUS_ERROR | MGPU_STATUS_HALTED))
+        mod_delayed_work(system_wq, &mgr->monitor_work, 0);
+}
+
+/* Busy-wait budget before the vertex-fetch wait sleeps on its
+ * completion; small fetches often drain in well under a microsecond,
+ * cheaper to catch spinning than through an IRQ wakeup */
+#define MGPU_FETCH_BUSYWAIT_NS  1000
+
 /* Execute vertex fetch stage */
 static int mgpu_pipeline_fetch_vertices(struct mgpu_pipeline_mgr *mgr)
 {
     struct mgpu_device *mdev = mgr->mdev;
-    u32 status;
-    int timeout = 100;
-    
+    u64 spin_end;
+    bool busy = true;
+    int ret = 0;
+
     if (!mgr->vertex_fetch.vertex_count)
         return 0;
-    
+
     mgr->vertex_fetch.fetch_active = true;
-    
+
+    /* Arm the completion before kicking so a fast finish cannot race
+     * past the wait */
+    reinit_completion(&mgr->fetch_done);
+
     /* Trigger vertex fetch by starting pipeline */
-    status = mgpu_read(mdev, MGPU_REG_CONTROL);
-    mgpu_write(mdev, MGPU_REG_CONTROL, status | MGPU_CTRL_ENABLE);
-    
-    /* Wait for fetch to complete */
-    while (timeout-- > 0) {
-        status = mgpu_read(mdev, MGPU_REG_STATUS);
-        if (!(status & MGPU_STATUS_BUSY))
+    mgpu_pipeline_ctrl_update(mgr, MGPU_CTRL_ENABLE, 0);
+
+    /* Fast path: spin a short ns budget first, since quick fetches
+     * finish before an interrupt could even be delivered */
+    spin_end = ktime_get_mono_fast_ns() + MGPU_FETCH_BUSYWAIT_NS;
+    do {
+        if (!(mgpu_read(mdev, MGPU_REG_STATUS) & MGPU_STATUS_BUSY)) {
+            busy = false;
             break;
-        udelay(10);
+        }
+        cpu_relax();
+    } while (ktime_get_mono_fast_ns() < spin_end);
+
+    /* Sleep until the IRQ thread reports the busy bit cleared.  On
+     * timeout re-check the hardware before declaring a hang: the
+     * completion interrupt may have been coalesced into a batch the
+     * thread drained before we armed the completion */
+    if (busy && !wait_for_completion_timeout(&mgr->fetch_done,
+                                             msecs_to_jiffies(10))) {
+        if (mgpu_read(mdev, MGPU_REG_STATUS) & MGPU_STATUS_BUSY)
+            ret = -ETIMEDOUT;
     }
-    
+
     mgr->vertex_fetch.fetch_active = false;
     mgr->vertex_fetch.current_vertex = mgr->vertex_fetch.vertex_count;
-    
+
     /* Update statistics */
+    write_seqcount_begin(&mgr->stats_seq);
     mgr->total_vertices += mgr->vertex_fetch.vertex_count;
-    mgr->stages[0].processed_items += mgr->vertex_fetch.vertex_count;
-    
-    return (timeout > 0) ? 0 : -ETIMEDOUT;
+    mgr->stage_processed[0] += mgr->vertex_fetch.vertex_count;
+    write_seqcount_end(&mgr->stats_seq);
+
+    return ret;
 }
 
 /* Execute shader stage */
@@ -370,8 +460,10 @@ static int mgpu_pipeline_execute_shader(struct mgpu_pipeline_mgr *mgr,
         return -EIO;
     }
     
-    mgr->stages[1].processed_items++;
-    
+    write_seqcount_begin(&mgr->stats_seq);
+    mgr->stage_processed[1]++;
+    write_seqcount_end(&mgr->stats_seq);
+
     return 0;
 }
 
@@ -381,19 +473,31 @@ static int mgpu_pipeline_rasterize(struct mgpu_pipeline_mgr *mgr)
     struct mgpu_rasterizer_state *rast = &mgr->rasterizer;
     struct mgpu_device *mdev = mgr->mdev;
     u32 triangles_per_batch = mgr->vertex_fetch.vertex_count / 3;
-    
+    s32 bbox_w = max(0, rast->bbox_max_x - rast->bbox_min_x);
+    s32 bbox_h = max(0, rast->bbox_max_y - rast->bbox_min_y);
+    u32 frags_per_tri;
+
     rast->raster_active = true;
-    
+
     /* Process triangles */
     rast->triangles_processed += triangles_per_batch;
-    
-    /* Estimate fragments (simplified) */
-    rast->fragments_generated += triangles_per_batch * 100; /* Rough estimate */
+
+    /* Estimate fragments from the current bounding box when geometry
+     * has populated one (a triangle covers about half its bbox);
+     * otherwise keep the old flat per-triangle fudge.  Same cost as
+     * the fudge, real numbers when the state is live */
+    if (bbox_w > 0 && bbox_h > 0)
+        frags_per_tri = ((u32)bbox_w * (u32)bbox_h) / 2;
+    else
+        frags_per_tri = 100;
+    rast->fragments_generated += triangles_per_batch * frags_per_tri;
     
     /* Update statistics */
+    write_seqcount_begin(&mgr->stats_seq);
     mgr->total_primitives += triangles_per_batch;
     mgr->total_fragments += rast->fragments_generated;
-    mgr->stages[2].processed_items += triangles_per_batch;
+    mgr->stage_processed[2] += triangles_per_batch;
+    write_seqcount_end(&mgr->stats_seq);
     
     rast->raster_active = false;
     
@@ -410,121 +514,111 @@ static int mgpu_pipeline_process_fragments(struct mgpu_pipeline_mgr *mgr)
     frag->pixels_written = frag->fragments_processed; /* 1:1 for now */
     
     /* Update statistics */
+    write_seqcount_begin(&mgr->stats_seq);
     mgr->total_pixels += frag->pixels_written;
-    mgr->stages[3].processed_items += frag->fragments_processed;
-    mgr->stages[4].processed_items += frag->pixels_written;
+    mgr->stage_processed[3] += frag->fragments_processed;
+    mgr->stage_processed[4] += frag->pixels_written;
+    write_seqcount_end(&mgr->stats_seq);
     
     return 0;
 }
 
-/* Execute a pipeline stage */
-static int mgpu_pipeline_execute_stage(struct mgpu_pipeline_mgr *mgr,
-                                       enum mgpu_pipeline_state stage)
+/* Shader stage wrapper so the dispatch table below has a uniform
+ * signature: runs the vertex shader and, when a fragment shader is
+ * bound, that one too */
+static int mgpu_pipeline_stage_shaders(struct mgpu_pipeline_mgr *mgr)
 {
-    struct mgpu_device *mdev = mgr->mdev;
-    int ret = 0;
-    
-    dev_dbg(mdev->dev, "Executing pipeline stage: %d\n", stage);
-    
-    switch (stage) {
-    case PIPE_FETCH_VERTEX:
-        ret = mgpu_pipeline_fetch_vertices(mgr);
-        break;
-        
-    case PIPE_EXECUTE_SHADER:
-        ret = mgpu_pipeline_execute_shader(mgr, &mgr->vertex_shader);
-        if (!ret && mgr->config.shaders.fragment_shader_slot < 16) {
-            ret = mgpu_pipeline_execute_shader(mgr, &mgr->fragment_shader);
-        }
-        break;
-        
-    case PIPE_RASTERIZE:
-        ret = mgpu_pipeline_rasterize(mgr);
-        break;
-        
-    case PIPE_FRAGMENT:
-        ret = mgpu_pipeline_process_fragments(mgr);
-        break;
-        
-    case PIPE_DONE:
-        complete(&mgr->pipeline_complete);
-        break;
-        
-    default:
-        break;
-    }
-    
-    if (ret) {
-        dev_err(mdev->dev, "Pipeline stage %d failed: %d\n", stage, ret);
-        mgr->pipeline_errors++;
-        mgr->last_error_stage = stage;
-    }
-    
+    int ret;
+
+    ret = mgpu_pipeline_execute_shader(mgr, &mgr->vertex_shader);
+    if (!ret && mgr->fragment_shader.bound)
+        ret = mgpu_pipeline_execute_shader(mgr, &mgr->fragment_shader);
+
     return ret;
 }
 
+/* Stage dispatch and successor tables, indexed by pipeline state.
+ * One indexed load each replaces the pair of switches (dispatch in
+ * execute_stage, advance in the execute loop) previously run per
+ * stage */
+static int (* const mgpu_stage_fn[])(struct mgpu_pipeline_mgr *) = {
+    [PIPE_FETCH_VERTEX]   = mgpu_pipeline_fetch_vertices,
+    [PIPE_EXECUTE_SHADER] = mgpu_pipeline_stage_shaders,
+    [PIPE_RASTERIZE]      = mgpu_pipeline_rasterize,
+    [PIPE_FRAGMENT]       = mgpu_pipeline_process_fragments,
+};
+
+static const enum mgpu_pipeline_state mgpu_next_state[] = {
+    [PIPE_FETCH_VERTEX]   = PIPE_EXECUTE_SHADER,
+    [PIPE_EXECUTE_SHADER] = PIPE_RASTERIZE,
+    [PIPE_RASTERIZE]      = PIPE_FRAGMENT,
+    [PIPE_FRAGMENT]       = PIPE_DONE,
+};
+
 /* Main pipeline execution */
 int mgpu_pipeline_execute(struct mgpu_pipeline_mgr *mgr)
 {
     struct mgpu_device *mdev = mgr->mdev;
-    enum mgpu_pipeline_state next_state;
     int ret = 0;
-    
-    mutex_lock(&mgr->state_lock);
-    
+
+    /* Interruptible: a synchronous ioctl caller queued behind a
+     * running frame can be signaled out instead of blocking
+     * uninterruptibly for the whole frame */
+    ret = mutex_lock_interruptible(&mgr->state_lock);
+    if (ret)
+        return ret;
+
     if (mgr->state != PIPE_IDLE) {
         dev_warn(mdev->dev, "Pipeline already running\n");
         mutex_unlock(&mgr->state_lock);
         return -EBUSY;
     }
     
-    mgr->frame_start_time = ktime_get();
+    mgr->frame_start_ns = ktime_get_mono_fast_ns();
     mgr->state = PIPE_FETCH_VERTEX;
     
-    /* Execute pipeline stages in sequence */
-    while (mgr->state != PIPE_IDLE && mgr->state != PIPE_DONE) {
-        ret = mgpu_pipeline_execute_stage(mgr, mgr->state);
-        if (ret)
-            break;
-        
-        /* Advance to next stage */
-        switch (mgr->state) {
-        case PIPE_FETCH_VERTEX:
-            next_state = PIPE_EXECUTE_SHADER;
-            break;
-        case PIPE_EXECUTE_SHADER:
-            next_state = PIPE_RASTERIZE;
-            break;
-        case PIPE_RASTERIZE:
-            next_state = PIPE_FRAGMENT;
-            break;
-        case PIPE_FRAGMENT:
-            next_state = PIPE_DONE;
-            break;
-        default:
-            next_state = PIPE_IDLE;
+    /* Execute pipeline stages in sequence via the dispatch table */
+    while (mgr->state != PIPE_DONE) {
+        dev_dbg(mdev->dev, "Executing pipeline stage: %d\n", mgr->state);
+
+        ret = mgpu_stage_fn[mgr->state](mgr);
+        if (ret) {
+            dev_err(mdev->dev, "Pipeline stage %d failed: %d\n",
+                    mgr->state, ret);
+            write_seqcount_begin(&mgr->stats_seq);
+            mgr->pipeline_errors++;
+            mgr->last_error_stage = mgr->state;
+            write_seqcount_end(&mgr->stats_seq);
             break;
         }
-        
-        mgr->state = next_state;
-        
-        /* Allow other tasks to run */
-        if (mgr->state != PIPE_DONE) {
-            mutex_unlock(&mgr->state_lock);
+
+        mgr->state = mgpu_next_state[mgr->state];
+
+        /* Allow other tasks to run.  The lock can stay held now that
+         * stats readers snapshot through stats_seq instead of queuing
+         * on the mutex; nothing else contends it mid-frame */
+        if (mgr->state != PIPE_DONE)
             cond_resched();
-            mutex_lock(&mgr->state_lock);
-        }
     }
-    
-    mgr->frame_end_time = ktime_get();
+
+    mgr->frame_end_ns = ktime_get_mono_fast_ns();
+    write_seqcount_begin(&mgr->stats_seq);
     mgr->frames_rendered++;
+    write_seqcount_end(&mgr->stats_seq);
+    if (mgr->frames_rendered % 100 == 0)
+        WRITE_ONCE(mgr->stats_log_due, true);
     mgr->state = PIPE_IDLE;
-    
+
     mutex_unlock(&mgr->state_lock);
+
+    /* Frame-end publication: waiters sleep on
+     * wait_event_interruptible_timeout(stage_wait, state == PIPE_IDLE)
+     * rather than a dedicated completion, so the same queue serves
+     * both resume and end-of-frame wakeups */
+    wake_up_all(&mgr->stage_wait);
     
     if (!ret) {
-        u64 frame_time_ns = ktime_to_ns(ktime_sub(mgr->frame_end_time,
-                                                  mgr->frame_start_time));
+        u64 frame_time_ns = mgr->frame_end_ns - mgr->frame_start_ns;
         dev_dbg(mdev->dev, "Frame %llu completed in %llu ns\n",
                 mgr->frames_rendered, frame_time_ns);
     }
@@ -532,16 +626,48 @@ int mgpu_pipeline_execute(struct mgpu_pipeline_mgr *mgr)
     return ret;
 }
 
-/* Pipeline work handler for async execution */
+/* Pipeline work handler: drain the async draw ring.  Draws queued
+ * while a frame runs are consumed by this same invocation, so the
+ * no-op schedule_work() on an already-queued work item cannot lose
+ * them */
 static void mgpu_pipeline_work_handler(struct work_struct *work)
 {
     struct mgpu_pipeline_mgr *mgr = container_of(work,
                                                 struct mgpu_pipeline_mgr,
                                                 pipeline_work);
-    mgpu_pipeline_execute(mgr);
+    struct mgpu_draw_call draw;
+
+    for (;;) {
+        spin_lock(&mgr->draw_lock);
+        if (mgr->draw_head == mgr->draw_tail) {
+            spin_unlock(&mgr->draw_lock);
+            break;
+        }
+        draw = mgr->draw_ring[mgr->draw_head & (MGPU_DRAW_RING_SLOTS - 1)];
+        mgr->draw_head++;
+        spin_unlock(&mgr->draw_lock);
+
+        /* Program the stage registers before releasing the freed
+         * slot: a submitter woken here copies descriptor N+1 into
+         * the ring while this frame runs, so descriptor preparation
+         * overlaps GPU work.  The register writes themselves cannot
+         * be hoisted into the previous frame - the config registers
+         * are read live while a frame is in flight */
+        if (mgpu_pipeline_draw_configure(mgr, &draw)) {
+            wake_up_interruptible(&mgr->draw_space);
+            continue;
+        }
+
+        /* Slot freed; unblock a submitter waiting on a full ring */
+        wake_up_interruptible(&mgr->draw_space);
+
+        mgpu_pipeline_draw_kick(mgr);
+    }
 }
 
-/* Pipeline monitor work */
+/* Pipeline monitor work.  Armed on draw submission and on error
+ * interrupts rather than free-running: an idle pipeline takes no
+ * 100 ms timer wakeups and no STATUS reads */
 static void mgpu_pipeline_monitor_work(struct work_struct *work)
 {
     struct mgpu_pipeline_mgr *mgr = container_of(work,
@@ -555,7 +681,11 @@ static void mgpu_pipeline_monitor_work(struct work_struct *work)
     
     if (status & MGPU_STATUS_ERROR) {
         dev_err(mdev->dev, "Pipeline error detected: 0x%08x\n", status);
+        mutex_lock(&mgr->state_lock);
+        write_seqcount_begin(&mgr->stats_seq);
         mgr->pipeline_errors++;
+        write_seqcount_end(&mgr->stats_seq);
+        mutex_unlock(&mgr->state_lock);
     }
     
     if (status & MGPU_STATUS_HALTED) {
@@ -564,15 +694,19 @@ static void mgpu_pipeline_monitor_work(struct work_struct *work)
         mgpu_reset_schedule(mdev);
     }
     
-    /* Log statistics periodically */
-    if (mgr->frames_rendered % 100 == 0 && mgr->frames_rendered > 0) {
+    /* Log statistics when the frame counter crossed a multiple of
+     * 100; the execute path raises the flag so this does not depend
+     * on the monitor sampling exactly the right frame */
+    if (READ_ONCE(mgr->stats_log_due)) {
+        WRITE_ONCE(mgr->stats_log_due, false);
         dev_info(mdev->dev, "Pipeline stats: %llu frames, %llu vertices, "
                  "%llu fragments, %llu pixels\n",
                  mgr->frames_rendered, mgr->total_vertices,
                  mgr->total_fragments, mgr->total_pixels);
     }
-    
-    /* Reschedule monitor */
+
+    /* Keep watching only while a frame is in flight; the next draw
+     * re-arms the monitor, so an idle pipeline stays quiescent */
     if (mgr->state != PIPE_IDLE) {
         schedule_delayed_work(&mgr->monitor_work, HZ / 10); /* 100ms */
     }
@@ -582,40 +716,39 @@ static void mgpu_pipeline_monitor_work(struct work_struct *work)
 int mgpu_pipeline_flush(struct mgpu_pipeline_mgr *mgr)
 {
     struct mgpu_device *mdev = mgr->mdev;
-    u32 control;
-    int timeout = 1000;
-    
+    int ret = 0;
+
     dev_dbg(mdev->dev, "Flushing pipeline\n");
-    
+
+    reinit_completion(&mgr->idle_done);
+
     /* Set flush bit */
-    control = mgpu_read(mdev, MGPU_REG_CONTROL);
-    mgpu_write(mdev, MGPU_REG_CONTROL, control | MGPU_CTRL_FLUSH_CACHE);
-    
-    /* Wait for flush to complete */
-    while (timeout-- > 0) {
-        if (mgpu_read(mdev, MGPU_REG_STATUS) & MGPU_STATUS_IDLE)
-            break;
-        udelay(10);
+    mgpu_pipeline_ctrl_update(mgr, MGPU_CTRL_FLUSH_CACHE, 0);
+
+    /* Sleep until the IRQ thread sees the device idle; same timeout
+     * budget the 1000 x udelay(10) poll loop had, minus the polling */
+    if (!wait_for_completion_timeout(&mgr->idle_done,
+                                     msecs_to_jiffies(10))) {
+        if (!(mgpu_read(mdev, MGPU_REG_STATUS) & MGPU_STATUS_IDLE))
+            ret = -ETIMEDOUT;
     }
-    
+
     /* Clear flush bit */
-    mgpu_write(mdev, MGPU_REG_CONTROL, control);
-    
-    return (timeout > 0) ? 0 : -ETIMEDOUT;
+    mgpu_pipeline_ctrl_update(mgr, 0, MGPU_CTRL_FLUSH_CACHE);
+
+    return ret;
 }
 
 /* Stall pipeline */
 int mgpu_pipeline_stall(struct mgpu_pipeline_mgr *mgr)
 {
     struct mgpu_device *mdev = mgr->mdev;
-    u32 control;
-    
+
     dev_dbg(mdev->dev, "Stalling pipeline\n");
-    
+
     /* Set pause bit */
-    control = mgpu_read(mdev, MGPU_REG_CONTROL);
-    mgpu_write(mdev, MGPU_REG_CONTROL, control | MGPU_CTRL_PAUSE);
-    
+    mgpu_pipeline_ctrl_update(mgr, MGPU_CTRL_PAUSE, 0);
+
     return 0;
 }
 
@@ -623,13 +756,11 @@ int mgpu_pipeline_stall(struct mgpu_pipeline_mgr *mgr)
 int mgpu_pipeline_resume(struct mgpu_pipeline_mgr *mgr)
 {
     struct mgpu_device *mdev = mgr->mdev;
-    u32 control;
-    
+
     dev_dbg(mdev->dev, "Resuming pipeline\n");
-    
+
     /* Clear pause bit */
-    control = mgpu_read(mdev, MGPU_REG_CONTROL);
-    mgpu_write(mdev, MGPU_REG_CONTROL, control & ~MGPU_CTRL_PAUSE);
+    mgpu_pipeline_ctrl_update(mgr, 0, MGPU_CTRL_PAUSE);
     
     /* Wake up any waiting stages */
     wake_up_all(&mgr->stage_wait);
@@ -641,30 +772,34 @@ int mgpu_pipeline_resume(struct mgpu_pipeline_mgr *mgr)
 int mgpu_pipeline_get_stats(struct mgpu_pipeline_mgr *mgr,
                            struct mgpu_pipeline_stats *stats)
 {
+    unsigned int seq;
     int i;
-    
+
     if (!stats)
         return -EINVAL;
-    
-    mutex_lock(&mgr->state_lock);
-    
-    stats->frames_rendered = mgr->frames_rendered;
-    stats->total_vertices = mgr->total_vertices;
-    stats->total_primitives = mgr->total_primitives;
-    stats->total_fragments = mgr->total_fragments;
-    stats->total_pixels = mgr->total_pixels;
-    stats->pipeline_errors = mgr->pipeline_errors;
-    
-    /* Per-stage statistics */
-    for (i = 0; i < 5; i++) {
-        stats->stage_stats[i].name = mgr->stages[i].name;
-        stats->stage_stats[i].processed_items = mgr->stages[i].processed_items;
-        stats->stage_stats[i].stall_cycles = mgr->stages[i].stall_cycles;
-        stats->stage_stats[i].enabled = mgr->stages[i].enabled;
-    }
-    
-    mutex_unlock(&mgr->state_lock);
-    
+
+    /* Lock-free snapshot: retry the copy if a writer advanced
+     * stats_seq mid-read, instead of queuing pollers on state_lock
+     * behind a running frame */
+    do {
+        seq = read_seqcount_begin(&mgr->stats_seq);
+
+        stats->frames_rendered = mgr->frames_rendered;
+        stats->total_vertices = mgr->total_vertices;
+        stats->total_primitives = mgr->total_primitives;
+        stats->total_fragments = mgr->total_fragments;
+        stats->total_pixels = mgr->total_pixels;
+        stats->pipeline_errors = mgr->pipeline_errors;
+
+        /* Per-stage statistics */
+        for (i = 0; i < MGPU_PIPE_STAGES; i++) {
+            stats->stage_stats[i].name = mgpu_stage_desc[i].name;
+            stats->stage_stats[i].processed_items = mgr->stage_processed[i];
+            stats->stage_stats[i].stall_cycles = mgr->stage_stalls[i];
+            stats->stage_stats[i].enabled = mgr->stage_enabled[i];
+        }
+    } while (read_seqcount_retry(&mgr->stats_seq, seq));
+
     return 0;
 }
 
@@ -674,65 +809,126 @@ void mgpu_pipeline_reset_stats(struct mgpu_pipeline_mgr *mgr)
     int i;
     
     mutex_lock(&mgr->state_lock);
-    
+    write_seqcount_begin(&mgr->stats_seq);
+
     mgr->frames_rendered = 0;
     mgr->total_vertices = 0;
     mgr->total_primitives = 0;
     mgr->total_fragments = 0;
     mgr->total_pixels = 0;
     mgr->pipeline_errors = 0;
-    
-    for (i = 0; i < 5; i++) {
-        mgr->stages[i].processed_items = 0;
-        mgr->stages[i].stall_cycles = 0;
+
+    for (i = 0; i < MGPU_PIPE_STAGES; i++) {
+        mgr->stage_processed[i] = 0;
+        mgr->stage_stalls[i] = 0;
     }
-    
+
+    write_seqcount_end(&mgr->stats_seq);
     mutex_unlock(&mgr->state_lock);
 }
 
-/* Submit draw call */
-int mgpu_pipeline_draw(struct mgpu_device *mdev, struct mgpu_draw_call *draw)
+/* Program all stage registers for one draw descriptor.  Split from
+ * the kick so the ring consumer can issue the configuration MMIO as
+ * early as possible; the config registers are single-banked and read
+ * live while a frame runs, so configuration must not overlap a frame
+ * already in flight */
+static int mgpu_pipeline_draw_configure(struct mgpu_pipeline_mgr *mgr,
+                                        const struct mgpu_draw_call *draw)
 {
-    struct mgpu_pipeline_mgr *mgr = mdev->pipeline_mgr;
     int ret;
-    
-    if (!mgr)
-        return -ENODEV;
-    
+
     /* Configure pipeline for draw */
     ret = mgpu_pipeline_config_vertex_fetch(mgr, draw->vertex_buffer,
                                            draw->vertex_count,
                                            draw->vertex_stride);
     if (ret)
         return ret;
-    
-    /* Set shader slots */
+
+    /* Set shader slots.  Slot validity is resolved here, once per
+     * draw, so the stage hot path tests a precomputed flag instead of
+     * re-deriving it from the slot index; an out-of-range fragment
+     * slot means "no fragment shader" as before */
     mgr->vertex_shader.slot = draw->vertex_shader_slot;
     mgr->vertex_shader.type = MGPU_SHADER_VERTEX;
+    mgr->vertex_shader.bound = true;
     mgr->fragment_shader.slot = draw->fragment_shader_slot;
     mgr->fragment_shader.type = MGPU_SHADER_FRAGMENT;
-    
+    mgr->fragment_shader.bound =
+        draw->fragment_shader_slot < MGPU_MAX_SHADER_SLOTS;
+
     /* Configure other stages */
     mgpu_pipeline_config_rasterizer(mgr, draw->cull_enable, draw->cull_mode);
     mgpu_pipeline_config_fragment(mgr, draw->texture_enable, draw->texture_slot);
     mgpu_pipeline_config_framebuffer(mgr, draw->framebuffer_addr);
-    
-    /* Execute pipeline */
-    if (draw->flags & MGPU_DRAW_ASYNC) {
-        /* Async execution */
-        schedule_work(&mgr->pipeline_work);
-        return 0;
-    } else {
-        /* Synchronous execution */
-        return mgpu_pipeline_execute(mgr);
+
+    return 0;
+}
+
+/* Kick the configured frame and run it to completion */
+static int mgpu_pipeline_draw_kick(struct mgpu_pipeline_mgr *mgr)
+{
+    /* Arm the monitor for this frame; it re-arms itself only while
+     * the pipeline stays busy */
+    mod_delayed_work(system_wq, &mgr->monitor_work, HZ / 10);
+
+    return mgpu_pipeline_execute(mgr);
+}
+
+/* Configure and run one frame.  Shared by the synchronous path and
+ * the async ring consumer */
+static int mgpu_pipeline_run_draw(struct mgpu_pipeline_mgr *mgr,
+                                  const struct mgpu_draw_call *draw)
+{
+    int ret;
+
+    ret = mgpu_pipeline_draw_configure(mgr, draw);
+    if (ret)
+        return ret;
+
+    return mgpu_pipeline_draw_kick(mgr);
+}
+
+/* Submit draw call */
+int mgpu_pipeline_draw(struct mgpu_device *mdev, struct mgpu_draw_call *draw)
+{
+    struct mgpu_pipeline_mgr *mgr = mdev->pipeline_mgr;
+    int ret;
+
+    if (!mgr)
+        return -ENODEV;
+
+    /* Synchronous draws configure and run in the caller's context */
+    if (!(draw->flags & MGPU_DRAW_ASYNC))
+        return mgpu_pipeline_run_draw(mgr, draw);
+
+    /* Async: deposit the descriptor and let the consumer pace the
+     * hardware.  Sleep when the ring is a full frame-pipeline deep
+     * rather than dropping or overwriting a pending draw */
+    spin_lock(&mgr->draw_lock);
+    while (mgr->draw_tail - mgr->draw_head == MGPU_DRAW_RING_SLOTS) {
+        spin_unlock(&mgr->draw_lock);
+        ret = wait_event_interruptible(mgr->draw_space,
+                  READ_ONCE(mgr->draw_tail) - READ_ONCE(mgr->draw_head) <
+                  MGPU_DRAW_RING_SLOTS);
+        if (ret)
+            return ret;
+        spin_lock(&mgr->draw_lock);
     }
+    mgr->draw_ring[mgr->draw_tail & (MGPU_DRAW_RING_SLOTS - 1)] = *draw;
+    mgr->draw_tail++;
+    spin_unlock(&mgr->draw_lock);
+
+    schedule_work(&mgr->pipeline_work);
+
+    return 0;
 }
 
 /* Initialize pipeline manager */
 int mgpu_pipeline_init(struct mgpu_device *mdev)
 {
     struct mgpu_pipeline_mgr *mgr;
-    
+    int i;
+
     mgr = kzalloc(sizeof(*mgr), GFP_KERNEL);
     if (!mgr)
         return -ENOMEM;
@@ -741,19 +937,36 @@ int mgpu_pipeline_init(struct mgpu_device *mdev)
     mgr->state = PIPE_IDLE;
     
     mutex_init(&mgr->state_lock);
-    init_completion(&mgr->pipeline_complete);
+    seqcount_mutex_init(&mgr->stats_seq, &mgr->state_lock);
+    init_completion(&mgr->fetch_done);
+    init_completion(&mgr->idle_done);
     init_waitqueue_head(&mgr->stage_wait);
-    
+    spin_lock_init(&mgr->draw_lock);
+    init_waitqueue_head(&mgr->draw_space);
+    spin_lock_init(&mgr->ctrl_lock);
+
+    /* Seed the CONTROL shadow from the hardware: core init has
+     * already written its enable bits by the time the pipeline
+     * manager comes up */
+    mgr->ctrl_shadow = mgpu_read(mdev, MGPU_REG_CONTROL);
+
     /* Initialize work queues */
     INIT_WORK(&mgr->pipeline_work, mgpu_pipeline_work_handler);
     INIT_DELAYED_WORK(&mgr->monitor_work, mgpu_pipeline_monitor_work);
     
-    /* Initialize stages */
-    mgpu_pipeline_init_stages(mgr);
-    
+    /* All stages start enabled; the rest of the per-stage data is
+     * either zeroed counters or the const descriptor table */
+    for (i = 0; i < MGPU_PIPE_STAGES; i++)
+        mgr->stage_enabled[i] = true;
+
+
+    /* The rasterizer packs coordinates as s16; catch a framebuffer
+     * geometry bump that would overflow them */
+    BUILD_BUG_ON(MGPU_FB_WIDTH > S16_MAX || MGPU_FB_HEIGHT > S16_MAX);
+
     /* Set default configuration */
-    mgr->config.framebuffer.width = 640;
-    mgr->config.framebuffer.height = 480;
+    mgr->config.framebuffer.width = MGPU_FB_WIDTH;
+    mgr->config.framebuffer.height = MGPU_FB_HEIGHT;
     
     mdev->pipeline_mgr = mgr;
     
@@ -31,6 +31,11 @@ struct mgpu_clocks {
     struct clk *core_clk;
     struct clk *mem_clk;
     struct clk *axi_clk;
+    /* Full-speed core rate captured at init: D-state transitions
+     * scale from this instead of re-walking the clk tree under
+     * prepare_lock, and repeated D1 entries cannot ratchet the rate
+     * down by re-halving an already-halved clock */
+    unsigned long base_core_rate;
     bool enabled;
 };
 
@@ -50,9 +55,28 @@ struct mgpu_pm_state {
     /* Runtime PM */
     bool runtime_enabled;
     atomic_t usage_count;
-    
-    /* Suspend/resume state */
-    u32 saved_regs[64];
+
+    /* Set by resume paths that follow the D0 transition with
+     * mgpu_pm_restore_registers(): the restore owns the final
+     * CONTROL write, so the D0 branch skips its interim enable.
+     * Consumed (cleared) by mgpu_pm_set_power_state; callers that
+     * want an immediate enable simply leave it false */
+    bool restore_pending;
+    
+    /* Suspend/resume state.  Named fields instead of a
+     * magic-indexed u32[64]: the mapping is in the type, and the
+     * state shrinks from 256 bytes to one cache line */
+    struct mgpu_saved_state {
+        u32 control;
+        u32 irq_enable;
+        u32 cmd_base;
+        u32 cmd_size;
+        u32 fence_addr;
+        u32 vertex_base;
+        u32 vertex_count;
+        u32 vertex_stride;
+        u32 shader_pc;
+    } saved;
     bool suspended;
     
     /* Statistics */
@@ -70,16 +94,20 @@ static void mgpu_pm_save_registers(struct mgpu_device *mdev)
 {
     struct mgpu_pm_state *pm = mdev->pm_state;
     
-    /* Save critical registers */
-    pm->saved_regs[0] = mgpu_read(mdev, MGPU_REG_CONTROL);
-    pm->saved_regs[1] = mgpu_read(mdev, MGPU_REG_IRQ_ENABLE);
-    pm->saved_regs[2] = mgpu_read(mdev, MGPU_REG_CMD_BASE);
-    pm->saved_regs[3] = mgpu_read(mdev, MGPU_REG_CMD_SIZE);
-    pm->saved_regs[4] = mgpu_read(mdev, MGPU_REG_FENCE_ADDR);
-    pm->saved_regs[5] = mgpu_read(mdev, MGPU_REG_VERTEX_BASE);
-    pm->saved_regs[6] = mgpu_read(mdev, MGPU_REG_VERTEX_COUNT);
-    pm->saved_regs[7] = mgpu_read(mdev, MGPU_REG_VERTEX_STRIDE);
-    pm->saved_regs[8] = mgpu_read(mdev, MGPU_REG_SHADER_PC);
+    /* Save critical registers.  All of these are plain config/state
+     * registers with no read side effects, and the offsets are not
+     * contiguous, so a back-to-back relaxed read per register beats
+     * both a barriered readl each and a memcpy_fromio over a window
+     * that would touch unrelated registers */
+    pm->saved.control = mgpu_read_relaxed(mdev, MGPU_REG_CONTROL);
+    pm->saved.irq_enable = mgpu_read_relaxed(mdev, MGPU_REG_IRQ_ENABLE);
+    pm->saved.cmd_base = mgpu_read_relaxed(mdev, MGPU_REG_CMD_BASE);
+    pm->saved.cmd_size = mgpu_read_relaxed(mdev, MGPU_REG_CMD_SIZE);
+    pm->saved.fence_addr = mgpu_read_relaxed(mdev, MGPU_REG_FENCE_ADDR);
+    pm->saved.vertex_base = mgpu_read_relaxed(mdev, MGPU_REG_VERTEX_BASE);
+    pm->saved.vertex_count = mgpu_read_relaxed(mdev, MGPU_REG_VERTEX_COUNT);
+    pm->saved.vertex_stride = mgpu_read_relaxed(mdev, MGPU_REG_VERTEX_STRIDE);
+    pm->saved.shader_pc = mgpu_read_relaxed(mdev, MGPU_REG_SHADER_PC);
     
     dev_dbg(mdev->dev, "Saved GPU register state\n");
 }
@@ -89,16 +117,20 @@ static void mgpu_pm_restore_registers(struct mgpu_device *mdev)
 {
     struct mgpu_pm_state *pm = mdev->pm_state;
     
-    /* Restore critical registers */
-    mgpu_write(mdev, MGPU_REG_CMD_BASE, pm->saved_regs[2]);
-    mgpu_write(mdev, MGPU_REG_CMD_SIZE, pm->saved_regs[3]);
-    mgpu_write(mdev, MGPU_REG_FENCE_ADDR, pm->saved_regs[4]);
-    mgpu_write(mdev, MGPU_REG_VERTEX_BASE, pm->saved_regs[5]);
-    mgpu_write(mdev, MGPU_REG_VERTEX_COUNT, pm->saved_regs[6]);
-    mgpu_write(mdev, MGPU_REG_VERTEX_STRIDE, pm->saved_regs[7]);
-    mgpu_write(mdev, MGPU_REG_SHADER_PC, pm->saved_regs[8]);
-    mgpu_write(mdev, MGPU_REG_IRQ_ENABLE, pm->saved_regs[1]);
-    mgpu_write(mdev, MGPU_REG_CONTROL, pm->saved_regs[0]);
+    /* Restore critical registers.  Relaxed stores to the same
+     * peripheral window arrive in program order on AXI, so the
+     * config batch needs no per-write barriers; the final barriered
+     * CONTROL write orders the whole batch and re-enables the core
+     * only after its configuration is back in place */
+    mgpu_write_relaxed(mdev, MGPU_REG_CMD_BASE, pm->saved.cmd_base);
+    mgpu_write_relaxed(mdev, MGPU_REG_CMD_SIZE, pm->saved.cmd_size);
+    mgpu_write_relaxed(mdev, MGPU_REG_FENCE_ADDR, pm->saved.fence_addr);
+    mgpu_write_relaxed(mdev, MGPU_REG_VERTEX_BASE, pm->saved.vertex_base);
+    mgpu_write_relaxed(mdev, MGPU_REG_VERTEX_COUNT, pm->saved.vertex_count);
+    mgpu_write_relaxed(mdev, MGPU_REG_VERTEX_STRIDE, pm->saved.vertex_stride);
+    mgpu_write_relaxed(mdev, MGPU_REG_SHADER_PC, pm->saved.shader_pc);
+    mgpu_write_relaxed(mdev, MGPU_REG_IRQ_ENABLE, pm->saved.irq_enable);
+    mgpu_write(mdev, MGPU_REG_CONTROL, pm->saved.control);
     
     dev_dbg(mdev->dev, "Restored GPU register state\n");
 }
@@ -182,8 +214,10 @@ static int mgpu_pm_set_power_state(struct mgpu_device *mdev,
     struct mgpu_pm_state *pm = mdev->pm_state;
     int ret = 0;
     
-    if (pm->power_state == state)
+    if (pm->power_state == state) {
+        pm->restore_pending = false;
         return 0;
+    }
     
     dev_dbg(mdev->dev, "Transitioning from %s to %s\n",
             mgpu_power_state_names[pm->power_state],
@@ -195,16 +229,28 @@ static int mgpu_pm_set_power_state(struct mgpu_device *mdev,
         ret = mgpu_pm_enable_clocks(mdev);
         if (ret)
             return ret;
-        
-        /* Enable GPU */
-        mgpu_write(mdev, MGPU_REG_CONTROL, MGPU_CTRL_ENABLE);
+
+        /* Undo any D1 downclock; a failure here is worth a warning
+         * but must not fail the power-up itself */
+        if (pm->clocks.core_clk && pm->clocks.base_core_rate &&
+            clk_set_rate(pm->clocks.core_clk, pm->clocks.base_core_rate))
+            dev_warn(mdev->dev, "Failed to restore clock rate\n");
+
+        /* Enable GPU - unless a register restore follows, which
+         * writes CONTROL anyway; skipping the interim write avoids
+         * back-to-back stores to the same register on every resume */
+        if (pm->restore_pending)
+            pm->restore_pending = false;
+        else
+            mgpu_write(mdev, MGPU_REG_CONTROL, MGPU_CTRL_ENABLE);
         break;
         
     case MGPU_POWER_D1:
-        /* Idle - reduce clocks */
-        if (pm->clocks.core_clk) {
+        /* Idle - reduce clocks.  Halve the cached full-speed rate
+         * rather than clk_get_rate()'s locked tree walk */
+        if (pm->clocks.core_clk && pm->clocks.base_core_rate) {
             ret = clk_set_rate(pm->clocks.core_clk,
-                             clk_get_rate(pm->clocks.core_clk) / 2);
+                               pm->clocks.base_core_rate / 2);
             if (ret)
                 dev_warn(mdev->dev, "Failed to reduce clock rate\n");
         }
@@ -266,11 +312,13 @@ static int mgpu_pm_runtime_resume(struct device *dev)
     
     dev_dbg(dev, "Runtime resume\n");
     
-    /* Move to D0 (active) */
+    /* Move to D0 (active); the register restore below owns the
+     * CONTROL write */
+    mdev->pm_state->restore_pending = true;
     ret = mgpu_pm_set_power_state(mdev, MGPU_POWER_D0);
     if (ret)
         return ret;
-    
+
     /* Restore state */
     mgpu_pm_restore_registers(mdev);
     
@@ -346,7 +394,9 @@ static int mgpu_pm_resume(struct device *dev)
     if (!pm->suspended)
         return 0;
     
-    /* Power up to D0 */
+    /* Power up to D0; core re-init and the register restore below
+     * both write CONTROL, so the interim enable is redundant here */
+    pm->restore_pending = true;
     ret = mgpu_pm_set_power_state(mdev, MGPU_POWER_D0);
     if (ret) {
         dev_err(dev, "Failed to power up GPU: %d\n", ret);
@@ -407,6 +457,8 @@ int mgpu_pm_init(struct mgpu_device *mdev)
     if (IS_ERR(pm->clocks.core_clk)) {
         pm->clocks.core_clk = NULL;
         dev_info(dev, "Core clock not available\n");
+    } else {
+        pm->clocks.base_core_rate = clk_get_rate(pm->clocks.core_clk);
     }
     
     pm->clocks.mem_clk = devm_clk_get(dev, "mem");
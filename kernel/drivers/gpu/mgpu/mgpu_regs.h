@@ -19,6 +19,7 @@
 #define MGPU_REG_CMD_HEAD       0x0048
 #define MGPU_REG_CMD_TAIL       0x004C
 #define MGPU_REG_CMD_DOORBELL   0x0050
+#define MGPU_REG_STATUS_PAGE    0x0054  /* Head write-back page address */
 
 /* Fence registers */
 #define MGPU_REG_FENCE_ADDR     0x0060
@@ -68,6 +69,15 @@
 #define MGPU_IRQ_SHADER_HALT    (1 << 4)
 #define MGPU_IRQ_PERF_COUNTER   (1 << 5)
 
+/* All interrupt bits the hardware defines; blanket acks use this so
+ * undefined W1C bits are never written */
+#define MGPU_IRQ_ALL            (MGPU_IRQ_CMD_COMPLETE | \
+                                 MGPU_IRQ_ERROR | \
+                                 MGPU_IRQ_FENCE | \
+                                 MGPU_IRQ_QUEUE_EMPTY | \
+                                 MGPU_IRQ_SHADER_HALT | \
+                                 MGPU_IRQ_PERF_COUNTER)
+
 /* Capability bits */
 #define MGPU_CAP_VERTEX_SHADER  (1 << 0)
 #define MGPU_CAP_FRAGMENT_SHADER (1 << 1)
@@ -79,6 +89,11 @@
 #define MGPU_CAP_FENCE          (1 << 7)
 #define MGPU_CAP_MULTI_QUEUE    (1 << 8)
 #define MGPU_CAP_PREEMPTION     (1 << 9)
+#define MGPU_CAP_SHADER_AUTOINC (1 << 10)  /* SHADER_DATA port auto-increments */
+#define MGPU_CAP_HEAD_WRITEBACK (1 << 11)  /* HW writes CMD_HEAD to status page */
+#define MGPU_CAP_DMA_SG         (1 << 12)  /* Copy engine chains SG DMA commands */
+#define MGPU_CAP_DMA64          (1 << 13)  /* DMA commands carry 64-bit addresses */
+#define MGPU_CAP_IRQ_AUTOCLEAR  (1 << 14)  /* Reading IRQ_STATUS clears it */
 
 /* Version field extraction */
 #define MGPU_VERSION_MAJOR(v)   (((v) >> 24) & 0xFF)
@@ -103,6 +118,14 @@
 #define MGPU_CMD_WAIT           0x05
 #define MGPU_CMD_REG_WRITE      0x06
 #define MGPU_CMD_REG_READ       0x07
+#define MGPU_CMD_DMA_SG         0x08
+
+/* Fixed framebuffer geometry (framebuffer.sv).  Compile-time
+ * constants so dimension arithmetic folds to immediates */
+#define MGPU_FB_WIDTH           640
+#define MGPU_FB_HEIGHT          480
+#define MGPU_FB_BPP             32
+#define MGPU_FB_FORMAT          0x8888  /* XRGB8888 */
 
 /* Limits */
 #define MGPU_RING_SIZE_MIN      4096
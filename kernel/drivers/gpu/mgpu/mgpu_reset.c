@@ -1,3 +1,7 @@
+#include <linux/delay.h>
+#include <linux/iopoll.h>
+#include <linux/ktime.h>
+
 #include "mgpu_drm.h"
 #include "mgpu_regs.h"
 #include "mgpu_internal.h"
@@ -109,8 +113,8 @@ void mgpu_reset_schedule(struct mgpu_device *mdev)
 /* Perform hardware reset */
 int mgpu_reset_hw(struct mgpu_device *mdev)
 {
-    int timeout;
     u32 status;
+    int ret;
     
     dev_info(mdev->dev, "Performing hardware reset\n");
     
@@ -130,26 +134,22 @@ int mgpu_reset_hw(struct mgpu_device *mdev)
     /* Deassert reset */
     mgpu_write(mdev, MGPU_REG_CONTROL, 0);
     
-    /* Wait for GPU to come out of reset */
-    timeout = 1000;  /* 1 second timeout */
-    while (timeout--) {
-        status = mgpu_read(mdev, MGPU_REG_STATUS);
-        if (status & MGPU_STATUS_IDLE) {
-            dev_dbg(mdev->dev, "GPU came out of reset after %d ms\n",
-                    1000 - timeout);
-            break;
-        }
-        msleep(1);
-    }
-    
-    if (timeout <= 0) {
-        dev_err(mdev->dev, "GPU failed to come out of reset (status=0x%08x)\n",
+    /* Wait for GPU to come out of reset.  Same 1 s budget the old
+     * hand-rolled loop enforced via a ktime deadline, but the iopoll
+     * helper sleeps on hrtimers at 50us granularity, so a core that
+     * recovers in 200us costs 200us rather than a jiffy */
+    ret = readl_poll_timeout(mdev->mmio_base + MGPU_REG_STATUS, status,
+                             status & MGPU_STATUS_IDLE, 50,
+                             1000 * USEC_PER_MSEC);
+    if (ret) {
+        dev_err(mdev->dev,
+                "GPU failed to come out of reset (status=0x%08x)\n",
                 status);
-        return -ETIMEDOUT;
+        return ret;
     }
     
     /* Clear all interrupts */
-    mgpu_write(mdev, MGPU_REG_IRQ_ACK, 0xFFFFFFFF);
+    mgpu_write(mdev, MGPU_REG_IRQ_ACK, MGPU_IRQ_ALL);
     
     /* Verify GPU is responsive */
     if (mgpu_core_test_alive(mdev)) {
@@ -213,16 +213,21 @@ bool mgpu_reset_needed(struct mgpu_device *mdev)
     if (status & MGPU_STATUS_HALTED)
         return true;
     
-    /* Check if GPU is hung (busy but not making progress) */
+    /* Check if GPU is hung (busy but not making progress).  The
+     * progress witness lives in the device, not a file-scope static:
+     * a static would interleave fence values from different GPUs and
+     * could hide a hang on one behind progress on another.  The
+     * ONCE accessors make the check safe from a watchdog running
+     * concurrently with the reset worker.  The fence read itself
+     * only happens on the busy path */
     if (status & MGPU_STATUS_BUSY) {
-        static u32 last_fence = 0;
         u32 current_fence = mgpu_read(mdev, MGPU_REG_FENCE_VALUE);
-        
-        if (current_fence == last_fence) {
+
+        if (current_fence == READ_ONCE(mdev->last_seen_fence)) {
             /* No progress in fence value */
             return true;
         }
-        last_fence = current_fence;
+        WRITE_ONCE(mdev->last_seen_fence, current_fence);
     }
     
     return false;
@@ -598,7 +598,7 @@ static int mgpu_test_interrupts(struct mgpu_selftest_ctx *ctx)
 {
     struct mgpu_device *mdev = ctx->mdev;
     u32 old_enable, status;
-    int timeout;
+    ktime_t deadline;
     
     dev_info(mdev->dev, "Testing interrupt handling...\n");
     
@@ -609,7 +609,7 @@ static int mgpu_test_interrupts(struct mgpu_selftest_ctx *ctx)
     mgpu_write(mdev, MGPU_REG_IRQ_ENABLE, 0);
     
     /* Clear any pending interrupts */
-    mgpu_write(mdev, MGPU_REG_IRQ_ACK, 0xFFFFFFFF);
+    mgpu_write(mdev, MGPU_REG_IRQ_ACK, MGPU_IRQ_ALL);
     
     /* Enable command complete interrupt */
     mgpu_write(mdev, MGPU_REG_IRQ_ENABLE, MGPU_IRQ_CMD_COMPLETE);
@@ -638,20 +638,21 @@ static int mgpu_test_interrupts(struct mgpu_selftest_ctx *ctx)
         return ret;
     }
     
-    /* Wait for interrupt */
-    timeout = 100;  /* 100ms */
-    while (timeout--) {
+    /* Wait for interrupt.  Deadline-based so the 100ms bound holds in
+     * wallclock terms regardless of sleep granularity */
+    deadline = ktime_add_ms(ktime_get(), 100);
+    for (;;) {
         status = mgpu_read(mdev, MGPU_REG_IRQ_STATUS);
         if (status & MGPU_IRQ_CMD_COMPLETE) {
             mgpu_test_record_result(ctx, "Command Complete IRQ", true, NULL);
             break;
         }
-        msleep(1);
-    }
-    
-    if (timeout <= 0) {
-        mgpu_test_record_result(ctx, "Command Complete IRQ",
-                               false, "Timeout waiting for interrupt");
+        if (ktime_after(ktime_get(), deadline)) {
+            mgpu_test_record_result(ctx, "Command Complete IRQ",
+                                    false, "Timeout waiting for interrupt");
+            break;
+        }
+        usleep_range(50, 200);
     }
     
     /* Clear interrupt */
@@ -747,7 +748,7 @@ static int mgpu_test_dma(struct mgpu_selftest_ctx *ctx)
     
     /* Perform DMA copy */
     ret = mgpu_dma_copy(mdev, src_bo->dma_addr, dst_bo->dma_addr,
-                       PAGE_SIZE, true);  /* Blocking */
+                       PAGE_SIZE, 0, true);  /* Blocking */
     if (ret) {
         mgpu_test_record_result(ctx, "DMA Copy",
                                false, "DMA failed: %d", ret);
@@ -1,6 +1,8 @@
 #include <linux/module.h>
 #include <linux/slab.h>
+#include <linux/seqlock.h>
 #include <linux/uaccess.h>
+#include <linux/io.h>
 
 #include "mgpu_drm.h"
 #include "mgpu_regs.h"
@@ -13,11 +15,14 @@ struct mgpu_shader_slot {
     bool loaded;
 };
 
-/* Shader manager */
+/* Shader manager.  Writers serialize on the mutex and bump the
+ * seqcount around slot mutations; snapshot readers retry on the
+ * seqcount instead of taking the lock */
 struct mgpu_shader_mgr {
     struct mgpu_device *mdev;
-    struct mgpu_shader_slot slots[16];  /* 16 shader slots */
+    struct mgpu_shader_slot slots[MGPU_MAX_SHADER_SLOTS];
     struct mutex lock;
+    seqcount_mutex_t seq;
 };
 
 /* Initialize shader manager */
@@ -31,6 +36,7 @@ int mgpu_shader_init(struct mgpu_device *mdev)
     
     mgr->mdev = mdev;
     mutex_init(&mgr->lock);
+    seqcount_mutex_init(&mgr->seq, &mgr->lock);
     
     mdev->shader_mgr = mgr;
     
@@ -107,7 +113,7 @@ static int mgpu_shader_write_to_hw(struct mgpu_device *mdev, u32 slot,
                                    u32 *code, size_t size)
 {
     u32 instr_offset;
-    u32 i, dwords;
+    u32 dwords;
     
     /* Calculate instruction memory offset for this slot */
     /* Each slot gets 256 dwords (1KB) */
@@ -119,13 +125,16 @@ static int mgpu_shader_write_to_hw(struct mgpu_device *mdev, u32 slot,
     }
     
     dwords = size / 4;
-    
-    /* Write shader to instruction memory */
-    for (i = 0; i < dwords; i++) {
-        mgpu_write(mdev, MGPU_REG_SHADER_ADDR, instr_offset + i);
-        mgpu_write(mdev, MGPU_REG_SHADER_DATA, code[i]);
-    }
-    
+
+    /* Stream the blob through the directly-addressable instruction
+     * window (0x1000..0x1FFF in the gpu_top.sv memory map) instead
+     * of pairing strongly-ordered ADDR/DATA port writes per dword:
+     * a 256-dword shader costs 256 relaxed stores the interconnect
+     * can merge, plus one barrier, rather than 512 ordered writes */
+    mgpu_write_burst(mdev, MGPU_REG_INSTR_MEM_BASE + instr_offset * 4,
+                     code, dwords);
+    wmb();
+
     /* Set shader control register */
     mgpu_write(mdev, MGPU_REG_SHADER_CTRL, (slot << 16) | (dwords & 0xFFFF));
     
@@ -176,6 +185,7 @@ int mgpu_load_shader(struct mgpu_device *mdev, struct mgpu_load_shader *args)
     }
     
     mutex_lock(&mgr->lock);
+    write_seqcount_begin(&mgr->seq);
     
     slot = &mgr->slots[args->slot];
     
@@ -195,12 +205,14 @@ int mgpu_load_shader(struct mgpu_device *mdev, struct mgpu_load_shader *args)
     if (ret) {
         kfree(code);
         slot->code = NULL;
+        write_seqcount_end(&mgr->seq);
         mutex_unlock(&mgr->lock);
         return ret;
     }
     
     slot->loaded = true;
     
+    write_seqcount_end(&mgr->seq);
     mutex_unlock(&mgr->lock);
     
     dev_info(mdev->dev, "Loaded %s shader to slot %u (%u bytes)\n",
@@ -287,4 +299,38 @@ int mgpu_shader_get_info(struct mgpu_device *mdev, u32 slot,
     mutex_unlock(&mgr->lock);
     
     return 0;
-}
\ No newline at end of file
+}
+
+/* Snapshot all slot state for the coredump and debugfs paths: one
+ * seqcount-guarded memcpy of the table, decoded by the caller with no
+ * lock held.  Returns the loaded-slot bitmap */
+u32 mgpu_shader_snapshot(struct mgpu_device *mdev,
+                         struct mgpu_shader_slot_snap *snap, u32 num)
+{
+    struct mgpu_shader_mgr *mgr = mdev->shader_mgr;
+    struct mgpu_shader_slot slots[MGPU_MAX_SHADER_SLOTS];
+    unsigned int seq;
+    u32 active = 0;
+    u32 i;
+    
+    if (!mgr)
+        return 0;
+    
+    /* Lockless: retry the copy if a writer raced.  Slot state is a
+     * few words of POD, so a retry is cheaper than making every
+     * shader load wait out a debugfs dump (or vice versa) */
+    do {
+        seq = read_seqcount_begin(&mgr->seq);
+        memcpy(slots, mgr->slots, sizeof(slots));
+    } while (read_seqcount_retry(&mgr->seq, seq));
+    
+    for (i = 0; i < num && i < MGPU_MAX_SHADER_SLOTS; i++) {
+        snap[i].type = slots[i].type;
+        snap[i].size = slots[i].size;
+        snap[i].loaded = slots[i].loaded;
+        if (slots[i].loaded)
+            active |= BIT(i);
+    }
+    
+    return active;
+}
@@ -7,6 +7,10 @@
 #include <linux/fdtable.h>
 #include <linux/sync_file.h>
 #include <linux/dma-fence.h>
+#include <linux/delay.h>
+#include <linux/ktime.h>
+#include <linux/io.h>
+#include <linux/iopoll.h>
 
 #include "mgpu_drm.h"
 #include "mgpu_regs.h"
@@ -38,17 +42,20 @@ struct mgpu_cmd_validator {
 static int mgpu_validate_draw_cmd(struct mgpu_device *mdev, u32 *cmd, u32 size);
 static int mgpu_validate_dma_cmd(struct mgpu_device *mdev, u32 *cmd, u32 size);
 static int mgpu_validate_fence_cmd(struct mgpu_device *mdev, u32 *cmd, u32 size);
+static int mgpu_validate_dma_sg_cmd(struct mgpu_device *mdev, u32 *cmd, u32 size);
 
 /* Command validators based on hardware opcodes from registers.yaml */
 static const struct mgpu_cmd_validator cmd_validators[] = {
     { MGPU_CMD_NOP,       1,  1, false, NULL },
     { MGPU_CMD_DRAW,      5,  8, false, mgpu_validate_draw_cmd },
     { MGPU_CMD_COMPUTE,   4,  8, false, NULL },  /* TODO */
-    { MGPU_CMD_DMA,       4,  5, false, mgpu_validate_dma_cmd },
+    { MGPU_CMD_DMA,       4,  7, false, mgpu_validate_dma_cmd },
     { MGPU_CMD_FENCE,     3,  3, false, mgpu_validate_fence_cmd },
     { MGPU_CMD_WAIT,      2,  3, false, NULL },
     { MGPU_CMD_REG_WRITE, 3,  3, true,  NULL },  /* Privileged */
     { MGPU_CMD_REG_READ,  2,  3, true,  NULL },  /* Privileged */
+    { MGPU_CMD_DMA_SG,    5,  2 + 3 * MGPU_DMA_SG_MAX_ENTRIES, false,
+      mgpu_validate_dma_sg_cmd },
 };
 
 /* Validate DRAW command */
@@ -99,6 +106,34 @@ static int mgpu_validate_dma_cmd(struct mgpu_device *mdev, u32 *cmd, u32 size)
     return 0;
 }
 
+/* Validate scatter-gather DMA command */
+static int mgpu_validate_dma_sg_cmd(struct mgpu_device *mdev, u32 *cmd, u32 size)
+{
+    struct mgpu_cmd_dma_sg *sg = (struct mgpu_cmd_dma_sg *)cmd;
+    u32 i;
+    
+    if (sg->count == 0 || sg->count > MGPU_DMA_SG_MAX_ENTRIES ||
+        size != 2 + sg->count * 3) {
+        dev_err(mdev->dev, "Invalid SG DMA count: %u (size %u)\n",
+                sg->count, size);
+        return -EINVAL;
+    }
+    
+    /* Same constraints as the single-copy DMA command, per entry */
+    for (i = 0; i < sg->count; i++) {
+        if (sg->entries[i].size == 0 ||
+            sg->entries[i].size > (16 * 1024 * 1024) ||
+            (sg->entries[i].src_addr & 3) ||
+            (sg->entries[i].dst_addr & 3) ||
+            (sg->entries[i].size & 3)) {
+            dev_err(mdev->dev, "Invalid SG DMA entry %u\n", i);
+            return -EINVAL;
+        }
+    }
+    
+    return 0;
+}
+
 /* Validate FENCE command */
 static int mgpu_validate_fence_cmd(struct mgpu_device *mdev, u32 *cmd, u32 size)
 {
@@ -124,7 +159,12 @@ static int mgpu_validate_commands(struct mgpu_device *mdev, u32 *cmds, u32 size_
     u32 *ptr = cmds;
     u32 *end = cmds + (size_bytes / 4);
     int ret = 0;
-    
+
+    /* The header must stay one dword: the MGPU_CMD_MAKE/GET raw-word
+     * accessors in the uapi header and the size arithmetic below both
+     * bake that in */
+    BUILD_BUG_ON(sizeof(struct mgpu_cmd_header) != 4);
+
     while (ptr < end) {
         struct mgpu_cmd_header *hdr = (struct mgpu_cmd_header *)ptr;
         const struct mgpu_cmd_validator *validator = NULL;
@@ -299,11 +339,16 @@ int mgpu_execute_render(struct mgpu_device *mdev, struct mgpu_render_job *job)
         /* Could implement a job queue here */
     }
     
-    /* Configure vertex fetch unit (matches vertex_fetch.sv) */
-    mgpu_write(mdev, MGPU_REG_VERTEX_BASE, vbo->dma_addr);
-    mgpu_write(mdev, MGPU_REG_VERTEX_COUNT, job->vertex_count);
-    mgpu_write(mdev, MGPU_REG_VERTEX_STRIDE, job->vertex_stride ?: 44);
-    
+    /* Configure vertex fetch unit (matches vertex_fetch.sv).  The
+     * three registers are consecutive words; burst them as one
+     * relaxed copy, ordered by the later pipeline-start write */
+    {
+        u32 vals[3] = { vbo->dma_addr, job->vertex_count,
+                        job->vertex_stride ?: 44 };
+
+        mgpu_write_burst(mdev, MGPU_REG_VERTEX_BASE, vals, 3);
+    }
+
     /* Configure shaders if specified */
     if (job->vertex_shader_handle) {
         /* The hardware expects shader code in instruction memory */
@@ -314,11 +359,13 @@ int mgpu_execute_render(struct mgpu_device *mdev, struct mgpu_render_job *job)
     mgpu_write(mdev, MGPU_REG_CONTROL, 
                mgpu_read(mdev, MGPU_REG_CONTROL) | MGPU_CTRL_ENABLE);
     
-    /* If synchronous, wait for completion */
+    /* If synchronous, wait for completion.  Wallclock deadline plus
+     * usleep_range: msleep(1) rounds up to a jiffy, inflating both the
+     * per-iteration latency floor and the effective timeout */
     if (job->flags & MGPU_RENDER_FLAGS_SYNC) {
-        int timeout = 1000; /* 1 second */
+        ktime_t deadline = ktime_add_ms(ktime_get(), 1000);
         
-        while (timeout--) {
+        for (;;) {
             status = mgpu_read(mdev, MGPU_REG_STATUS);
             if (status & MGPU_STATUS_IDLE)
                 break;
@@ -327,12 +374,12 @@ int mgpu_execute_render(struct mgpu_device *mdev, struct mgpu_render_job *job)
                 ret = -EIO;
                 break;
             }
-            msleep(1);
-        }
-        
-        if (timeout <= 0) {
-            dev_err(mdev->dev, "Render timeout\n");
-            ret = -ETIMEDOUT;
+            if (ktime_after(ktime_get(), deadline)) {
+                dev_err(mdev->dev, "Render timeout\n");
+                ret = -ETIMEDOUT;
+                break;
+            }
+            usleep_range(50, 200);
         }
     }
     
@@ -385,8 +432,8 @@ int mgpu_query_caps(struct mgpu_device *mdev, struct mgpu_caps_query *query)
     query->max_bo_size = 256 * 1024 * 1024;  /* 256MB max per BO */
     
     /* Display configuration from hardware */
-    query->display_width = 640;   /* From framebuffer.sv */
-    query->display_height = 480;
+    query->display_width = MGPU_FB_WIDTH;   /* From framebuffer.sv */
+    query->display_height = MGPU_FB_HEIGHT;
     query->display_formats = DRM_FORMAT_XRGB8888;  /* 32-bit color */
     
     return 0;
@@ -494,21 +541,26 @@ int mgpu_set_pipeline_state(struct mgpu_device *mdev,
 void mgpu_memory_barrier(struct mgpu_device *mdev, u32 flags)
 {
     u32 control;
-    
+    u32 status;
+
     /* Issue cache flush if requested */
     if (flags & MGPU_BARRIER_CACHE_FLUSH) {
         control = mgpu_read(mdev, MGPU_REG_CONTROL);
         control |= MGPU_CTRL_FLUSH_CACHE;
         mgpu_write(mdev, MGPU_REG_CONTROL, control);
-        
-        /* Wait for flush to complete */
-        udelay(10);
-        
+
+        /* Poll for the flush to drain rather than a blind udelay:
+         * returns as soon as the device reports idle and still bounds
+         * the wait if it never does */
+        readl_poll_timeout(mdev->mmio_base + MGPU_REG_STATUS, status,
+                           status & MGPU_STATUS_IDLE, 10,
+                           100 * USEC_PER_MSEC);
+
         /* Clear flush bit */
         control &= ~MGPU_CTRL_FLUSH_CACHE;
         mgpu_write(mdev, MGPU_REG_CONTROL, control);
     }
-    
+
     /* Memory barrier */
     mb();
 }
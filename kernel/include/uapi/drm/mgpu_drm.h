@@ -16,6 +16,7 @@
 #define MGPU_LOAD_SHADER   _IOW(MGPU_IOCTL_BASE, 0x06, struct mgpu_load_shader)
 #define MGPU_READ_REG      _IOWR(MGPU_IOCTL_BASE, 0x07, struct mgpu_reg_access)
 #define MGPU_WRITE_REG     _IOW(MGPU_IOCTL_BASE, 0x08, struct mgpu_reg_access)
+#define MGPU_SUBMIT_AND_WAIT _IOW(MGPU_IOCTL_BASE, 0x09, struct mgpu_submit_wait)
 
 /* Device information */
 struct mgpu_info {
@@ -38,7 +39,8 @@ struct mgpu_bo_create {
     __u32 size;           /* IN: Size in bytes */
     __u32 flags;          /* IN: Creation flags */
     __u32 handle;         /* OUT: BO handle */
-    __u32 gpu_addr;       /* OUT: GPU virtual address */
+    __u32 pad;
+    __u64 gpu_addr;       /* OUT: GPU address (bus/IOVA) */
 };
 
 /* BO creation flags */
@@ -50,6 +52,11 @@ struct mgpu_bo_create {
 #define MGPU_BO_FLAGS_TEXTURE    (1 << 5)
 #define MGPU_BO_FLAGS_FRAMEBUFFER (1 << 6)
 #define MGPU_BO_FLAGS_COMMAND    (1 << 7)
+/* Fence/completion buffer: allocated coherent so userspace can mmap
+ * it and poll GPU-written fence values directly, without an ioctl
+ * round trip per completion.  The wait ioctls remain available for
+ * the timeout/sleep path */
+#define MGPU_BO_FLAGS_FENCE      (1 << 8)
 
 /* Buffer object mmap */
 struct mgpu_bo_mmap {
@@ -58,6 +65,11 @@ struct mgpu_bo_mmap {
     __u64 offset;         /* OUT: mmap offset */
 };
 
+/* Magic mmap offset, below the BO offset range (BO offsets start at
+ * 64KB): maps the kernel fence page read-only so userspace can poll
+ * fence words with a plain load instead of an ioctl */
+#define MGPU_MMAP_FENCE_PAGE 0x1000
+
 /* Buffer object destroy */
 struct mgpu_bo_destroy {
     __u32 handle;         /* IN: BO handle */
@@ -77,18 +89,37 @@ struct mgpu_submit {
     __u32 pad;
 };
 
+/* Fused submit + wait: emits the commands and blocks on the submit's
+ * own fence in one syscall, saving the second user/kernel transition
+ * of the usual MGPU_SUBMIT + MGPU_WAIT_FENCE pair.  Requires
+ * MGPU_SUBMIT_FLAGS_FENCE in submit.flags */
+struct mgpu_submit_wait {
+    struct mgpu_submit submit;  /* IN: as for MGPU_SUBMIT */
+    __u32 timeout_ms;     /* IN: Wait timeout in milliseconds */
+    __u32 pad;
+};
+
 /* Submit flags */
 #define MGPU_SUBMIT_FLAGS_FENCE  (1 << 0)
 #define MGPU_SUBMIT_FLAGS_SYNC   (1 << 1)
 #define MGPU_SUBMIT_FLAGS_NO_FLUSH (1 << 2)
+/* Write the ring but skip the doorbell; a later submit (or SYNC) kicks.
+ * Lets userspace batch many small submissions into one doorbell. */
+#define MGPU_SUBMIT_FLAGS_NOKICK (1 << 3)
 
-/* Fence wait */
+/* Fence wait.  Slot-based waits index straight into the kernel fence
+ * page (slot N = dword N); address-based waits take the legacy range
+ * check against arbitrary fence memory */
 struct mgpu_wait_fence {
-    __u64 fence_addr;     /* IN: Fence address */
+    __u64 fence_addr;     /* IN: Fence address (ignored with FENCE_SLOT) */
     __u32 fence_value;    /* IN: Value to wait for */
     __u32 timeout_ms;     /* IN: Timeout in milliseconds */
+    __u32 fence_slot;     /* IN: Fence page slot index */
+    __u32 flags;          /* IN: MGPU_WAIT_FENCE_* */
 };
 
+#define MGPU_WAIT_FENCE_SLOT  (1 << 0)  /* Wait on fence_slot, not fence_addr */
+
 /* Shader loading */
 struct mgpu_load_shader {
     __u64 data;           /* IN: Shader binary data */
@@ -124,6 +155,18 @@ struct mgpu_cmd_header {
     __u32 flags : 16;
 };
 
+/* Raw-dword form of the header for producers that build commands as
+ * plain __u32 streams: one packed word per header instead of
+ * per-field bitfield updates.  Layout matches the struct above on
+ * little-endian, which is the only byte order the hardware ships in */
+#define MGPU_CMD_MAKE(op, sz, fl) \
+    ((__u32)((op) & 0xff) | \
+     (((__u32)(sz) & 0xff) << 8) | \
+     (((__u32)(fl) & 0xffff) << 16))
+#define MGPU_CMD_GET_OPCODE(w)  ((w) & 0xff)
+#define MGPU_CMD_GET_SIZE(w)    (((w) >> 8) & 0xff)
+#define MGPU_CMD_GET_FLAGS(w)   (((w) >> 16) & 0xffff)
+
 /* Draw command */
 struct mgpu_cmd_draw {
     struct mgpu_cmd_header header;
@@ -133,13 +176,56 @@ struct mgpu_cmd_draw {
     __u32 first_instance;
 };
 
-/* DMA command */
+/* DMA command.  The two _hi dwords exist only on MGPU_CAP_DMA64
+ * hardware; legacy parts take the 5-dword prefix (header.size says
+ * which layout was emitted) */
 struct mgpu_cmd_dma {
     struct mgpu_cmd_header header;
     __u32 src_addr;
     __u32 dst_addr;
     __u32 size;
     __u32 flags;
+    __u32 src_addr_hi;
+    __u32 dst_addr_hi;
+};
+
+/* Scatter-gather DMA command: up to MGPU_DMA_SG_MAX_ENTRIES copies
+ * chained inside the copy engine under one command header
+ * (MGPU_CAP_DMA_SG hardware only) */
+#define MGPU_DMA_SG_MAX_ENTRIES 16
+
+struct mgpu_cmd_dma_sg {
+    struct mgpu_cmd_header header;
+    __u32 count;          /* Number of entries that follow */
+    struct {
+        __u32 src_addr;
+        __u32 dst_addr;
+        __u32 size;
+    } entries[];
+};
+
+/* One draw in a batched 3D submission (DRM render node) */
+struct drm_mgpu_draw_3d {
+    __u32 vertex_bo;            /* IN: Vertex buffer handle */
+    __u32 vertex_count;         /* IN: Number of vertices */
+    __u32 vertex_stride;        /* IN: Bytes per vertex (0 = default) */
+    __u32 vertex_shader_slot;   /* IN: Shader slot, >= 16 to skip bind */
+    __u32 fragment_shader_slot; /* IN: Shader slot, >= 16 to skip bind */
+    __u32 flags;                /* IN: Reserved, must be 0 */
+};
+
+#define MGPU_MAX_BATCH_DRAWS  256
+
+/* Batched 3D submission: the whole array becomes one command-buffer
+ * write and one doorbell instead of one ioctl per draw */
+struct drm_mgpu_submit_3d_batch {
+    __u64 draws;          /* IN: Array of drm_mgpu_draw_3d */
+    __u32 count;          /* IN: Number of draws, <= MGPU_MAX_BATCH_DRAWS */
+    __u32 flags;          /* IN: Reserved, must be 0 */
+    __u32 fence_bo;       /* IN: Fence BO handle (0 = no fence) */
+    __u32 fence_offset;   /* IN: Offset of fence dword in the BO */
+    __u32 fence_value;    /* IN: Value written when the batch retires */
+    __u32 pad;
 };
 
 /* Fence command */